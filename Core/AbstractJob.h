@@ -24,6 +24,7 @@
 
 #include <QObject>
 #include <QAbstractListModel>
+#include <QVariantMap>
 
 namespace GCF
 {
@@ -76,18 +77,29 @@ public:
     Q_PROPERTY(QString error READ error NOTIFY updated)
     QString error() const;
 
+    Q_PROPERTY(int updateRate READ updateRate WRITE setUpdateRate NOTIFY updateRateChanged)
+    void setUpdateRate(int rate);
+    int updateRate() const;
+
+    static void setDefaultUpdateRate(int rate);
+    static int defaultUpdateRate();
+
     GCF::Result start();
     GCF::Result cancel();
     GCF::Result suspend();
     GCF::Result resume();
     GCF::Result retry();
 
+    virtual QVariantMap saveState() const { return QVariantMap(); }
+    virtual bool restoreState(const QVariantMap &state) { Q_UNUSED(state); return false; }
+
 signals:
     void updated(GCF::AbstractJob *job);
     void started(GCF::AbstractJob *job);
     void suspended(GCF::AbstractJob *job);
     void resumed(GCF::AbstractJob *job);
     void completed(GCF::AbstractJob *job);
+    void updateRateChanged(GCF::AbstractJob *job);
 
 protected:
     virtual GCF::Result startJob() = 0;
@@ -107,6 +119,10 @@ protected:
     void abort(const QString &msg);
     void done();
 
+private:
+    void emitUpdated(bool throttled);
+    Q_SLOT void emitPendingUpdate();
+
 private:
     AbstractJobData *d;
 };
@@ -158,6 +174,8 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QHash<int,QByteArray> roleNames() const;
 
+    Q_INVOKABLE QVariantList rolesForRange(int first, int last, const QList<int> &roles=QList<int>()) const;
+
     Q_INVOKABLE void cancelAllJobs();
     Q_INVOKABLE void clearCompletedJobs();
     Q_INVOKABLE bool cancelJobAt(int index);
@@ -173,6 +191,10 @@ signals:
     void jobSuspended(GCF::AbstractJob *job);
     void jobResumed(GCF::AbstractJob *job);
     void jobCompleted(GCF::AbstractJob *job);
+    void aboutToBeDestroyed();
+
+protected:
+    void timerEvent(QTimerEvent *te);
 
 private:
     void objectRemoved(int index, QObject *obj);
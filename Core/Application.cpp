@@ -51,6 +51,7 @@ using the \c gAppService global pointer.
 #include <QSettings>
 #include <QMetaMethod>
 #include <QMetaObject>
+#include <QFutureInterface>
 #include <QDomElement>
 #include <QDomDocument>
 #include <QJsonObject>
@@ -567,6 +568,101 @@ GCF::Result GCF::ApplicationServices::invokeMethod(QObject *object, const QMetaM
     return InvokeMethodHelper(secureCall).call(object, method, args);
 }
 
+/**
+ * @brief This method can be used to invoke a named method in an object, without
+ * blocking the caller.
+ * @param path complete path of the object in the \ref objectTree()
+ * @param method name of the method to invoke in the object. (Only the name. Not the complete signature)
+ * @param args list of arguments to to pass to the method
+ * @param secureCall if true, then the function will check for allowmetaaccess attribute. If false, then it will ignore the attribute.
+ * @return a future that will hold the result of the call, once the call has been made. The
+ * result is same as the one that \ref invokeMethod() would have returned.
+ *
+ * The object lookup and access checks are done immediately. If any of them fail, the returned
+ * future is already finished and holds the error. Otherwise the call is posted to the thread
+ * in which the object lives, and is made when control returns to that thread's event loop.
+ * Methods tagged with \c GCF_THREAD_SAFE are instead called on a worker thread from
+ * \c QThreadPool::globalInstance(). See \ref isMethodThreadSafe().
+ *
+ * \note Only public methods and signals can be invoked by this function.
+ */
+QFuture<GCF::Result> GCF::ApplicationServices::invokeMethodAsync(const QString &path, const QString &method, const QVariantList &args, bool secureCall) const
+{
+    return InvokeMethodHelper(secureCall).callAsync(path, method, args);
+}
+
+/**
+ * @brief This method can be used to invoke a named method in an object, without
+ * blocking the caller.
+ * @param object pointer to a \c QObject in which a method needs to be invoked
+ * @param method name of the method to invoke in the object. (Only the name. Not the complete signature)
+ * @param args list of arguments to to pass to the method
+ * @param secureCall if true, then the function will check for allowmetaaccess attribute. If false, then it will ignore the attribute.
+ * @return a future that will hold the result of the call, once the call has been made.
+ *
+ * \sa invokeMethodAsync(const QString &, const QString &, const QVariantList &, bool) const
+ */
+QFuture<GCF::Result> GCF::ApplicationServices::invokeMethodAsync(QObject *object, const QString &method, const QVariantList &args, bool secureCall)
+{
+    if(!object || method.isEmpty())
+    {
+        QFutureInterface<GCF::Result> futureInterface;
+        futureInterface.reportStarted();
+        futureInterface.reportResult(GCF::Result(false));
+        futureInterface.reportFinished();
+        return futureInterface.future();
+    }
+
+    return InvokeMethodHelper(secureCall).callAsync(object, method, args);
+}
+
+/**
+ * @brief This method can be used to invoke a method in an object, without blocking the caller.
+ * @param object pointer to a \c QObject in which a method needs to be invoked
+ * @param method meta information of the method that needs to be invoked
+ * @param args list of arguments to to pass to the method
+ * @param secureCall if true, then the function will check for allowmetaaccess attribute. If false, then it will ignore the attribute.
+ * @return a future that will hold the result of the call, once the call has been made.
+ *
+ * \sa invokeMethodAsync(const QString &, const QString &, const QVariantList &, bool) const
+ */
+QFuture<GCF::Result> GCF::ApplicationServices::invokeMethodAsync(QObject *object, const QMetaMethod &method, const QVariantList &args, bool secureCall)
+{
+    if(!object || method.enclosingMetaObject() != object->metaObject())
+    {
+        QFutureInterface<GCF::Result> futureInterface;
+        futureInterface.reportStarted();
+        futureInterface.reportResult(GCF::Result(false));
+        futureInterface.reportFinished();
+        return futureInterface.future();
+    }
+
+    return InvokeMethodHelper(secureCall).callAsync(object, method, args);
+}
+
+/**
+ * @brief Checks whether a method can be called from any thread
+ * @param method meta information of the method
+ * @return true if the method was tagged with \c GCF_THREAD_SAFE in its declaration.
+ *
+ * \code
+ * class MyService : public QObject
+ * {
+ *     Q_OBJECT
+ *
+ * public:
+ *     Q_INVOKABLE GCF_THREAD_SAFE int checksum(const QByteArray &data) const;
+ * };
+ * \endcode
+ *
+ * Such methods are called on a worker thread by \ref invokeMethodAsync(), rather than
+ * in the thread of the object.
+ */
+bool GCF::ApplicationServices::isMethodThreadSafe(const QMetaMethod &method)
+{
+    return !qstrcmp(method.tag(), "GCF_THREAD_SAFE");
+}
+
 /**
  \internal
  */
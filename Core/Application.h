@@ -23,6 +23,7 @@
 #include "ObjectTree.h"
 #include "AbstractJob.h"
 
+#include <QFuture>
 #include <QDateTime>
 #include <QStringList>
 #include <QCoreApplication>
@@ -72,6 +73,11 @@ public:
     static GCF::Result invokeMethod(QObject *object, const QMetaMethod &method, const QVariantList &args, bool secureCall=true);
     static GCF::Result isMethodInvokable(const QMetaMethod &method, QObject *object=nullptr);
 
+    QFuture<GCF::Result> invokeMethodAsync(const QString &path, const QString &method, const QVariantList &args, bool secureCall=true) const;
+    static QFuture<GCF::Result> invokeMethodAsync(QObject *object, const QString &method, const QVariantList &args, bool secureCall=true);
+    static QFuture<GCF::Result> invokeMethodAsync(QObject *object, const QMetaMethod &method, const QVariantList &args, bool secureCall=true);
+    static bool isMethodThreadSafe(const QMetaMethod &method);
+
     // Global list of jobs in the application
     GCF::JobListModel *jobs() const;
 
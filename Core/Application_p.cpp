@@ -23,6 +23,7 @@
 #include <QObject>
 #include <QMetaObject>
 #include <QMetaMethod>
+#include <QThreadPool>
 
 GCF::Result GCF::InvokeMethodHelper::call(const QString &path, const QString &method, const QVariantList &args)
 {
@@ -41,6 +42,76 @@ GCF::Result GCF::InvokeMethodHelper::call(const QString &path, const QString &me
 }
 
 GCF::Result GCF::InvokeMethodHelper::call(QObject *object, const QString &methodName, const QVariantList &args)
+{
+    QMetaMethod method = this->findMethod(object, methodName);
+    if(!method.enclosingMetaObject())
+        return this->errorResult( QString("Method '%1' was not found in object").arg(methodName) );
+
+    return this->call(object, method, args);
+}
+
+GCF::Result GCF::InvokeMethodHelper::call(QObject *object, const QMetaMethod &method, const QVariantList &args)
+{
+    GCF::Result result = this->checkCall(object, method, args);
+    if(!result.isSuccess())
+        return result;
+
+    return this->call2(object, method, args);
+}
+
+QFuture<GCF::Result> GCF::InvokeMethodHelper::callAsync(const QString &path, const QString &method, const QVariantList &args)
+{
+    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT,
+                               QString("Asynchronously calling %1::%2 with %3 args")
+                               .arg(path).arg(method).arg(args.count()));
+
+    QObject *object = gAppService->objectTree()->object(path);
+    if(!object)
+        return this->finishedFuture( this->errorResult( QString("Object '%1' doesnt exist").arg(path) ) );
+
+    if(method.isEmpty())
+        return this->finishedFuture( this->errorResult( QString("Method name not specified") ) );
+
+    return this->callAsync(object, method, args);
+}
+
+QFuture<GCF::Result> GCF::InvokeMethodHelper::callAsync(QObject *object, const QString &methodName, const QVariantList &args)
+{
+    QMetaMethod method = this->findMethod(object, methodName);
+    if(!method.enclosingMetaObject())
+        return this->finishedFuture( this->errorResult( QString("Method '%1' was not found in object").arg(methodName) ) );
+
+    return this->callAsync(object, method, args);
+}
+
+QFuture<GCF::Result> GCF::InvokeMethodHelper::callAsync(QObject *object, const QMetaMethod &method, const QVariantList &args)
+{
+    // All checks happen in the caller's thread, so that access to the object-tree
+    // is never made from a worker thread.
+    GCF::Result result = this->checkCall(object, method, args);
+    if(!result.isSuccess())
+        return this->finishedFuture(result);
+
+    QFutureInterface<GCF::Result> futureInterface;
+    futureInterface.reportStarted();
+    QFuture<GCF::Result> future = futureInterface.future();
+
+    if(GCF::ApplicationServices::isMethodThreadSafe(method))
+    {
+        QThreadPool::globalInstance()->start(new InvokeMethodRunnable(object, method, args, futureInterface));
+        return future;
+    }
+
+    // The call is always posted to the object's thread, even if that
+    // happens to be the caller's thread. This way the caller never has to
+    // deal with the result becoming available before this function returns.
+    InvokeMethodTask *task = new InvokeMethodTask(object, method, args, futureInterface);
+    task->moveToThread(object->thread());
+    QMetaObject::invokeMethod(task, "call", Qt::QueuedConnection);
+    return future;
+}
+
+QMetaMethod GCF::InvokeMethodHelper::findMethod(QObject *object, const QString &methodName) const
 {
     QByteArray method2 = methodName.toLatin1();
     const QMetaObject *mo = object->metaObject();
@@ -54,13 +125,13 @@ GCF::Result GCF::InvokeMethodHelper::call(QObject *object, const QString &method
         signature = signature.left( signature.indexOf('(') );
         if(signature == method2)
 #endif
-            return this->call(object, method, args);
+            return method;
     }
 
-    return this->errorResult( QString("Method '%1' was not found in object").arg(methodName) );
+    return QMetaMethod();
 }
 
-GCF::Result GCF::InvokeMethodHelper::call(QObject *object, const QMetaMethod &method, const QVariantList &args)
+GCF::Result GCF::InvokeMethodHelper::checkCall(QObject *object, const QMetaMethod &method, const QVariantList &args)
 {
 #if QT_VERSION >= 0x050000
     if(args.count() != method.parameterCount())
@@ -79,7 +150,16 @@ GCF::Result GCF::InvokeMethodHelper::call(QObject *object, const QMetaMethod &me
     if(this->SecureCall && node->info().value("allowmetaaccess", false).toBool() == false)
         return this->errorResult( QString("Meta access for this object was denied") );
 
-    return this->call2(object, method, args);
+    return true;
+}
+
+QFuture<GCF::Result> GCF::InvokeMethodHelper::finishedFuture(const GCF::Result &result) const
+{
+    QFutureInterface<GCF::Result> futureInterface;
+    futureInterface.reportStarted();
+    futureInterface.reportResult(result);
+    futureInterface.reportFinished();
+    return futureInterface.future();
 }
 
 GCF::Result GCF::InvokeMethodHelper::isMethodInvokable(const QMetaMethod &method, QObject *object)
@@ -225,7 +305,8 @@ bool CallData::add(int index, int type, const QVariant &value)
     return genericArgs[index] != nullptr;
 }
 
-GCF::Result GCF::InvokeMethodHelper::call2(QObject *object, const QMetaMethod &method, const QVariantList &args)
+GCF::Result GCF::InvokeMethodHelper::call2(QObject *object, const QMetaMethod &method, const QVariantList &args,
+                                           Qt::ConnectionType type)
 {
     /*
      * We support only the following types in parameters.
@@ -278,12 +359,12 @@ GCF::Result GCF::InvokeMethodHelper::call2(QObject *object, const QMetaMethod &m
     bool success = false;
     if(callData.genericArgs.last())
         // This function provides a return value
-        success = method.invoke(object, G_RETURN_ARG, G_ARG(0), G_ARG(1), G_ARG(2),
+        success = method.invoke(object, type, G_RETURN_ARG, G_ARG(0), G_ARG(1), G_ARG(2),
                                 G_ARG(3), G_ARG(4), G_ARG(5), G_ARG(6), G_ARG(7),
                                 G_ARG(8), G_ARG(9));
     else
         // This function doesnt provide a return value
-        success = method.invoke(object, G_ARG(0), G_ARG(1), G_ARG(2),
+        success = method.invoke(object, type, G_ARG(0), G_ARG(1), G_ARG(2),
                                 G_ARG(3), G_ARG(4), G_ARG(5), G_ARG(6), G_ARG(7),
                                 G_ARG(8), G_ARG(9));
 
@@ -356,3 +437,69 @@ GCF::Result GCF::InvokeMethodHelper::call2(QObject *object, const QMetaMethod &m
     return this->errorResult( QString("Return type '%1' not supported")
                      .arg( QString::fromLatin1(method.typeName())) );
 }
+
+///////////////////////////////////////////////////////////////////////////////
+
+GCF::InvokeMethodTask::InvokeMethodTask(QObject *object, const QMetaMethod &method, const QVariantList &args,
+                                        const QFutureInterface<GCF::Result> &futureInterface)
+    : m_object(object), m_method(method), m_args(args), m_futureInterface(futureInterface)
+{
+
+}
+
+GCF::InvokeMethodTask::~InvokeMethodTask()
+{
+    // If the event-loop of the object's thread went away before the call
+    // could be made, we still need to finish the future.
+    if(!m_futureInterface.isFinished())
+    {
+        m_futureInterface.reportResult( GCF::Result(false, QString(), QString("Method call was abandoned")) );
+        m_futureInterface.reportFinished();
+    }
+}
+
+void GCF::InvokeMethodTask::call()
+{
+    GCF::Result result;
+    if(m_object.isNull())
+        result = GCF::Result(false, QString(), QString("Object was destroyed before the method could be called"));
+    else
+        result = InvokeMethodHelper().invoke(m_object.data(), m_method, m_args);
+
+    m_futureInterface.reportResult(result);
+    m_futureInterface.reportFinished();
+    this->deleteLater();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+GCF::InvokeMethodRunnable::InvokeMethodRunnable(QObject *object, const QMetaMethod &method, const QVariantList &args,
+                                                const QFutureInterface<GCF::Result> &futureInterface)
+    : m_object(object), m_method(method), m_args(args), m_futureInterface(futureInterface)
+{
+    this->setAutoDelete(true);
+}
+
+GCF::InvokeMethodRunnable::~InvokeMethodRunnable()
+{
+    if(!m_futureInterface.isFinished())
+    {
+        m_futureInterface.reportResult( GCF::Result(false, QString(), QString("Method call was abandoned")) );
+        m_futureInterface.reportFinished();
+    }
+}
+
+void GCF::InvokeMethodRunnable::run()
+{
+    GCF::Result result;
+    if(m_object.isNull())
+        result = GCF::Result(false, QString(), QString("Object was destroyed before the method could be called"));
+    else
+        // Thread-safe methods are called directly on the pool thread. An
+        // auto-connection would queue the call to the object's thread, and
+        // fail for methods that return a value.
+        result = InvokeMethodHelper().invoke(m_object.data(), m_method, m_args, Qt::DirectConnection);
+
+    m_futureInterface.reportResult(result);
+    m_futureInterface.reportFinished();
+}
@@ -21,6 +21,12 @@
 
 #include "GCFGlobal.h"
 
+#include <QObject>
+#include <QPointer>
+#include <QRunnable>
+#include <QMetaMethod>
+#include <QFutureInterface>
+
 namespace GCF
 {
 
@@ -35,10 +41,68 @@ public:
     GCF::Result call(QObject *object, const QMetaMethod &method, const QVariantList &args);
     GCF::Result isMethodInvokable(const QMetaMethod &method, QObject *object=nullptr);
 
+    QFuture<GCF::Result> callAsync(const QString &path, const QString &method, const QVariantList &args);
+    QFuture<GCF::Result> callAsync(QObject *object, const QString &method, const QVariantList &args);
+    QFuture<GCF::Result> callAsync(QObject *object, const QMetaMethod &method, const QVariantList &args);
+
+    // Used by the asynchronous call tasks, after checkCall() has been done
+    // in the caller's thread.
+    GCF::Result invoke(QObject *object, const QMetaMethod &method, const QVariantList &args,
+                       Qt::ConnectionType type=Qt::AutoConnection) {
+        return this->call2(object, method, args, type);
+    }
+
 private:
-    GCF::Result call2(QObject *object, const QMetaMethod &method, const QVariantList &args);
+    QMetaMethod findMethod(QObject *object, const QString &method) const;
+    GCF::Result checkCall(QObject *object, const QMetaMethod &method, const QVariantList &args);
+    GCF::Result call2(QObject *object, const QMetaMethod &method, const QVariantList &args,
+                      Qt::ConnectionType type=Qt::AutoConnection);
     GCF::Result errorResult(const QString &msg) const { return GCF::Result(false, QString(), msg, QVariant()); }
     GCF::Result result(const QVariant &v) { return GCF::Result(true, QString(), QString(), v); }
+    QFuture<GCF::Result> finishedFuture(const GCF::Result &result) const;
+};
+
+/*
+ * Performs a single asynchronous method invocation in the thread of the
+ * target object. Instances are moved to the object's thread and delete
+ * themselves once the result has been reported.
+ */
+class InvokeMethodTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    InvokeMethodTask(QObject *object, const QMetaMethod &method, const QVariantList &args,
+                     const QFutureInterface<GCF::Result> &futureInterface);
+    ~InvokeMethodTask();
+
+    Q_INVOKABLE void call();
+
+private:
+    QPointer<QObject> m_object;
+    QMetaMethod m_method;
+    QVariantList m_args;
+    QFutureInterface<GCF::Result> m_futureInterface;
+};
+
+/*
+ * Performs a single asynchronous method invocation on a worker thread from
+ * QThreadPool::globalInstance(). Used only for methods tagged GCF_THREAD_SAFE.
+ */
+class InvokeMethodRunnable : public QRunnable
+{
+public:
+    InvokeMethodRunnable(QObject *object, const QMetaMethod &method, const QVariantList &args,
+                         const QFutureInterface<GCF::Result> &futureInterface);
+    ~InvokeMethodRunnable();
+
+    void run();
+
+private:
+    QPointer<QObject> m_object;
+    QMetaMethod m_method;
+    QVariantList m_args;
+    QFutureInterface<GCF::Result> m_futureInterface;
 };
 
 }
@@ -0,0 +1,740 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "BinaryLogHandler.h"
+
+#include <QFile>
+#include <QHash>
+#include <QtDebug>
+#include <QFileInfo>
+#include <QStringList>
+
+/*
+The binary log file starts with an 8 byte magic (see Magic below), which is
+followed by a sequence of records. Each record starts with a one byte record
+type.
+
+- SessionRecord: base timestamp (varint). Starts a new session; the interned
+  context and template tables are reset. A session is started each time a
+  handler opens the file, so files can be appended to across runs.
+- ContextRecord: string. Interns a context; ids are assigned in order of
+  appearance, starting from 1.
+- TemplateRecord: string. Interns a message template, the same way.
+- MessageRecord: depth (varint), log-level (varint), timestamp delta from the
+  previous message (zig-zag varint), context id (varint), template id (varint),
+  argument count (varint), arguments, log-code (bytes) and details (string).
+  An id of 0 means that the string follows inline.
+
+Strings are stored as varint length followed by UTF-8 bytes. A template is the
+message with each run of decimal digits replaced by an ArgumentMarker; the runs
+are stored as arguments. An argument is a varint whose lowest bit tells whether
+the rest is a number (0) or the length of a UTF-8 string that follows (1).
+*/
+
+namespace GCF
+{
+
+namespace BinaryLog
+{
+
+static const char Magic[] = { 'G', 'C', 'F', 'B', 'L', 'O', 'G', 1 };
+static const int MagicSize = int(sizeof(Magic));
+static const int MaxInternedStrings = 4096;
+static const ushort ArgumentMarker = 0x0001;
+
+enum RecordType
+{
+    SessionRecord = 0,
+    ContextRecord = 1,
+    TemplateRecord = 2,
+    MessageRecord = 3
+};
+
+static void writeVarint(QByteArray &buffer, quint64 value)
+{
+    while(value >= 0x80)
+    {
+        buffer.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.append(char(value));
+}
+
+static void writeBytes(QByteArray &buffer, const QByteArray &bytes)
+{
+    writeVarint(buffer, quint64(bytes.size()));
+    buffer.append(bytes);
+}
+
+static inline quint64 zigZag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+static inline qint64 unZigZag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+static QString makeTemplate(const QString &message, QStringList &args)
+{
+    // Messages that already contain the marker are stored verbatim
+    if(message.contains(QChar(ArgumentMarker)))
+        return message;
+
+    QString tmpl;
+    tmpl.reserve(message.size());
+
+    const QChar *str = message.constData();
+    const int length = message.length();
+    int i = 0;
+    while(i < length)
+    {
+        if(str[i].unicode() >= '0' && str[i].unicode() <= '9')
+        {
+            int j = i+1;
+            while(j < length && str[j].unicode() >= '0' && str[j].unicode() <= '9')
+                ++j;
+            args.append(message.mid(i, j-i));
+            tmpl.append(QChar(ArgumentMarker));
+            i = j;
+        }
+        else
+            tmpl.append(str[i++]);
+    }
+
+    return tmpl;
+}
+
+static void writeArgument(QByteArray &buffer, const QString &arg)
+{
+    // Numbers with leading zeros or too many digits cannot round-trip
+    // through a varint; they are stored as strings
+    if(arg.length() <= 18 && (arg.length() == 1 || arg.at(0) != QChar('0')))
+    {
+        writeVarint(buffer, arg.toULongLong() << 1);
+        return;
+    }
+
+    const QByteArray bytes = arg.toUtf8();
+    writeVarint(buffer, (quint64(bytes.size()) << 1) | 1);
+    buffer.append(bytes);
+}
+
+}
+
+struct BinaryLogHandlerData
+{
+    BinaryLogHandlerData() : lastTimestamp(0), sessionStarted(false) { }
+
+    QString fileName;
+    QFile file;
+    QByteArray buffer;
+    QHash<QString,quint32> contexts;
+    QHash<QString,quint32> templates;
+    qint64 lastTimestamp;
+    bool sessionStarted;
+
+    bool openFile();
+    quint32 intern(QHash<QString,quint32> &table, int recordType, const QString &str);
+    void encode(GCF::LogMessage *msg, int depth);
+};
+
+}
+
+/**
+\class GCF::BinaryLogHandler BinaryLogHandler.h <GCF3/BinaryLogHandler>
+\brief Writes log messages into a compact binary log file
+\ingroup gcf_core
+
+This class implements \ref GCF::LogMessageHandlerInterface and can be set as
+handler on \ref GCF::Log, in place of the default text handler.
+
+\code
+GCF::BinaryLogHandler *handler = new GCF::BinaryLogHandler;
+GCF::Log::instance()->setHandler(handler);
+\endcode
+
+Instead of printing each message as a line of text, the handler interns context
+strings and message templates (the message with its numbers taken out as
+arguments), and stores timestamps as variable length deltas. Branch structure
+is retained. Log files written by this class can be read back using
+\ref GCF::BinaryLogReader, or converted to the usual text format using the
+\c GCFLogDecoder tool.
+*/
+
+/**
+ * Constructor
+ *
+ * @param fileName name of the file into which log messages are written. If
+ * empty, then \ref GCF::Log::logFileName() with its suffix changed to
+ * \c .gcflog is used. Messages are always appended to the file.
+ */
+GCF::BinaryLogHandler::BinaryLogHandler(const QString &fileName)
+{
+    d = new BinaryLogHandlerData;
+    d->fileName = fileName;
+}
+
+/**
+ * Destructor
+ */
+GCF::BinaryLogHandler::~BinaryLogHandler()
+{
+    d->file.close();
+    delete d;
+}
+
+/**
+ * \return name of the file into which log messages are written
+ */
+QString GCF::BinaryLogHandler::fileName() const
+{
+    if(d->fileName.isEmpty())
+    {
+        const QFileInfo fi(GCF::Log::instance()->logFileName());
+        d->fileName = QString("%1/%2.gcflog").arg(fi.absolutePath()).arg(fi.completeBaseName());
+    }
+
+    return d->fileName;
+}
+
+/**
+ * \internal
+ */
+void GCF::BinaryLogHandler::handleLogMessage(GCF::LogMessage *msg)
+{
+    // Nested messages are written along with their top-level message
+    if(!msg || (msg->parent() && msg->parent()->parent()))
+        return;
+
+    d->fileName = this->fileName();
+    if(!d->openFile())
+    {
+        qDebug() << "Cannot write into log file " << d->fileName;
+        return;
+    }
+
+    d->buffer.clear();
+    if(!d->sessionStarted)
+    {
+        d->contexts.clear();
+        d->templates.clear();
+        d->lastTimestamp = msg->timestamp();
+        d->buffer.append(char(GCF::BinaryLog::SessionRecord));
+        GCF::BinaryLog::writeVarint(d->buffer, quint64(d->lastTimestamp));
+        d->sessionStarted = true;
+    }
+
+    d->encode(msg, 0);
+    d->file.write(d->buffer);
+
+    delete msg;
+}
+
+/**
+ * \internal
+ */
+void GCF::BinaryLogHandler::print(GCF::LogMessage *msg, QTextStream &ts)
+{
+    GCF::Log::instance()->print(msg, ts);
+}
+
+/**
+ * Flushes buffered records into the log file.
+ */
+void GCF::BinaryLogHandler::flush()
+{
+    if(d->file.isOpen())
+        d->file.flush();
+}
+
+bool GCF::BinaryLogHandlerData::openFile()
+{
+    if(this->file.isOpen())
+        return true;
+
+    this->file.setFileName(this->fileName);
+    if(!this->file.open(QFile::Append))
+        return false;
+
+    if(this->file.size() == 0)
+        this->file.write(GCF::BinaryLog::Magic, GCF::BinaryLog::MagicSize);
+
+    this->sessionStarted = false;
+    return true;
+}
+
+quint32 GCF::BinaryLogHandlerData::intern(QHash<QString,quint32> &table, int recordType, const QString &str)
+{
+    QHash<QString,quint32>::const_iterator it = table.constFind(str);
+    if(it != table.constEnd())
+        return it.value();
+
+    if(table.count() >= GCF::BinaryLog::MaxInternedStrings)
+        return 0;
+
+    const quint32 id = quint32(table.count() + 1);
+    table.insert(str, id);
+    this->buffer.append(char(recordType));
+    GCF::BinaryLog::writeBytes(this->buffer, str.toUtf8());
+    return id;
+}
+
+void GCF::BinaryLogHandlerData::encode(GCF::LogMessage *msg, int depth)
+{
+    QStringList args;
+    const QString context = msg->context();
+    const QString tmpl = GCF::BinaryLog::makeTemplate(msg->message(), args);
+
+    // Definitions are written ahead of the message record that uses them
+    const quint32 contextId = this->intern(this->contexts, GCF::BinaryLog::ContextRecord, context);
+    const quint32 templateId = this->intern(this->templates, GCF::BinaryLog::TemplateRecord, tmpl);
+
+    const qint64 timestamp = msg->timestamp();
+    this->buffer.append(char(GCF::BinaryLog::MessageRecord));
+    GCF::BinaryLog::writeVarint(this->buffer, quint64(depth));
+    GCF::BinaryLog::writeVarint(this->buffer, quint64(msg->logLevel()));
+    GCF::BinaryLog::writeVarint(this->buffer, GCF::BinaryLog::zigZag(timestamp - this->lastTimestamp));
+    this->lastTimestamp = timestamp;
+
+    GCF::BinaryLog::writeVarint(this->buffer, contextId);
+    if(contextId == 0)
+        GCF::BinaryLog::writeBytes(this->buffer, context.toUtf8());
+
+    GCF::BinaryLog::writeVarint(this->buffer, templateId);
+    if(templateId == 0)
+        GCF::BinaryLog::writeBytes(this->buffer, tmpl.toUtf8());
+
+    GCF::BinaryLog::writeVarint(this->buffer, quint64(args.count()));
+    for(int i=0; i<args.count(); i++)
+        GCF::BinaryLog::writeArgument(this->buffer, args.at(i));
+
+    // Source of Qt messages is printed after the details by GCF::Log::print()
+    QString details = msg->details();
+    if(!msg->sourceFile().isEmpty())
+        details += QString(" (%1:%2 in %3)").arg(msg->sourceFile())
+                .arg(msg->sourceLine()).arg(msg->sourceFunction());
+
+    GCF::BinaryLog::writeBytes(this->buffer, msg->logCode());
+    GCF::BinaryLog::writeBytes(this->buffer, details.toUtf8());
+
+    const QList<GCF::LogMessage*> children = msg->children();
+    for(int i=0; i<children.count(); i++)
+        this->encode(children.at(i), depth+1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace GCF
+{
+
+struct BinaryLogReaderData
+{
+    BinaryLogReaderData() : maxLogLevel(GCF::LogMessage::User), lastTimestamp(0) { }
+
+    QFile file;
+    QString errorMessage;
+    QStringList contexts;
+    QStringList templates;
+
+    int maxLogLevel;
+    QString contextPrefix;
+    QDateTime fromTime;
+    QDateTime toTime;
+
+    qint64 lastTimestamp;
+
+    bool readVarint(quint64 &value);
+    bool readBytes(QByteArray &bytes);
+    bool readString(QString &str);
+    bool readInterned(const QStringList &table, QString &str);
+    bool readMessage(GCF::BinaryLogRecord &record);
+    bool accepts(const GCF::BinaryLogRecord &record) const;
+    bool fail(const QString &msg);
+};
+
+}
+
+/**
+\class GCF::BinaryLogReader BinaryLogHandler.h <GCF3/BinaryLogHandler>
+\brief Reads log files written by \ref GCF::BinaryLogHandler
+\ingroup gcf_core
+
+Records are read one at a time using \ref readNext(). Records can be filtered
+by log-level, context and time. The \ref decode() function prints an entire
+file in the same text format that \ref GCF::Log writes into its log file.
+
+\code
+GCF::BinaryLogReader reader;
+if( reader.open(fileName) )
+{
+    reader.setMaximumLogLevel(GCF::LogMessage::Warning);
+
+    GCF::BinaryLogRecord record;
+    while( reader.readNext(record) )
+        GCF::BinaryLogReader::print(record, ts);
+}
+\endcode
+*/
+
+/**
+ * Constructor
+ */
+GCF::BinaryLogReader::BinaryLogReader()
+{
+    d = new BinaryLogReaderData;
+}
+
+/**
+ * Destructor
+ */
+GCF::BinaryLogReader::~BinaryLogReader()
+{
+    delete d;
+}
+
+/**
+ * Opens a binary log file for reading.
+ *
+ * @param fileName name of the file to read
+ * @return success if the file could be opened and has a valid header.
+ */
+GCF::Result GCF::BinaryLogReader::open(const QString &fileName)
+{
+    this->close();
+
+    d->file.setFileName(fileName);
+    if(!d->file.open(QFile::ReadOnly))
+        return GCF::Result(false, QString(), QString("Cannot open file '%1' for reading").arg(fileName));
+
+    const QByteArray magic = d->file.read(GCF::BinaryLog::MagicSize);
+    if(magic != QByteArray::fromRawData(GCF::BinaryLog::Magic, GCF::BinaryLog::MagicSize))
+    {
+        d->file.close();
+        return GCF::Result(false, QString(), QString("File '%1' is not a binary log file").arg(fileName));
+    }
+
+    return true;
+}
+
+/**
+ * Closes the file opened using \ref open()
+ */
+void GCF::BinaryLogReader::close()
+{
+    d->file.close();
+    d->errorMessage.clear();
+    d->contexts.clear();
+    d->templates.clear();
+    d->lastTimestamp = 0;
+}
+
+/**
+ * \return true if a file is open for reading
+ */
+bool GCF::BinaryLogReader::isOpen() const
+{
+    return d->file.isOpen();
+}
+
+/**
+ * Causes \ref readNext() to skip records whose log-level is greater than
+ * \c level. By default records of all levels are returned.
+ */
+void GCF::BinaryLogReader::setMaximumLogLevel(int level)
+{
+    d->maxLogLevel = level;
+}
+
+/**
+ * \return maximum log-level of records returned by \ref readNext()
+ */
+int GCF::BinaryLogReader::maximumLogLevel() const
+{
+    return d->maxLogLevel;
+}
+
+/**
+ * Causes \ref readNext() to skip records whose context does not start with
+ * \c prefix. By default the prefix is empty.
+ */
+void GCF::BinaryLogReader::setContextPrefix(const QString &prefix)
+{
+    d->contextPrefix = prefix;
+}
+
+/**
+ * \return context prefix of records returned by \ref readNext()
+ */
+QString GCF::BinaryLogReader::contextPrefix() const
+{
+    return d->contextPrefix;
+}
+
+/**
+ * Causes \ref readNext() to skip records that were not logged between
+ * \c from and \c to, both inclusive. An invalid date-time leaves that end
+ * of the range open.
+ */
+void GCF::BinaryLogReader::setTimeRange(const QDateTime &from, const QDateTime &to)
+{
+    d->fromTime = from;
+    d->toTime = to;
+}
+
+/**
+ * \return start of the time range set using \ref setTimeRange()
+ */
+QDateTime GCF::BinaryLogReader::fromTime() const
+{
+    return d->fromTime;
+}
+
+/**
+ * \return end of the time range set using \ref setTimeRange()
+ */
+QDateTime GCF::BinaryLogReader::toTime() const
+{
+    return d->toTime;
+}
+
+/**
+ * Reads the next record that passes all filters into \c record.
+ *
+ * @return true if a record was read. False is returned at the end of the
+ * file or when the file is corrupt; \ref errorMessage() will be non-empty
+ * in the latter case.
+ */
+bool GCF::BinaryLogReader::readNext(GCF::BinaryLogRecord &record)
+{
+    if(!d->file.isOpen() || !d->errorMessage.isEmpty())
+        return false;
+
+    char type = 0;
+    while(d->file.getChar(&type))
+    {
+        switch(type)
+        {
+        case GCF::BinaryLog::SessionRecord: {
+            quint64 base = 0;
+            if(!d->readVarint(base))
+                return false;
+            d->contexts.clear();
+            d->templates.clear();
+            d->lastTimestamp = qint64(base);
+            } break;
+
+        case GCF::BinaryLog::ContextRecord: {
+            QString context;
+            if(!d->readString(context))
+                return false;
+            d->contexts.append(context);
+            } break;
+
+        case GCF::BinaryLog::TemplateRecord: {
+            QString tmpl;
+            if(!d->readString(tmpl))
+                return false;
+            d->templates.append(tmpl);
+            } break;
+
+        case GCF::BinaryLog::MessageRecord:
+            if(!d->readMessage(record))
+                return false;
+            if(d->accepts(record))
+                return true;
+            break;
+
+        default:
+            return d->fail(QString("Unknown record type %1").arg(int(type)));
+        }
+    }
+
+    return false;
+}
+
+/**
+ * \return description of the error that stopped \ref readNext(), if any
+ */
+QString GCF::BinaryLogReader::errorMessage() const
+{
+    return d->errorMessage;
+}
+
+/**
+ * Prints \c record into \c ts in the format used by \ref GCF::Log for its
+ * text log files.
+ */
+void GCF::BinaryLogReader::print(const GCF::BinaryLogRecord &record, QTextStream &ts)
+{
+    ts << QString(record.depth*2, QChar(' ')) << record.context
+       << " : LogLevel(" << record.logLevel << ") "
+       << record.message << record.details << "\n";
+}
+
+/**
+ * Prints all records in \c fileName into \c ts, in the format used by
+ * \ref GCF::Log for its text log files.
+ */
+GCF::Result GCF::BinaryLogReader::decode(const QString &fileName, QTextStream &ts)
+{
+    GCF::BinaryLogReader reader;
+    GCF::Result result = reader.open(fileName);
+    if(!result)
+        return result;
+
+    GCF::BinaryLogRecord record;
+    while(reader.readNext(record))
+        GCF::BinaryLogReader::print(record, ts);
+
+    if(!reader.errorMessage().isEmpty())
+        return GCF::Result(false, QString(), reader.errorMessage());
+
+    return true;
+}
+
+bool GCF::BinaryLogReaderData::readVarint(quint64 &value)
+{
+    value = 0;
+    for(int shift=0; shift<64; shift += 7)
+    {
+        char ch = 0;
+        if(!this->file.getChar(&ch))
+            return this->fail("Truncated record");
+
+        value |= quint64(uchar(ch) & 0x7F) << shift;
+        if(!(uchar(ch) & 0x80))
+            return true;
+    }
+
+    return this->fail("Malformed number");
+}
+
+bool GCF::BinaryLogReaderData::readBytes(QByteArray &bytes)
+{
+    quint64 size = 0;
+    if(!this->readVarint(size))
+        return false;
+
+    if(size > quint64(this->file.bytesAvailable()))
+        return this->fail("Truncated record");
+
+    bytes = this->file.read(qint64(size));
+    return true;
+}
+
+bool GCF::BinaryLogReaderData::readString(QString &str)
+{
+    QByteArray bytes;
+    if(!this->readBytes(bytes))
+        return false;
+
+    str = QString::fromUtf8(bytes);
+    return true;
+}
+
+bool GCF::BinaryLogReaderData::readInterned(const QStringList &table, QString &str)
+{
+    quint64 id = 0;
+    if(!this->readVarint(id))
+        return false;
+
+    if(id == 0)
+        return this->readString(str);
+
+    if(id > quint64(table.count()))
+        return this->fail(QString("Unknown string id %1").arg(id));
+
+    str = table.at(int(id-1));
+    return true;
+}
+
+bool GCF::BinaryLogReaderData::readMessage(GCF::BinaryLogRecord &record)
+{
+    quint64 depth = 0, level = 0, delta = 0, argCount = 0;
+    QString tmpl;
+
+    if(!this->readVarint(depth) || !this->readVarint(level) || !this->readVarint(delta))
+        return false;
+
+    if(!this->readInterned(this->contexts, record.context) || !this->readInterned(this->templates, tmpl))
+        return false;
+
+    if(!this->readVarint(argCount))
+        return false;
+
+    record.depth = int(depth);
+    record.logLevel = int(level);
+    this->lastTimestamp += GCF::BinaryLog::unZigZag(delta);
+    record.timestamp = this->lastTimestamp;
+
+    record.message.clear();
+    record.message.reserve(tmpl.length());
+    int start = 0;
+    for(quint64 i=0; i<argCount; i++)
+    {
+        quint64 arg = 0;
+        if(!this->readVarint(arg))
+            return false;
+
+        QString argStr;
+        if(arg & 1)
+        {
+            if(arg/2 > quint64(this->file.bytesAvailable()))
+                return this->fail("Truncated record");
+            argStr = QString::fromUtf8(this->file.read(qint64(arg/2)));
+        }
+        else
+            argStr = QString::number(arg >> 1);
+
+        const int marker = tmpl.indexOf(QChar(GCF::BinaryLog::ArgumentMarker), start);
+        if(marker < 0)
+            return this->fail("Argument count does not match template");
+
+        record.message.append(tmpl.midRef(start, marker-start));
+        record.message.append(argStr);
+        start = marker+1;
+    }
+    record.message.append(tmpl.midRef(start));
+
+    return this->readBytes(record.logCode) && this->readString(record.details);
+}
+
+bool GCF::BinaryLogReaderData::accepts(const GCF::BinaryLogRecord &record) const
+{
+    if(record.logLevel > this->maxLogLevel)
+        return false;
+
+    if(!this->contextPrefix.isEmpty() && !record.context.startsWith(this->contextPrefix))
+        return false;
+
+    if(this->fromTime.isValid() && record.timestamp < this->fromTime.toMSecsSinceEpoch())
+        return false;
+
+    if(this->toTime.isValid() && record.timestamp > this->toTime.toMSecsSinceEpoch())
+        return false;
+
+    return true;
+}
+
+bool GCF::BinaryLogReaderData::fail(const QString &msg)
+{
+    this->errorMessage = msg;
+    return false;
+}
@@ -0,0 +1,95 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef BINARYLOGHANDLER_H
+#define BINARYLOGHANDLER_H
+
+#include "GCFGlobal.h"
+#include "Log.h"
+
+#include <QDateTime>
+
+namespace GCF
+{
+
+struct BinaryLogHandlerData;
+class GCF_EXPORT BinaryLogHandler : public GCF::LogMessageHandlerInterface
+{
+public:
+    BinaryLogHandler(const QString &fileName=QString());
+    ~BinaryLogHandler();
+
+    QString fileName() const;
+
+    // LogMessageHandlerInterface implementation
+    void handleLogMessage(GCF::LogMessage *msg);
+    void print(GCF::LogMessage *msg, QTextStream &ts);
+    void flush();
+
+private:
+    BinaryLogHandlerData *d;
+};
+
+struct BinaryLogRecord
+{
+    BinaryLogRecord() : depth(0), logLevel(GCF::LogMessage::Info), timestamp(0) { }
+
+    int depth;
+    int logLevel;
+    qint64 timestamp;
+    QString context;
+    QByteArray logCode;
+    QString message;
+    QString details;
+};
+
+struct BinaryLogReaderData;
+class GCF_EXPORT BinaryLogReader
+{
+public:
+    BinaryLogReader();
+    ~BinaryLogReader();
+
+    GCF::Result open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    // Filters applied by readNext()
+    void setMaximumLogLevel(int level);
+    int maximumLogLevel() const;
+
+    void setContextPrefix(const QString &prefix);
+    QString contextPrefix() const;
+
+    void setTimeRange(const QDateTime &from, const QDateTime &to);
+    QDateTime fromTime() const;
+    QDateTime toTime() const;
+
+    bool readNext(GCF::BinaryLogRecord &record);
+    QString errorMessage() const;
+
+    static void print(const GCF::BinaryLogRecord &record, QTextStream &ts);
+    static GCF::Result decode(const QString &fileName, QTextStream &ts);
+
+private:
+    BinaryLogReaderData *d;
+};
+
+}
+
+#endif // BINARYLOGHANDLER_H
@@ -25,6 +25,7 @@ VERSION = 3.0.0
 HEADERS += \
     Version.h \
     Log.h \
+    BinaryLogHandler.h \
     ObjectList.h \
     ObjectList_p.h \
     ObjectMap.h \
@@ -35,18 +36,27 @@ HEADERS += \
     GCFGlobal.h \
     Application_p.h \
     SignalSpy.h \
+    MultiSignalSpy.h \
     AbstractJob.h \
-    JobListModel.h
+    JobListModel.h \
+    JobScheduler.h \
+    ThreadedJob.h \
+    JobJournal.h
 
 SOURCES += \
     Log.cpp \
+    BinaryLogHandler.cpp \
     ObjectList.cpp \
     ObjectTree.cpp \
     Application.cpp \
     Component.cpp \
     GCFGlobal.cpp \
     Application_p.cpp \
-    Job.cpp
+    MultiSignalSpy.cpp \
+    Job.cpp \
+    JobScheduler.cpp \
+    ThreadedJob.cpp \
+    JobJournal.cpp
 
 OTHER_FILES += \
     Version.dox \
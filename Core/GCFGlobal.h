@@ -153,4 +153,10 @@ Q_DECLARE_METATYPE(GCF::Result)
 
 #define GCF_TRANSLATE(x) // This macro is used for applying translations
 
+// Tag for invokable methods that may be called from any thread. Methods
+// tagged this way are run on a worker thread by invokeMethodAsync().
+#ifndef Q_MOC_RUN
+#define GCF_THREAD_SAFE
+#endif
+
 #endif // GCF_H
@@ -55,11 +55,29 @@ updates by calling \ref setProgress() regularly. You must notify job completion
 calling the \ref done() method. Jobs can be abruptly aborted using the \ref abort()
 method. You can also notify non-critical error messages using the \ref setError() method.
 
+Jobs that report progress very often can have their \ref updated() signal throttled
+using \ref setUpdateRate(). Changes made by \ref setTitle(), \ref setDescription(),
+\ref setIcon(), \ref setIconUrl(), \ref setStatus() and \ref setProgress() are then
+reported at most \ref updateRate() times a second. Changes in the state of the job;
+like start, suspend, resume, cancel, error and completion, are always reported
+right away, along with any pending change.
+
 */
 
 #include "AbstractJob.h"
 #include "Application.h"
 
+#include <QSet>
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+#include <QAtomicInt>
+#include <QBasicTimer>
+#include <QTimerEvent>
+#include <QElapsedTimer>
+
+#include <algorithm>
+
 namespace GCF
 {
 
@@ -68,15 +86,26 @@ struct AbstractJobData
     AbstractJobData(const QString &k) : kind(k),
         progress(0), started(false),
         suspended(false), complete(false),
-        hasError(false) { }
+        hasError(false), updateRate(0),
+        updatePending(false), updateTimer(nullptr) { }
 
     const QString kind;
     QString title, description, iconUrl, status, error;
     QVariant icon;
     int progress;
     bool started, suspended, complete, hasError;
+
+    // Throttling of updated() signals
+    int updateRate;
+    bool updatePending;
+    QElapsedTimer lastUpdate;
+    QTimer *updateTimer; // created on demand; single-shot
+
+    static QAtomicInt DefaultUpdateRate;
 };
 
+QAtomicInt AbstractJobData::DefaultUpdateRate(0);
+
 }
 
 /**
@@ -89,6 +118,7 @@ GCF::AbstractJob::AbstractJob(const QString &kind, QObject *parent)
     : QObject(parent)
 {
     d = new AbstractJobData(kind);
+    d->updateRate = AbstractJobData::DefaultUpdateRate.loadAcquire();
     gAppService->jobs()->addJob(this);
 }
 
@@ -165,6 +195,57 @@ string.
 */
 QString GCF::AbstractJob::error() const { return d->error; }
 
+/**
+Sets the maximum number of times per second that the \ref updated() signal is
+emitted for changes in title, description, icon, status and progress. Changes
+made in between are coalesced and reported together. Changes in the state of the
+job are reported immediately, so the final state of the job is always reported.
+
+\param rate maximum number of updates per second. Zero (default) disables throttling.
+
+\note User interfaces would typically set a rate close to their refresh rate, while
+headless servers may choose a much lower rate; or use \ref setDefaultUpdateRate().
+*/
+void GCF::AbstractJob::setUpdateRate(int rate)
+{
+    rate = qMax(rate, 0);
+    if(d->updateRate == rate)
+        return;
+
+    d->updateRate = rate;
+    if(rate == 0)
+        this->emitPendingUpdate();
+
+    emit updateRateChanged(this);
+}
+
+/**
+\return maximum number of \ref updated() signals emitted per second for changes
+in title, description, icon, status and progress. Zero means no throttling.
+\sa setUpdateRate()
+*/
+int GCF::AbstractJob::updateRate() const { return d->updateRate; }
+
+/**
+Sets the update rate that jobs created after this call will have.
+
+\param rate maximum number of updates per second. Zero (default) disables throttling.
+\sa setUpdateRate()
+*/
+void GCF::AbstractJob::setDefaultUpdateRate(int rate)
+{
+    AbstractJobData::DefaultUpdateRate.storeRelease(qMax(rate, 0));
+}
+
+/**
+\return the update rate that newly created jobs will have
+\sa setDefaultUpdateRate()
+*/
+int GCF::AbstractJob::defaultUpdateRate()
+{
+    return AbstractJobData::DefaultUpdateRate.loadAcquire();
+}
+
 /**
 Starts the job. If the job is already started or completed, then returns
 GCF::Result with status false and error message. Otherwise starts the job by
@@ -195,7 +276,7 @@ GCF::Result GCF::AbstractJob::start()
         d->error.clear();
     }
 
-    emit updated(this);
+    this->emitUpdated(false);
     if(d->started)
         emit started(this);
 
@@ -233,7 +314,7 @@ GCF::Result GCF::AbstractJob::cancel()
         d->error.clear();
     }
 
-    emit updated(this);
+    this->emitUpdated(false);
 
     if(d->complete)
         emit completed(this);
@@ -265,7 +346,7 @@ GCF::Result GCF::AbstractJob::suspend()
     {
         d->suspended = true;
         d->status = "Suspended";
-        emit updated(this);
+        this->emitUpdated(false);
         emit suspended(this);
     }
 
@@ -291,7 +372,7 @@ GCF::Result GCF::AbstractJob::resume()
     {
         d->suspended = false;
         d->status = "Resumed";
-        emit updated(this);
+        this->emitUpdated(false);
         emit resumed(this);
     }
 
@@ -320,7 +401,7 @@ GCF::Result GCF::AbstractJob::retry()
         d->hasError = false;
         d->progress = 0;
         d->status.clear();
-        emit updated(this);
+        this->emitUpdated(false);
 
         GCF::Result result = this->retryJob();
         d->started = result.isSuccess();
@@ -336,7 +417,7 @@ GCF::Result GCF::AbstractJob::retry()
             d->error.clear();
         }
 
-        emit updated(this);
+        this->emitUpdated(false);
         if(d->started)
             emit started(this);
 
@@ -346,6 +427,29 @@ GCF::Result GCF::AbstractJob::retry()
     return GCF::Result(false, QString(), "Could not retry because the job is still running!");
 }
 
+/**
+\fn QVariantMap GCF::AbstractJob::saveState() const
+
+Reimplement this function to return the state that is needed to recreate the
+job and continue it from where it is now; for example the URL, destination
+file and byte offset of a download. Jobs that return a non-empty map are
+journaled by \ref GCF::JobJournal. The default implementation returns an
+empty map.
+
+\sa restoreState()
+*/
+
+/**
+\fn bool GCF::AbstractJob::restoreState(const QVariantMap &state)
+
+Reimplement this function to restore a job, that was just created, from a
+\c state returned by \ref saveState(). The job is started after this function
+returns, if it was running when the state was saved. The default implementation
+returns false.
+
+\return true if the state was restored, false otherwise.
+*/
+
 /**
 \fn GCF::AbstractJob::startJob() = 0;
 This is a pure virtual function. All jobs inheriting from \c AbstractJob
@@ -375,7 +479,7 @@ Sets the title of the job as \c title.
 void GCF::AbstractJob::setTitle(const QString &title)
 {
     d->title = title;
-    emit updated(this);
+    this->emitUpdated(true);
 }
 
 /**
@@ -385,7 +489,7 @@ Sets the description of the job as \c desc.
 void GCF::AbstractJob::setDescription(const QString &desc)
 {
     d->description = desc;
-    emit updated(this);
+    this->emitUpdated(true);
 }
 
 /**
@@ -395,7 +499,7 @@ Sets the icon url of job as \c iconUrl.
 void GCF::AbstractJob::setIconUrl(const QString &iconUrl)
 {
     d->iconUrl = iconUrl;
-    emit updated(this);
+    this->emitUpdated(true);
 }
 
 /**
@@ -410,7 +514,7 @@ void GCF::AbstractJob::setIcon(const QVariant &icon)
     else
         d->icon = QVariant();
 
-    emit updated(this);
+    this->emitUpdated(true);
 }
 
 /**
@@ -420,7 +524,7 @@ Sets the status message of job as \c statusMsg.
 void GCF::AbstractJob::setStatus(const QString &statusMsg)
 {
     d->status = statusMsg;
-    emit updated(this);
+    this->emitUpdated(true);
 }
 
 /**
@@ -437,7 +541,7 @@ void GCF::AbstractJob::setProgress(int val, const QString &msg)
         if(!msg.isNull()) // We are checking isNull() [not isEmpty()] on purpose
             d->status = msg;
 
-        emit updated(this);
+        this->emitUpdated(true);
     }
 }
 
@@ -455,7 +559,7 @@ void GCF::AbstractJob::setError(const QString &errMsg, bool abort)
     if(abort && d->started)
         d->complete = true;
 
-    emit updated(this);
+    this->emitUpdated(false);
 
     if(d->complete && d->started)
         emit completed(this);
@@ -468,7 +572,7 @@ void GCF::AbstractJob::clearError()
 {
     d->hasError = false;
     d->error.clear();
-    emit updated(this);
+    this->emitUpdated(false);
 }
 
 /**
@@ -494,10 +598,41 @@ void GCF::AbstractJob::done()
     d->hasError = false;
     d->complete = true;
     d->progress = 100;
-    emit updated(this);
+    this->emitUpdated(false);
     emit completed(this);
 }
 
+void GCF::AbstractJob::emitUpdated(bool throttled)
+{
+    const int interval = d->updateRate ? qMax(1000/d->updateRate, 1) : 0;
+    if(throttled && interval && d->lastUpdate.isValid() && d->lastUpdate.elapsed() < interval)
+    {
+        // Report this change when the interval is over
+        d->updatePending = true;
+        if(!d->updateTimer)
+        {
+            d->updateTimer = new QTimer(this);
+            d->updateTimer->setSingleShot(true);
+            connect(d->updateTimer, SIGNAL(timeout()), this, SLOT(emitPendingUpdate()));
+        }
+        if(!d->updateTimer->isActive())
+            d->updateTimer->start(int(interval - d->lastUpdate.elapsed()));
+        return;
+    }
+
+    if(d->updateTimer)
+        d->updateTimer->stop();
+    d->updatePending = false;
+    d->lastUpdate.start();
+    emit updated(this);
+}
+
+void GCF::AbstractJob::emitPendingUpdate()
+{
+    if(d->updatePending)
+        this->emitUpdated(false);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -524,17 +659,171 @@ required information.
 You can control the columns available in the model, and its order, by making use of the
 \ref GCF::JobListModel::setColumns(const QList<int> &columns) method.
 
+The model keeps a snapshot of the attributes of every job, which is refreshed
+whenever the job emits \ref GCF::AbstractJob::updated(). So \ref data() does not
+call into the jobs. Use \ref rolesForRange() to fetch several attributes of
+several jobs in one call.
+
+Updates reported by jobs are coalesced. The \c dataChanged() signal is emitted
+for all jobs updated within a frame (16 milliseconds), one signal per contiguous
+block of rows. The \ref jobUpdated() and \ref allJobsComplete() signals are
+emitted right away.
+
 When the JobListModel is deleted it will cancel and delete all the jobs in it.
 */
 
 namespace GCF
 {
 
+/*
+ * Attributes of the jobs in the model, one array per attribute,
+ * indexed by row.
+ */
+struct JobSnapshots
+{
+    enum Flag
+    {
+        Started = 1,
+        Suspended = 2,
+        Complete = 4,
+        HasError = 8
+    };
+
+    QVector<QString> kinds;
+    QVector<QString> titles;
+    QVector<QString> descriptions;
+    QVector<QString> iconUrls;
+    QVector<QString> statuses;
+    QVector<QString> errors;
+    QVector<QVariant> icons;
+    QVector<int> progress;
+    QVector<quint8> flags;
+
+    void insert(int row, const GCF::AbstractJob *job) {
+        kinds.insert(row, QString());
+        titles.insert(row, QString());
+        descriptions.insert(row, QString());
+        iconUrls.insert(row, QString());
+        statuses.insert(row, QString());
+        errors.insert(row, QString());
+        icons.insert(row, QVariant());
+        progress.insert(row, 0);
+        flags.insert(row, 0);
+        this->update(row, job);
+    }
+
+    void update(int row, const GCF::AbstractJob *job) {
+        kinds[row] = job->kind();
+        titles[row] = job->title();
+        descriptions[row] = job->description();
+        iconUrls[row] = job->iconUrl();
+        statuses[row] = job->status();
+        errors[row] = job->error();
+        icons[row] = job->icon();
+        progress[row] = job->progress();
+
+        quint8 f = 0;
+        if(job->isStarted()) f |= Started;
+        if(job->isSuspended()) f |= Suspended;
+        if(job->isComplete()) f |= Complete;
+        if(job->hasError()) f |= HasError;
+        flags[row] = f;
+    }
+
+    void remove(int row) {
+        kinds.remove(row);
+        titles.remove(row);
+        descriptions.remove(row);
+        iconUrls.remove(row);
+        statuses.remove(row);
+        errors.remove(row);
+        icons.remove(row);
+        progress.remove(row);
+        flags.remove(row);
+    }
+
+    QVariant value(int row, int field) const {
+        switch(field) {
+        case GCF::JobListModel::Kind: return kinds.at(row);
+        case GCF::JobListModel::Title: return titles.at(row);
+        case GCF::JobListModel::Description: return descriptions.at(row);
+        case GCF::JobListModel::Icon: return icons.at(row);
+        case GCF::JobListModel::IconUrl: return iconUrls.at(row);
+        case GCF::JobListModel::Progress: return progress.at(row);
+        case GCF::JobListModel::Status: return statuses.at(row);
+        case GCF::JobListModel::IsStarted: return bool(flags.at(row) & Started);
+        case GCF::JobListModel::IsSuspended: return bool(flags.at(row) & Suspended);
+        case GCF::JobListModel::IsComplete: return bool(flags.at(row) & Complete);
+        case GCF::JobListModel::IsRunning: return (flags.at(row) & (Started|Complete)) == Started;
+        case GCF::JobListModel::HasError: return bool(flags.at(row) & HasError);
+        case GCF::JobListModel::Error: return errors.at(row);
+        default: break;
+        }
+        return QVariant();
+    }
+};
+
 struct JobsListModelData
 {
+    JobsListModelData() : incompleteJobs(0), pendingRemovals(0) { }
+
+    enum { UpdateInterval = 16 }; // dataChanged() is emitted at most once a frame
+
+    struct JobState
+    {
+        int row;
+        bool complete;
+    };
+
     GCF::ObjectList jobs;
     QList<int> columns;
 
+    // Row and last known completion state of each job. These are kept up to
+    // date on insertion and removal, so that job updates are handled in
+    // constant time.
+    QHash<QObject*,JobState> jobStates;
+    int incompleteJobs;
+
+    // Refreshed when jobs emit updated()
+    JobSnapshots snapshots;
+
+    // Jobs updated since dataChanged() was last emitted
+    QSet<QObject*> updatedJobs;
+    QBasicTimer updateTimer;
+    int pendingRemovals;
+
+    void shiftRows(int from, int delta) {
+        QHash<QObject*,JobState>::iterator it = jobStates.begin();
+        for(; it != jobStates.end(); ++it) {
+            if(it.value().row >= from)
+                it.value().row += delta;
+        }
+    }
+
+    void insertJob(GCF::AbstractJob *job, int row) {
+        this->shiftRows(row, 1);
+        JobState state;
+        state.row = row;
+        state.complete = job->isComplete();
+        jobStates.insert(job, state);
+        snapshots.insert(row, job);
+        if(!state.complete)
+            ++incompleteJobs;
+    }
+
+    void forgetJob(QObject *job) {
+        QHash<QObject*,JobState>::iterator it = jobStates.find(job);
+        if(it == jobStates.end())
+            return;
+        const int row = it.value().row;
+        if(!it.value().complete)
+            --incompleteJobs;
+        jobStates.erase(it);
+        snapshots.remove(row);
+        updatedJobs.remove(job);
+        this->shiftRows(row+1, -1);
+    }
+
     int insertIndex(const GCF::AbstractJob *newJob) const {
         for(int i=0; i<jobs.count(); i++) {
             const GCF::AbstractJob *job = (GCF::AbstractJob*)jobs.at(i);
@@ -567,9 +856,15 @@ Destructor.
 */
 GCF::JobListModel::~JobListModel()
 {
+    emit aboutToBeDestroyed();
+
+    // Jobs are taken out of the list before they are cancelled. Cancelling
+    // doesn't remove a job, and fails for jobs that never started.
+    d->jobs.setEventListener(nullptr);
     while(d->jobs.count())
     {
         GCF::AbstractJob *job = (GCF::AbstractJob *)d->jobs.first();
+        d->jobs.remove(job);
         job->cancel();
         job->deleteLater();
     }
@@ -583,7 +878,7 @@ Adds a job to the job list model.
 */
 bool GCF::JobListModel::addJob(AbstractJob *job)
 {
-    if(d->jobs.contains(job))
+    if(!job || d->jobStates.contains(job))
         return false;
 
     int index = d->insertIndex(job);
@@ -596,6 +891,7 @@ bool GCF::JobListModel::addJob(AbstractJob *job)
     connect(job, SIGNAL(resumed(GCF::AbstractJob*)), this, SIGNAL(jobResumed(GCF::AbstractJob*)));
     connect(job, SIGNAL(completed(GCF::AbstractJob*)), this, SIGNAL(jobCompleted(GCF::AbstractJob*)));
     d->jobs.insert(index, job);
+    d->insertJob(job, index);
     this->endInsertRows();
 
     emit jobCountChanged();
@@ -636,7 +932,7 @@ GCF::AbstractJob *GCF::JobListModel::jobAt(int index) const
 */
 bool GCF::JobListModel::containsJob(GCF::AbstractJob *job) const
 {
-    return d->jobs.contains(job);
+    return d->jobStates.contains(job);
 }
 
 /**
@@ -644,7 +940,8 @@ bool GCF::JobListModel::containsJob(GCF::AbstractJob *job) const
 */
 int GCF::JobListModel::indexOfJob(GCF::AbstractJob *job) const
 {
-    return d->jobs.indexOf(job);
+    QHash<QObject*,JobsListModelData::JobState>::const_iterator it = d->jobStates.constFind(job);
+    return it == d->jobStates.constEnd() ? -1 : it.value().row;
 }
 
 /**
@@ -777,6 +1074,9 @@ provided with the \c index parameter. Here \c role is an enumeration value in
 \param index index of the job
 \param role \ref GCF::JobListModel::Field which represents specific data
 about \ref GCF::AbstractJob.
+
+\note Values are returned from a snapshot that is refreshed whenever the job
+emits \ref GCF::AbstractJob::updated().
 */
 QVariant GCF::JobListModel::data(const QModelIndex &index, int role) const
 {
@@ -791,27 +1091,66 @@ QVariant GCF::JobListModel::data(const QModelIndex &index, int role) const
             role = Title;
     }
 
-    GCF::AbstractJob *job = this->jobAt(index.row());
-    switch(role)
+    const int row = index.row();
+    if(row < 0 || row >= d->snapshots.flags.count())
+        return QVariant();
+
+    if(role == Object)
+        return QVariant::fromValue<QObject*>( d->jobs.at(row) );
+
+    return d->snapshots.value(row, role);
+}
+
+/**
+Returns attributes of jobs in rows \c first to \c last (both inclusive), in one
+call. This is useful for views and mirrors (for example over IPC) that need
+many attributes of many jobs at once.
+
+\param first first row
+\param last last row
+\param roles list of \ref GCF::JobListModel::Field values to return. If empty,
+all fields except \ref GCF::JobListModel::Object are returned.
+\return a list with one \c QVariantMap per row. Keys of the map are role names,
+as returned by \ref roleNames(); for example "jobTitle".
+*/
+QVariantList GCF::JobListModel::rolesForRange(int first, int last, const QList<int> &roles) const
+{
+    QVariantList ret;
+
+    first = qMax(first, 0);
+    last = qMin(last, d->snapshots.flags.count()-1);
+    if(first > last)
+        return ret;
+
+    QList<int> fields = roles;
+    if(fields.isEmpty())
     {
-    case Kind: return job->kind();
-    case Title: return job->title();
-    case Description: return job->description();
-    case Icon: return job->icon();
-    case IconUrl: return job->iconUrl();
-    case Progress: return job->progress();
-    case Status: return job->status();
-    case IsStarted: return job->isStarted();
-    case IsSuspended: return job->isSuspended();
-    case IsComplete: return job->isComplete();
-    case IsRunning: return job->isRunning();
-    case HasError: return job->hasError();
-    case Error: return job->error();
-    case Object: return QVariant::fromValue<QObject*>( (QObject*)job );
-    default: break;
+        for(int field=Kind; field<Object; field++)
+            fields.append(field);
     }
 
-    return QVariant();
+    const QHash<int,QByteArray> names = this->roleNames();
+    QList<QString> keys;
+    keys.reserve(fields.count());
+    Q_FOREACH(int field, fields)
+        keys.append( QString::fromLatin1(names.value(field)) );
+
+    ret.reserve(last-first+1);
+    for(int row=first; row<=last; row++)
+    {
+        QVariantMap map;
+        for(int i=0; i<fields.count(); i++)
+        {
+            const int field = fields.at(i);
+            if(field == Object)
+                map[keys.at(i)] = QVariant::fromValue<QObject*>( d->jobs.at(row) );
+            else
+                map[keys.at(i)] = d->snapshots.value(row, field);
+        }
+        ret.append(map);
+    }
+
+    return ret;
 }
 
 /**
@@ -895,6 +1234,7 @@ void GCF::JobListModel::clearCompletedJobs()
         d->jobs.setEventListener(0);
         d->jobs.remove(job);
         d->jobs.setEventListener(this);
+        d->forgetJob(job);
         job->deleteLater();
         this->endRemoveRows();
     }
@@ -987,35 +1327,91 @@ This signal is emitted when a job in the model has been resumed.
 This signal is emitted when a job in the model got completed.
 */
 
+/**
+\fn GCF::JobListModel::aboutToBeDestroyed()
+This signal is emitted from the destructor, before the jobs in the model are
+cancelled. Jobs cancelled after this signal are still reported through
+\ref jobCompleted(); connect to this signal to tell them apart from jobs that
+really completed.
+*/
+
 void GCF::JobListModel::objectRemoved(int index, QObject *obj)
 {
     disconnect(obj, nullptr, this, nullptr);
+    ++d->pendingRemovals;
+
+    // Rows are renumbered only after views have been told about the removal
     this->beginRemoveRows(QModelIndex(), index, index);
+    d->forgetJob(obj);
     QMetaObject::invokeMethod(this, "endRemove", Qt::QueuedConnection);
 }
 
 void GCF::JobListModel::endRemove()
 {
+    --d->pendingRemovals;
     this->endRemoveRows();
     emit jobCountChanged();
 }
 
 void GCF::JobListModel::onJobUpdated()
 {
-    int index = d->jobs.indexOf(this->sender());
-    if(index < 0)
+    QHash<QObject*,JobsListModelData::JobState>::iterator it = d->jobStates.find(this->sender());
+    if(it == d->jobStates.end())
         return;
 
-    QModelIndex start = this->index(index, 0);
-    QModelIndex end = this->index(index, d->columns.count() ? d->columns.count()-1 : 0);
-    emit dataChanged(start, end);
+    GCF::AbstractJob *job = (GCF::AbstractJob*)this->sender();
+    d->snapshots.update(it.value().row, job);
 
-    for(int i=0; i<d->jobs.count(); i++)
+    const bool complete = job->isComplete();
+    if(complete != it.value().complete)
     {
-        GCF::AbstractJob *job = (GCF::AbstractJob *)d->jobs.at(i);
-        if(!job->isComplete())
-            return;
+        it.value().complete = complete;
+        d->incompleteJobs += complete ? -1 : 1;
     }
 
-    emit allJobsComplete();
+    d->updatedJobs.insert(this->sender());
+    if(!d->updateTimer.isActive())
+        d->updateTimer.start(JobsListModelData::UpdateInterval, this);
+
+    if(d->incompleteJobs == 0)
+        emit allJobsComplete();
+}
+
+/**
+\internal
+
+Emits \c dataChanged() for jobs updated since the last time, one signal per
+contiguous block of rows.
+*/
+void GCF::JobListModel::timerEvent(QTimerEvent *te)
+{
+    if(te->timerId() != d->updateTimer.timerId())
+    {
+        QAbstractListModel::timerEvent(te);
+        return;
+    }
+
+    // Rows are being removed. Try again after endRemove().
+    if(d->pendingRemovals)
+        return;
+
+    d->updateTimer.stop();
+
+    QList<int> rows;
+    rows.reserve(d->updatedJobs.count());
+    Q_FOREACH(QObject *job, d->updatedJobs)
+        rows.append(d->jobStates.value(job).row);
+    d->updatedJobs.clear();
+    std::sort(rows.begin(), rows.end());
+
+    const int lastColumn = d->columns.count() ? d->columns.count()-1 : 0;
+    int i = 0;
+    while(i < rows.count())
+    {
+        int j = i;
+        while(j+1 < rows.count() && rows.at(j+1) == rows.at(j)+1)
+            ++j;
+        emit dataChanged(this->index(rows.at(i), 0), this->index(rows.at(j), lastColumn));
+        i = j+1;
+    }
 }
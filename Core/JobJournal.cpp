@@ -0,0 +1,634 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "JobJournal.h"
+#include "JobListModel.h"
+#include "Application.h"
+#include "Log.h"
+
+#include <QFile>
+#if QT_VERSION >= 0x050000
+#include <QSaveFile>
+#endif
+#include <QHash>
+#include <QSet>
+#include <QUuid>
+#include <QPointer>
+#include <QDataStream>
+#include <QStringList>
+#include <QElapsedTimer>
+
+namespace GCF
+{
+
+struct JobJournalRecord
+{
+    JobJournalRecord() : flags(0) { }
+
+    enum Flag
+    {
+        Running = 1,
+        Suspended = 2
+    };
+
+    QString kind;
+    quint8 flags;
+    QVariantMap state;
+};
+
+struct JobJournalEntry
+{
+    QString id;
+    QElapsedTimer lastSave;
+};
+
+struct JobJournalData
+{
+    JobJournalData() : saveInterval(1000), recordCount(0), readOnly(false) { }
+
+    enum RecordType
+    {
+        SaveRecord = 1,
+        RemoveRecord = 2
+    };
+
+    static const QByteArray Magic;
+
+    QString fileName;
+    QPointer<GCF::JobListModel> jobListModel;
+    int saveInterval;
+    QHash<QString,GCF::JobJournal::JobCreator> creators;
+
+    // Latest record of every job that is in the journal, in the order
+    // in which the jobs were first journaled.
+    QHash<QString,JobJournalRecord> records;
+    QStringList recordOrder;
+
+    // Jobs that are being journaled in this session
+    QHash<QObject*,JobJournalEntry> jobs;
+    QSet<QString> boundIds;
+
+    QFile file;
+    int recordCount; // number of records in the file
+
+    // Set if the file could not be read as a journal. Such files are never
+    // written to, so that files which are not journals are left untouched.
+    bool readOnly;
+
+    bool readJournal();
+    void recoverJournal();
+    QByteArray encodeRecord(int type, const QString &id) const;
+    void writeFrame(QIODevice *device, const QByteArray &payload) const;
+};
+
+const QByteArray JobJournalData::Magic("GCFJRNL\1", 8);
+
+}
+
+/**
+\class GCF::JobJournal JobJournal.h <GCF3/JobJournal>
+\brief Journals jobs to disk, so that they can be restored after a restart
+\ingroup gcf_core
+
+Jobs that reimplement \ref GCF::AbstractJob::saveState() and \ref GCF::AbstractJob::restoreState()
+can be persisted across application restarts using this class. The journal watches
+jobs in a \ref GCF::JobListModel and appends the state of a job to the journal file
+whenever the job is started, suspended or resumed. While the job runs, its state is
+saved at most once every \ref saveInterval() milliseconds. Once the job completes
+(or is cancelled) it is removed from the journal. Jobs that are cancelled because
+the \ref GCF::JobListModel is destroyed, when the application quits for example,
+remain in the journal with their latest state.
+
+On startup, register a creator function for every kind of job that can be
+restored and call \ref restoreJobs(). Each job in the journal is created and its
+state is restored. Jobs that were running when their state was saved are started
+right away; others are left for the application to start.
+
+\code
+GCF::JobJournal *journal = new GCF::JobJournal(GCF::settingsDirectory() + "/Jobs.journal",
+                                               gAppService->jobs(), gApp);
+journal->registerJobKind<DownloadJob>("Download");
+journal->restoreJobs();
+\endcode
+
+The journal file is append-only; it is rewritten to contain only the latest
+record of every job by \ref compact(). This is done when jobs are restored and
+whenever most of the file is made up of stale records. A record that was only
+partially written, when the application crashed for example, is ignored and
+cut off the end of the file. If the file exists but is not a job journal, the
+journal does not write to it.
+*/
+
+/**
+Constructor. Reads the journal from \c fileName, if it exists.
+
+\param fileName name of the journal file
+\param jobListModel model whose jobs are journaled. Restored jobs are added into this
+model. If null, \c gAppService->jobs() is used.
+\param parent parent object
+*/
+GCF::JobJournal::JobJournal(const QString &fileName, GCF::JobListModel *jobListModel, QObject *parent)
+    : QObject(parent)
+{
+    d = new JobJournalData;
+    d->fileName = fileName;
+    d->jobListModel = jobListModel ? jobListModel : gAppService->jobs();
+    d->readJournal();
+
+    connect(d->jobListModel, SIGNAL(jobStarted(GCF::AbstractJob*)), this, SLOT(onJobStateChanged(GCF::AbstractJob*)));
+    connect(d->jobListModel, SIGNAL(jobSuspended(GCF::AbstractJob*)), this, SLOT(onJobStateChanged(GCF::AbstractJob*)));
+    connect(d->jobListModel, SIGNAL(jobResumed(GCF::AbstractJob*)), this, SLOT(onJobStateChanged(GCF::AbstractJob*)));
+    connect(d->jobListModel, SIGNAL(jobUpdated(GCF::AbstractJob*)), this, SLOT(onJobUpdated(GCF::AbstractJob*)));
+    connect(d->jobListModel, SIGNAL(jobCompleted(GCF::AbstractJob*)), this, SLOT(onJobCompleted(GCF::AbstractJob*)));
+    connect(d->jobListModel, SIGNAL(aboutToBeDestroyed()), this, SLOT(onJobListModelAboutToBeDestroyed()),
+            Qt::DirectConnection);
+}
+
+/**
+Destructor. Jobs that are in the journal remain in it, to be restored later.
+*/
+GCF::JobJournal::~JobJournal()
+{
+    d->file.close();
+    delete d;
+}
+
+/**
+\return name of the journal file
+*/
+QString GCF::JobJournal::fileName() const
+{
+    return d->fileName;
+}
+
+/**
+\return model whose jobs are journaled
+*/
+GCF::JobListModel *GCF::JobJournal::jobListModel() const
+{
+    return d->jobListModel;
+}
+
+/**
+Sets the minimum interval between two saves of a running job, in response
+to its \ref GCF::AbstractJob::updated() signal. Changes in the state of jobs
+are always saved right away. By default the interval is 1000 milliseconds.
+
+\param msecs interval in milliseconds
+*/
+void GCF::JobJournal::setSaveInterval(int msecs)
+{
+    d->saveInterval = qMax(msecs, 0);
+}
+
+/**
+\return the minimum interval between two saves of a running job
+*/
+int GCF::JobJournal::saveInterval() const
+{
+    return d->saveInterval;
+}
+
+/**
+Registers a function that creates jobs of \c kind, for use by \ref restoreJobs().
+The template version of this function registers a function that creates a job
+of type \c T using its default constructor.
+
+\param kind kind of job, as returned by \ref GCF::AbstractJob::kind()
+\param creator function that creates a job of \c kind
+*/
+void GCF::JobJournal::registerJobKind(const QString &kind, JobCreator creator)
+{
+    if(creator)
+        d->creators.insert(kind, creator);
+    else
+        d->creators.remove(kind);
+}
+
+/**
+\return true if a creator function is registered for jobs of \c kind
+*/
+bool GCF::JobJournal::isJobKindRegistered(const QString &kind) const
+{
+    return d->creators.contains(kind);
+}
+
+/**
+Creates and restores jobs from the journal, and adds them to \ref jobListModel().
+Jobs that were running when their state was last saved are started. Jobs whose
+kind is not registered stay in the journal; jobs whose state could not be restored
+are removed from it.
+
+This function should be called once, during startup.
+
+\return list of restored jobs. The caller owns the jobs.
+*/
+QList<GCF::AbstractJob*> GCF::JobJournal::restoreJobs()
+{
+    QList<GCF::AbstractJob*> restoredJobs;
+    QList<GCF::AbstractJob*> runningJobs;
+
+    const QStringList ids = d->recordOrder;
+    Q_FOREACH(QString id, ids)
+    {
+        if(d->boundIds.contains(id))
+            continue;
+
+        const JobJournalRecord record = d->records.value(id);
+        JobCreator creator = d->creators.value(record.kind);
+        if(!creator)
+        {
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                QString("No creator registered for jobs of kind '%1'").arg(record.kind));
+            continue;
+        }
+
+        GCF::AbstractJob *job = creator();
+        if(!job)
+            continue;
+
+        if(!job->restoreState(record.state))
+        {
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                QString("Could not restore job of kind '%1' from the journal").arg(record.kind));
+            delete job;
+            d->records.remove(id);
+            d->recordOrder.removeAll(id);
+            continue;
+        }
+
+        JobJournalEntry entry;
+        entry.id = id;
+        d->jobs.insert(job, entry);
+        d->boundIds.insert(id);
+        connect(job, SIGNAL(destroyed(QObject*)), this, SLOT(onJobDestroyed(QObject*)));
+
+        if(d->jobListModel && !d->jobListModel->containsJob(job))
+            d->jobListModel->addJob(job);
+
+        restoredJobs.append(job);
+        if(record.flags == JobJournalRecord::Running)
+            runningJobs.append(job);
+    }
+
+    this->compact();
+
+    Q_FOREACH(GCF::AbstractJob *job, runningJobs)
+    {
+        GCF::Result result = job->start();
+        if(!result.isSuccess())
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                QString("Could not start restored job '%1'. %2")
+                .arg(job->title()).arg(result.message()));
+    }
+
+    return restoredJobs;
+}
+
+/**
+Saves the state of \c job into the journal right away. Jobs are saved
+automatically when their state changes; call this function to save important
+milestones of a job in between.
+
+\return true if the state was saved. Jobs whose \ref GCF::AbstractJob::saveState()
+returns an empty map are not saved; nor are jobs saved if the journal file is not
+a job journal.
+*/
+bool GCF::JobJournal::saveJob(GCF::AbstractJob *job)
+{
+    if(!job || d->readOnly)
+        return false;
+
+    const QVariantMap state = job->saveState();
+    if(state.isEmpty())
+        return false;
+
+    if(!d->jobs.contains(job))
+    {
+        JobJournalEntry entry;
+        entry.id = QUuid::createUuid().toString();
+        d->jobs.insert(job, entry);
+        d->boundIds.insert(entry.id);
+        connect(job, SIGNAL(destroyed(QObject*)), this, SLOT(onJobDestroyed(QObject*)));
+    }
+
+    JobJournalEntry &entry = d->jobs[job];
+    entry.lastSave.start();
+
+    JobJournalRecord record;
+    record.kind = job->kind();
+    record.state = state;
+    if(job->isRunning())
+        record.flags = job->isSuspended() ? JobJournalRecord::Suspended : JobJournalRecord::Running;
+
+    if(!d->records.contains(entry.id))
+        d->recordOrder.append(entry.id);
+    d->records.insert(entry.id, record);
+
+    return this->writeRecord(JobJournalData::SaveRecord, entry.id);
+}
+
+/**
+\return true if \c job is in the journal
+*/
+bool GCF::JobJournal::isJournaled(GCF::AbstractJob *job) const
+{
+    return d->jobs.contains(job) && d->records.contains(d->jobs.value(job).id);
+}
+
+/**
+\return number of jobs in the journal, including those that are yet to be restored
+*/
+int GCF::JobJournal::journaledJobCount() const
+{
+    return d->records.count();
+}
+
+/**
+Rewrites the journal file, so that it contains only the latest record of
+every job. The file is replaced only after the new contents have been
+written completely; so the journal survives a crash during this function.
+
+\return success if the file was rewritten
+*/
+GCF::Result GCF::JobJournal::compact()
+{
+    if(d->readOnly)
+        return GCF::Result(false, QString(), QString("%1 is not a job journal").arg(d->fileName));
+
+#if QT_VERSION >= 0x050000
+    QSaveFile tempFile(d->fileName);
+    if(!tempFile.open(QFile::WriteOnly))
+        return GCF::Result(false, QString(), tempFile.errorString());
+
+    tempFile.write(JobJournalData::Magic);
+    Q_FOREACH(QString id, d->recordOrder)
+        d->writeFrame(&tempFile, d->encodeRecord(JobJournalData::SaveRecord, id));
+
+    d->file.close();
+    if(!tempFile.commit())
+        return GCF::Result(false, QString(), tempFile.errorString());
+#else
+    // The old file is moved aside before the new one takes its place.
+    // JobJournalData::recoverJournal() completes this, if it is interrupted.
+    const QString tempFileName = d->fileName + ".tmp";
+    const QString backupFileName = d->fileName + ".bak";
+    QFile tempFile(tempFileName);
+    if(!tempFile.open(QFile::WriteOnly|QFile::Truncate))
+        return GCF::Result(false, QString(), tempFile.errorString());
+
+    tempFile.write(JobJournalData::Magic);
+    Q_FOREACH(QString id, d->recordOrder)
+        d->writeFrame(&tempFile, d->encodeRecord(JobJournalData::SaveRecord, id));
+    tempFile.close();
+
+    if(tempFile.error() != QFile::NoError)
+    {
+        QFile::remove(tempFileName);
+        return GCF::Result(false, QString(), tempFile.errorString());
+    }
+
+    d->file.close();
+    QFile::remove(backupFileName);
+    if(QFile::exists(d->fileName) && !QFile::rename(d->fileName, backupFileName))
+    {
+        QFile::remove(tempFileName);
+        return GCF::Result(false, QString(), QString("Could not replace %1").arg(d->fileName));
+    }
+
+    if(!QFile::rename(tempFileName, d->fileName))
+    {
+        QFile::rename(backupFileName, d->fileName);
+        return GCF::Result(false, QString(), QString("Could not replace %1").arg(d->fileName));
+    }
+
+    QFile::remove(backupFileName);
+#endif
+
+    d->recordCount = d->recordOrder.count();
+    return true;
+}
+
+void GCF::JobJournal::onJobStateChanged(GCF::AbstractJob *job)
+{
+    this->saveJob(job);
+}
+
+void GCF::JobJournal::onJobUpdated(GCF::AbstractJob *job)
+{
+    // Only jobs that were journaled when they started are saved on updates
+    if(!job->isRunning() || job->isSuspended() || !d->jobs.contains(job))
+        return;
+
+    const JobJournalEntry &entry = d->jobs[job];
+    if(entry.lastSave.isValid() && entry.lastSave.elapsed() < d->saveInterval)
+        return;
+
+    this->saveJob(job);
+}
+
+void GCF::JobJournal::onJobCompleted(GCF::AbstractJob *job)
+{
+    if(!d->jobs.contains(job))
+        return;
+
+    const QString id = d->jobs.value(job).id;
+    if(d->records.remove(id))
+    {
+        d->recordOrder.removeAll(id);
+        this->writeRecord(JobJournalData::RemoveRecord, id);
+    }
+}
+
+void GCF::JobJournal::onJobDestroyed(QObject *job)
+{
+    // The record stays in the journal, so that the job can be restored
+    d->boundIds.remove(d->jobs.value(job).id);
+    d->jobs.remove(job);
+}
+
+void GCF::JobJournal::onJobListModelAboutToBeDestroyed()
+{
+    // The model cancels all of its jobs while it is destroyed. That is not
+    // completion; so the journal stops watching before it happens, and keeps
+    // the latest state of jobs that are still running.
+    disconnect(d->jobListModel, nullptr, this, nullptr);
+
+    QList<QObject*> jobs = d->jobs.keys();
+    Q_FOREACH(QObject *object, jobs)
+    {
+        GCF::AbstractJob *job = static_cast<GCF::AbstractJob*>(object);
+        if(job->isRunning())
+            this->saveJob(job);
+    }
+}
+
+bool GCF::JobJournal::writeRecord(int type, const QString &id)
+{
+    if(d->readOnly)
+        return false;
+
+    if(!d->file.isOpen())
+    {
+        d->file.setFileName(d->fileName);
+        if(!d->file.open(QFile::WriteOnly|QFile::Append))
+        {
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                QString("Could not open job journal %1. %2").arg(d->fileName).arg(d->file.errorString()));
+            return false;
+        }
+
+        if(d->file.size() == 0)
+            d->file.write(JobJournalData::Magic);
+    }
+
+    d->writeFrame(&d->file, d->encodeRecord(type, id));
+    d->file.flush();
+    ++d->recordCount;
+
+    // Compact the journal when it is mostly made up of stale records
+    if(d->recordCount > 64 && d->recordCount > 4*d->records.count())
+        this->compact();
+
+    return d->file.error() == QFile::NoError;
+}
+
+bool GCF::JobJournalData::readJournal()
+{
+    this->recoverJournal();
+
+    QFile journalFile(fileName);
+    if(!journalFile.exists())
+        return true;
+
+    if(!journalFile.open(QFile::ReadOnly))
+    {
+        GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+            QString("Could not read job journal %1. %2").arg(fileName).arg(journalFile.errorString()));
+        readOnly = true;
+        return false;
+    }
+
+    if(journalFile.size() == 0)
+        return true;
+
+    if(journalFile.read(Magic.size()) != Magic)
+    {
+        GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+            QString("%1 is not a job journal").arg(fileName));
+        readOnly = true;
+        return false;
+    }
+
+    // Records appended after an incomplete record would be taken to be a
+    // part of it. So the file is cut back to the end of the last complete one.
+    qint64 goodOffset = journalFile.pos();
+
+    QDataStream ds(&journalFile);
+    ds.setVersion(QDataStream::Qt_4_8);
+    while(journalFile.bytesAvailable() >= qint64(sizeof(quint32)))
+    {
+        quint32 length = 0;
+        ds >> length;
+        if(qint64(length) > journalFile.bytesAvailable())
+            break;
+
+        const QByteArray payload = journalFile.read(length);
+        QDataStream rs(payload);
+        rs.setVersion(QDataStream::Qt_4_8);
+
+        quint8 type = 0;
+        QString id;
+        rs >> type >> id;
+        if(type == SaveRecord)
+        {
+            JobJournalRecord record;
+            rs >> record.kind >> record.flags >> record.state;
+            if(rs.status() == QDataStream::Ok)
+            {
+                if(!records.contains(id))
+                    recordOrder.append(id);
+                records.insert(id, record);
+            }
+        }
+        else if(type == RemoveRecord)
+        {
+            if(records.remove(id))
+                recordOrder.removeAll(id);
+        }
+
+        goodOffset = journalFile.pos();
+        ++recordCount;
+    }
+
+    if(goodOffset < journalFile.size())
+    {
+        GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+            QString("Removing incomplete record at the end of job journal %1").arg(fileName));
+        journalFile.close();
+        if(!QFile::resize(fileName, goodOffset))
+        {
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                QString("Could not truncate job journal %1").arg(fileName));
+            readOnly = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GCF::JobJournalData::recoverJournal()
+{
+    // Completes a compaction that was interrupted after the journal was moved
+    // aside. The temporary file was complete by then, so it is preferred.
+    const QString tempFileName = fileName + ".tmp";
+    const QString backupFileName = fileName + ".bak";
+    if(!QFile::exists(fileName) && QFile::exists(backupFileName))
+    {
+        if(!QFile::exists(tempFileName) || !QFile::rename(tempFileName, fileName))
+            QFile::rename(backupFileName, fileName);
+    }
+
+    QFile::remove(tempFileName);
+    QFile::remove(backupFileName);
+}
+
+QByteArray GCF::JobJournalData::encodeRecord(int type, const QString &id) const
+{
+    QByteArray payload;
+    QDataStream ds(&payload, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_4_8);
+    ds << quint8(type) << id;
+
+    if(type == SaveRecord)
+    {
+        const JobJournalRecord record = records.value(id);
+        ds << record.kind << record.flags << record.state;
+    }
+
+    return payload;
+}
+
+void GCF::JobJournalData::writeFrame(QIODevice *device, const QByteArray &payload) const
+{
+    QDataStream ds(device);
+    ds.setVersion(QDataStream::Qt_4_8);
+    ds << quint32(payload.size());
+    device->write(payload);
+}
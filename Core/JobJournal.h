@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef JOBJOURNAL_H
+#define JOBJOURNAL_H
+
+#include "GCFGlobal.h"
+#include "AbstractJob.h"
+
+#include <QObject>
+
+namespace GCF
+{
+
+struct JobJournalData;
+class GCF_EXPORT JobJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    JobJournal(const QString &fileName, GCF::JobListModel *jobListModel=nullptr, QObject *parent=nullptr);
+    ~JobJournal();
+
+    QString fileName() const;
+    GCF::JobListModel *jobListModel() const;
+
+    void setSaveInterval(int msecs);
+    int saveInterval() const;
+
+    typedef GCF::AbstractJob *(*JobCreator)();
+    void registerJobKind(const QString &kind, JobCreator creator);
+    template <class T> void registerJobKind(const QString &kind) {
+        this->registerJobKind(kind, &GCF::JobJournal::createJob<T>);
+    }
+    bool isJobKindRegistered(const QString &kind) const;
+
+    QList<GCF::AbstractJob*> restoreJobs();
+    bool saveJob(GCF::AbstractJob *job);
+    bool isJournaled(GCF::AbstractJob *job) const;
+    int journaledJobCount() const;
+    GCF::Result compact();
+
+private slots:
+    void onJobStateChanged(GCF::AbstractJob *job);
+    void onJobUpdated(GCF::AbstractJob *job);
+    void onJobCompleted(GCF::AbstractJob *job);
+    void onJobDestroyed(QObject *job);
+    void onJobListModelAboutToBeDestroyed();
+
+private:
+    template <class T> static GCF::AbstractJob *createJob() { return new T; }
+    bool writeRecord(int type, const QString &id);
+
+private:
+    JobJournalData *d;
+};
+
+}
+
+#endif // JOBJOURNAL_H
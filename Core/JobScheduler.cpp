@@ -0,0 +1,441 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "JobScheduler.h"
+#include "JobListModel.h"
+#include "Application.h"
+#include "Log.h"
+
+#include <QSet>
+#include <QHash>
+
+namespace GCF
+{
+
+struct JobSchedulerData
+{
+    JobSchedulerData() : jobListModel(nullptr), maxRunningJobs(0),
+        queuedCount(0), nextSequence(0), dispatching(false) { }
+
+    struct QueueEntry
+    {
+        GCF::AbstractJob *job;
+        int priority;
+        quint64 sequence;
+    };
+
+    GCF::JobListModel *jobListModel;
+    int maxRunningJobs;
+    QHash<QString,int> maxRunningJobsPerKind;
+
+    // One queue per kind. Higher priority jobs come first; jobs of the
+    // same priority are in the order in which they were scheduled.
+    QHash< QString, QList<QueueEntry> > queues;
+    QHash<QObject*,int> priorities; // of queued jobs
+    int queuedCount;
+    quint64 nextSequence;
+
+    QHash<QObject*,QString> jobKinds; // of all jobs watched by the scheduler
+    QSet<QObject*> runningJobs;
+    QHash<QString,int> runningCounts;
+
+    bool dispatching;
+
+    void enqueue(GCF::AbstractJob *job, int priority) {
+        QueueEntry entry;
+        entry.job = job;
+        entry.priority = priority;
+        entry.sequence = nextSequence++;
+
+        QList<QueueEntry> &queue = queues[jobKinds.value(job)];
+        int index = queue.count();
+        while(index > 0 && queue.at(index-1).priority < priority)
+            --index;
+        queue.insert(index, entry);
+        priorities.insert(job, priority);
+        ++queuedCount;
+    }
+
+    bool dequeue(QObject *job) {
+        if(!priorities.remove(job))
+            return false;
+
+        const QString kind = jobKinds.value(job);
+        QList<QueueEntry> &queue = queues[kind];
+        for(int i=0; i<queue.count(); i++) {
+            if(queue.at(i).job == job) {
+                queue.removeAt(i);
+                break;
+            }
+        }
+        if(queue.isEmpty())
+            queues.remove(kind);
+        --queuedCount;
+        return true;
+    }
+};
+
+}
+
+/**
+\class GCF::JobScheduler JobScheduler.h <GCF3/JobScheduler>
+\brief Starts jobs in the order of their priority, within concurrency limits
+\ingroup gcf_core
+
+Jobs scheduled using \ref schedule() are queued by their \ref GCF::AbstractJob::kind().
+The scheduler starts queued jobs, highest priority first, as long as the number
+of running jobs is within \ref maximumRunningJobs() and the number of running jobs
+of that kind is within \ref maximumRunningJobs(const QString &kind). Whenever a
+running job completes, is suspended or is destroyed, the next job in the queue is
+started.
+
+\code
+GCF::JobScheduler *scheduler = new GCF::JobScheduler(gAppService->jobs(), this);
+scheduler->setMaximumRunningJobs(8);
+scheduler->setMaximumRunningJobs("Download", 4);
+
+Q_FOREACH(const QUrl &url, urls)
+    scheduler->schedule( new DownloadJob(url) );
+\endcode
+
+A suspended job does not count as a running job. Scheduling a suspended job
+queues it for \ref GCF::AbstractJob::resume(), and scheduling a completed (or
+cancelled) job queues it for \ref GCF::AbstractJob::retry(). Jobs that are
+resumed or retried directly count as running jobs, even if that takes the number
+of running jobs over the limit; in which case no more jobs are started until
+the number is within the limit again.
+*/
+
+/**
+Constructor
+
+\param jobListModel model into which scheduled jobs are added, if they are
+not in it already. If null, \c gAppService->jobs() is used.
+\param parent parent object
+*/
+GCF::JobScheduler::JobScheduler(GCF::JobListModel *jobListModel, QObject *parent)
+    : QObject(parent)
+{
+    d = new JobSchedulerData;
+    d->jobListModel = jobListModel ? jobListModel : gAppService->jobs();
+}
+
+/**
+Destructor. Jobs that are still in the queue are not started.
+*/
+GCF::JobScheduler::~JobScheduler()
+{
+    delete d;
+}
+
+/**
+\return the model into which scheduled jobs are added
+*/
+GCF::JobListModel *GCF::JobScheduler::jobListModel() const
+{
+    return d->jobListModel;
+}
+
+/**
+Sets the maximum number of jobs that can be running at any point in time.
+
+\param count maximum number of running jobs. Zero (default) means no limit.
+*/
+void GCF::JobScheduler::setMaximumRunningJobs(int count)
+{
+    d->maxRunningJobs = qMax(count, 0);
+    this->dispatch();
+}
+
+/**
+\return maximum number of jobs that can be running at any point in time
+*/
+int GCF::JobScheduler::maximumRunningJobs() const
+{
+    return d->maxRunningJobs;
+}
+
+/**
+Sets the maximum number of jobs of \c kind that can be running at any point
+in time.
+
+\param kind kind of jobs
+\param count maximum number of running jobs of \c kind. Zero (default) means no limit.
+*/
+void GCF::JobScheduler::setMaximumRunningJobs(const QString &kind, int count)
+{
+    if(count > 0)
+        d->maxRunningJobsPerKind[kind] = count;
+    else
+        d->maxRunningJobsPerKind.remove(kind);
+
+    this->dispatch();
+}
+
+/**
+\return maximum number of jobs of \c kind that can be running at any point in time
+*/
+int GCF::JobScheduler::maximumRunningJobs(const QString &kind) const
+{
+    return d->maxRunningJobsPerKind.value(kind, 0);
+}
+
+/**
+Queues \c job to be started when the limits allow. If the job is suspended, it
+is queued to be resumed. If it is complete, it is queued to be retried. The job
+is added to \ref jobListModel() if it is not already in it.
+
+\param job job to schedule
+\param priority priority of the job. Jobs with higher priority are started first.
+\return success if the job was queued. Running jobs cannot be scheduled.
+*/
+GCF::Result GCF::JobScheduler::schedule(GCF::AbstractJob *job, int priority)
+{
+    if(!job)
+        return GCF::Result(false, QString(), "Job not specified");
+
+    if(job->isRunning() && !job->isSuspended())
+        return GCF::Result(false, QString(), "Job is already running");
+
+    if(d->priorities.contains(job))
+        return GCF::Result(false, QString(), "Job is already scheduled");
+
+    if(d->jobListModel && !d->jobListModel->containsJob(job))
+        d->jobListModel->addJob(job);
+
+    this->watchJob(job);
+    d->enqueue(job, priority);
+    emit jobQueued(job);
+    emit jobCountChanged();
+
+    this->dispatch();
+    return true;
+}
+
+/**
+Removes \c job from the queue.
+
+\return true if the job was in the queue, false otherwise.
+*/
+bool GCF::JobScheduler::unschedule(GCF::AbstractJob *job)
+{
+    if(!d->dequeue(job))
+        return false;
+
+    emit jobCountChanged();
+    return true;
+}
+
+/**
+Changes priority of a queued \c job.
+
+\return true if the job was in the queue, false otherwise.
+*/
+bool GCF::JobScheduler::setPriority(GCF::AbstractJob *job, int priority)
+{
+    if(!d->dequeue(job))
+        return false;
+
+    d->enqueue(job, priority);
+    return true;
+}
+
+/**
+\return priority of a queued \c job; zero if the job is not in the queue.
+*/
+int GCF::JobScheduler::priority(GCF::AbstractJob *job) const
+{
+    return d->priorities.value(job, 0);
+}
+
+/**
+\return true if \c job is in the queue
+*/
+bool GCF::JobScheduler::isQueued(GCF::AbstractJob *job) const
+{
+    return d->priorities.contains(job);
+}
+
+/**
+\return true if \c job was scheduled using this scheduler and is running
+now; that is, it has started, and is neither suspended nor complete.
+*/
+bool GCF::JobScheduler::isRunning(GCF::AbstractJob *job) const
+{
+    return d->runningJobs.contains(job);
+}
+
+/**
+\return number of jobs in the queue
+*/
+int GCF::JobScheduler::queuedJobCount() const
+{
+    return d->queuedCount;
+}
+
+/**
+\return number of jobs of \c kind in the queue
+*/
+int GCF::JobScheduler::queuedJobCount(const QString &kind) const
+{
+    return d->queues.value(kind).count();
+}
+
+/**
+\return number of scheduled jobs that are running
+*/
+int GCF::JobScheduler::runningJobCount() const
+{
+    return d->runningJobs.count();
+}
+
+/**
+\return number of scheduled jobs of \c kind that are running
+*/
+int GCF::JobScheduler::runningJobCount(const QString &kind) const
+{
+    return d->runningCounts.value(kind, 0);
+}
+
+/**
+\fn void GCF::JobScheduler::jobQueued(GCF::AbstractJob *job)
+This signal is emitted when \c job is added to the queue.
+*/
+
+/**
+\fn void GCF::JobScheduler::jobDispatched(GCF::AbstractJob *job)
+This signal is emitted when \c job is taken from the queue and started, resumed
+or retried.
+*/
+
+/**
+\fn void GCF::JobScheduler::jobCountChanged()
+This signal is emitted when the number of queued or running jobs changes.
+*/
+
+void GCF::JobScheduler::onJobStateChanged(GCF::AbstractJob *job)
+{
+    const bool running = job->isStarted() && !job->isSuspended() && !job->isComplete();
+
+    // Jobs that are started directly are no longer waiting
+    if(running)
+        d->dequeue(job);
+
+    this->markRunning(job, running);
+    if(!running)
+        this->dispatch();
+}
+
+void GCF::JobScheduler::onJobDestroyed(QObject *job)
+{
+    d->dequeue(job);
+    this->markRunning(job, false);
+    d->jobKinds.remove(job);
+    this->dispatch();
+}
+
+void GCF::JobScheduler::watchJob(GCF::AbstractJob *job)
+{
+    if(d->jobKinds.contains(job))
+        return;
+
+    d->jobKinds.insert(job, job->kind());
+    connect(job, SIGNAL(started(GCF::AbstractJob*)), this, SLOT(onJobStateChanged(GCF::AbstractJob*)));
+    connect(job, SIGNAL(suspended(GCF::AbstractJob*)), this, SLOT(onJobStateChanged(GCF::AbstractJob*)));
+    connect(job, SIGNAL(resumed(GCF::AbstractJob*)), this, SLOT(onJobStateChanged(GCF::AbstractJob*)));
+    connect(job, SIGNAL(completed(GCF::AbstractJob*)), this, SLOT(onJobStateChanged(GCF::AbstractJob*)));
+    connect(job, SIGNAL(destroyed(QObject*)), this, SLOT(onJobDestroyed(QObject*)));
+}
+
+bool GCF::JobScheduler::hasCapacity(const QString &kind) const
+{
+    if(d->maxRunningJobs && d->runningJobs.count() >= d->maxRunningJobs)
+        return false;
+
+    const int maxJobs = d->maxRunningJobsPerKind.value(kind, 0);
+    return !maxJobs || d->runningCounts.value(kind, 0) < maxJobs;
+}
+
+void GCF::JobScheduler::markRunning(QObject *job, bool running)
+{
+    if(running == d->runningJobs.contains(job))
+        return;
+
+    const QString kind = d->jobKinds.value(job);
+    if(running)
+    {
+        d->runningJobs.insert(job);
+        ++d->runningCounts[kind];
+    }
+    else
+    {
+        d->runningJobs.remove(job);
+        if(--d->runningCounts[kind] <= 0)
+            d->runningCounts.remove(kind);
+    }
+
+    emit jobCountChanged();
+}
+
+void GCF::JobScheduler::dispatch()
+{
+    // Jobs that change state while being dispatched call this function again
+    if(d->dispatching)
+        return;
+
+    d->dispatching = true;
+    while(true)
+    {
+        // Pick the highest priority job among kinds that can run one more job
+        const JobSchedulerData::QueueEntry *next = nullptr;
+        QHash< QString, QList<JobSchedulerData::QueueEntry> >::const_iterator it = d->queues.constBegin();
+        for(; it != d->queues.constEnd(); ++it)
+        {
+            if(!this->hasCapacity(it.key()))
+                continue;
+
+            const JobSchedulerData::QueueEntry &head = it.value().first();
+            if(!next || head.priority > next->priority ||
+               (head.priority == next->priority && head.sequence < next->sequence))
+                next = &head;
+        }
+
+        if(!next)
+            break;
+
+        GCF::AbstractJob *job = next->job;
+        d->dequeue(job);
+
+        GCF::Result result;
+        if(!job->isStarted())
+            result = job->start();
+        else if(job->isSuspended())
+            result = job->resume();
+        else
+            result = job->retry();
+
+        if(result.isSuccess())
+            emit jobDispatched(job);
+        else
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                                          QString("Could not start job '%1'. %2")
+                                          .arg(job->title()).arg(result.message()));
+        emit jobCountChanged();
+    }
+    d->dispatching = false;
+}
@@ -0,0 +1,86 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include "GCFGlobal.h"
+#include "AbstractJob.h"
+
+#include <QObject>
+
+namespace GCF
+{
+
+struct JobSchedulerData;
+class GCF_EXPORT JobScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    JobScheduler(GCF::JobListModel *jobListModel=nullptr, QObject *parent=nullptr);
+    ~JobScheduler();
+
+    GCF::JobListModel *jobListModel() const;
+
+    Q_PROPERTY(int maximumRunningJobs READ maximumRunningJobs WRITE setMaximumRunningJobs)
+    void setMaximumRunningJobs(int count);
+    int maximumRunningJobs() const;
+
+    void setMaximumRunningJobs(const QString &kind, int count);
+    int maximumRunningJobs(const QString &kind) const;
+
+    GCF::Result schedule(GCF::AbstractJob *job, int priority=0);
+    bool unschedule(GCF::AbstractJob *job);
+
+    bool setPriority(GCF::AbstractJob *job, int priority);
+    int priority(GCF::AbstractJob *job) const;
+
+    bool isQueued(GCF::AbstractJob *job) const;
+    bool isRunning(GCF::AbstractJob *job) const;
+
+    Q_PROPERTY(int queuedJobCount READ queuedJobCount NOTIFY jobCountChanged)
+    int queuedJobCount() const;
+    int queuedJobCount(const QString &kind) const;
+
+    Q_PROPERTY(int runningJobCount READ runningJobCount NOTIFY jobCountChanged)
+    int runningJobCount() const;
+    int runningJobCount(const QString &kind) const;
+
+signals:
+    void jobQueued(GCF::AbstractJob *job);
+    void jobDispatched(GCF::AbstractJob *job);
+    void jobCountChanged();
+
+private slots:
+    void onJobStateChanged(GCF::AbstractJob *job);
+    void onJobDestroyed(QObject *job);
+
+private:
+    void watchJob(GCF::AbstractJob *job);
+    bool hasCapacity(const QString &kind) const;
+    void markRunning(QObject *job, bool running);
+    void dispatch();
+
+private:
+    JobSchedulerData *d;
+};
+
+}
+
+#endif // JOBSCHEDULER_H
@@ -22,6 +22,9 @@
 #include <QUrl>
 #include <QDir>
 #include <QFile>
+#include <QSet>
+#include <QHash>
+#include <QPair>
 #include <QStack>
 #include <QMutex>
 #include <QtDebug>
@@ -30,12 +33,21 @@
 #include <QStringList>
 #include <QBasicTimer>
 #include <QTextStream>
+#include <QTimerEvent>
 #include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QWaitCondition>
+#include <QReadWriteLock>
 
 #if QT_VERSION >= 0x050900
 #include <QOperatingSystemVersion>
 #endif
 
+#include <cstring>
+#include <algorithm>
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -166,14 +178,300 @@ happened in the context of a \c function() call or a direct call.
 
 namespace GCF
 {
+
+/*
+ * Writes log records on a dedicated thread, for the asynchronous mode of
+ * GCF::Log. Producers post preformatted text into a bounded lock-free ring
+ * buffer (Vyukov's bounded queue, used here with a single consumer). The
+ * writer thread keeps the log file open and flushes it once per batch.
+ * Producers that find the ring full sleep until the writer frees up slots.
+ */
+class LogWriter : public QThread
+{
+public:
+    LogWriter();
+    ~LogWriter();
+
+    void post(const QString &fileName, const QString &text);
+    void flush();
+    void stop();
+
+protected:
+    void run();
+
+private:
+    bool tryPost(const QString &fileName, const QString &text);
+    int writeBatch();
+    bool isEmpty() const;
+    void wakeWriter();
+
+private:
+    enum { Capacity = 4096, BatchSize = 256 };
+    struct Record
+    {
+        QAtomicInt sequence;
+        QString fileName;
+        QString text;
+    };
+    Record m_records[Capacity];
+    QAtomicInt m_head;     // next slot to be claimed by a producer
+    uint m_tail;           // next slot to be read by the writer
+    QAtomicInt m_written;  // number of records written so far
+    QAtomicInt m_sleeping;
+    QAtomicInt m_blocked;  // number of producers waiting for a free slot
+    QAtomicInt m_closeFile;
+    QAtomicInt m_stop;
+    QMutex m_waitMutex;
+    QWaitCondition m_wakeup;
+    QWaitCondition m_idle;
+    QWaitCondition m_space;
+    QFile m_file;
+    QTextStream m_stream;
+};
+
+struct LogMessageData
+{
+    LogMessageData() : logLevel(GCF::LogMessage::Info), parent(nullptr),
+        modelChildCount(0), timestamp(0), bytes(0), detached(false), retired(false),
+        sourceLine(0) { }
+
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
+#ifdef Q_OS_MAC
+    char unused[4]; // Padding added to align this struct
+#endif
+    int logLevel;
+    QString context;
+    QByteArray logCode;
+    QString message;
+    QString details;
+    QList<LogMessage*> children;
+    LogMessage *parent;
+
+    // Number of children that have been announced to the model. Children
+    // are always appended, so the model sees children[0..modelChildCount).
+    int modelChildCount;
+
+    qint64 timestamp; // msecs since epoch
+    int bytes;        // approximate memory held by this message
+
+    // True for a top-level branch that is still open. Its parent is the root
+    // message, but it is not among the root's children until it is closed.
+    bool detached;
+
+    // True for a message pruned by a thread other than the model's. It is
+    // deleted later, in the model's thread.
+    bool retired;
+
+    // Fields of the QMessageLogContext of messages routed from Qt's message
+    // handler. They are copied, because the context only guarantees that the
+    // strings are valid during the call to the message handler.
+    QByteArray sourceFile;
+    int sourceLine;
+    QByteArray sourceFunction;
+    QByteArray category;
+
+#if QT_VERSION >= 0x050000
+    void setSource(const QMessageLogContext &source) {
+        this->sourceFile = QByteArray(source.file);
+        this->sourceLine = source.line;
+        this->sourceFunction = QByteArray(source.function);
+        this->category = QByteArray(source.category);
+    }
+#endif
+
+    int estimateBytes() const {
+        return int(sizeof(GCF::LogMessage) + sizeof(LogMessageData)) +
+                (context.size() + message.size() + details.size())*int(sizeof(QChar)) +
+                logCode.size() + sourceFile.size() + sourceFunction.size() + category.size();
+    }
+};
+
+/*
+ * Fixed-size object allocator used for LogMessage and LogMessageData.
+ * Freed objects go into a free-list and are reused, so the memory
+ * footprint of the log tree stays flat once retention limits are
+ * reached. Blocks are never returned to the system while the slab
+ * is alive.
+ *
+ * Every thread keeps a small cache of free slots; so allocating and
+ * freeing objects takes no lock most of the time. Slots move between
+ * the caches and the shared free-list in batches. Objects may be freed
+ * in a thread other than the one that allocated them.
+ */
+template <class T, int BlockSize=256>
+class LogSlab
+{
+public:
+    LogSlab() : m_freeList(nullptr) { }
+    ~LogSlab() {
+        // Caches of threads that are still running are abandoned
+        Q_FOREACH(char *block, m_blocks)
+            ::operator delete(block);
+    }
+
+    void *allocate() {
+        LocalCache *cache = this->localCache();
+        if(!cache->head)
+            this->refill(cache);
+
+        FreeNode *node = cache->head;
+        cache->head = node->next;
+        --cache->count;
+        return node;
+    }
+
+    void release(void *ptr) {
+        LocalCache *cache = this->localCache();
+        FreeNode *node = static_cast<FreeNode*>(ptr);
+        node->next = cache->head;
+        cache->head = node;
+        if(++cache->count > 2*BatchSize)
+            this->drain(cache, BatchSize);
+    }
+
+private:
+    struct FreeNode { FreeNode *next; };
+    struct LocalCache
+    {
+        LocalCache(LogSlab *s) : slab(s), head(nullptr), count(0) { }
+        ~LocalCache() { slab->drain(this, count); }
+
+        LogSlab *slab;
+        FreeNode *head;
+        int count;
+    };
+    enum {
+        BatchSize = 64,
+        Alignment = sizeof(void*) > sizeof(qint64) ? sizeof(void*) : sizeof(qint64),
+        SlotSize = ((sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode)) + Alignment - 1) / Alignment * Alignment
+    };
+
+    LocalCache *localCache() {
+        if(!m_caches.hasLocalData())
+            m_caches.setLocalData(new LocalCache(this));
+        return m_caches.localData();
+    }
+
+    void refill(LocalCache *cache) {
+        QMutexLocker locker(&m_mutex);
+        for(int i=0; i<BatchSize; i++) {
+            if(!m_freeList)
+                this->grow();
+            FreeNode *node = m_freeList;
+            m_freeList = node->next;
+            node->next = cache->head;
+            cache->head = node;
+            ++cache->count;
+        }
+    }
+
+    void drain(LocalCache *cache, int count) {
+        QMutexLocker locker(&m_mutex);
+        while(count-- > 0 && cache->head) {
+            FreeNode *node = cache->head;
+            cache->head = node->next;
+            --cache->count;
+            node->next = m_freeList;
+            m_freeList = node;
+        }
+    }
+
+    void grow() {
+        char *block = static_cast<char*>(::operator new(size_t(SlotSize) * BlockSize));
+        m_blocks.append(block);
+        for(int i=BlockSize-1; i>=0; i--) {
+            FreeNode *node = reinterpret_cast<FreeNode*>(block + i*int(SlotSize));
+            node->next = m_freeList;
+            m_freeList = node;
+        }
+    }
+
+private:
+    QMutex m_mutex;
+    FreeNode *m_freeList;
+    QList<char*> m_blocks;
+    QThreadStorage<LocalCache*> m_caches;
+};
+
+struct LogThreadData
+{
+    LogThreadData() : rateGeneration(-1) { }
+
+    QStack<GCF::LogMessage*> stack;
+
+    // Level and context pairs that this thread found to have no rate limit,
+    // as of rate limit generation rateGeneration. Looked up without locking.
+    QSet< QPair<int,QString> > unlimitedRateKeys;
+    int rateGeneration;
+};
+
+struct LogRateLimit
+{
+    int level;
+    QString contextPrefix;
+    int maxPerSecond;
+    int sampleInterval;
+};
+
+// Rate limiting state of messages of one level from one context
+struct LogRateState
+{
+    LogRateState() : resolved(false), limited(false), maxPerSecond(0),
+        sampleInterval(0), windowStart(0), count(0), overflow(0), suppressed(0) { }
+
+    bool resolved;
+    bool limited;
+    int maxPerSecond;
+    int sampleInterval;
+    qint64 windowStart;
+    int count;
+    int overflow;
+    int suppressed; // in the current window; reported in a summary message
+
+    // Returns false if the message must be suppressed. When a new window
+    // starts, summarize is set to the number of messages suppressed in the
+    // previous window.
+    bool admit(qint64 now, int &summarize) {
+        if(now - this->windowStart >= 1000) {
+            summarize = this->suppressed;
+            this->windowStart = now;
+            this->count = 0;
+            this->overflow = 0;
+            this->suppressed = 0;
+        }
+
+        if(!this->limited)
+            return true;
+
+        if(this->count < this->maxPerSecond) {
+            ++this->count;
+            return true;
+        }
+
+        ++this->overflow;
+        if(this->sampleInterval && this->overflow % this->sampleInterval == 0)
+            return true;
+
+        ++this->suppressed;
+        return false;
+    }
+};
+
 struct LogData
 {
     LogData() : rootMessage(nullptr), timestamp(QDateTime::currentDateTime()),
-        logQtMessages(false), versionLogged(false) { }
+        logQtMessages(false), versionLogged(false), writer(nullptr),
+        resettingModel(false), announcingRows(false), changingRows(false),
+        maxMessageCount(0), maxMessageBytes(0),
+        maxMessageAge(0), branchRetentionLevel(GCF::LogMessage::User) { }
+
+    enum { MaxRateStates = 4096 };
 
     QMutex messageMutex;
     GCF::LogMessage *rootMessage;
-    QStack<GCF::LogMessage*> stack;
+    QThreadStorage<LogThreadData*> threadData;
     QMutex handlerMutex;
     LogMessageHandlerInterface *handler;
     QString logFile;
@@ -183,10 +481,112 @@ struct LogData
 #ifdef Q_OS_MAC
     char unused[6]; // Padding added to align this struct
 #endif
+    LogWriter *writer;
+
+    // The default handler posts messages to the writer without holding
+    // handlerMutex. This lock keeps the writer alive while it does that.
+    QReadWriteLock writerLock;
+
+    // Model updates for created and updated messages are coalesced and
+    // announced from modelUpdateTimer. Messages known to the model are never
+    // deleted while messageMutex is held, because views call back into the
+    // model while rows are removed. Retention retires them instead, and
+    // removeRetiredMessages() removes their rows in the model's thread.
+    QMutex modelMutex;
+    QSet<GCF::LogMessage*> insertedParents;
+    QSet<GCF::LogMessage*> announcingParents;
+    QSet<GCF::LogMessage*> updatedMessages;
+    QList<GCF::LogMessage*> retiredMessages;
+    QBasicTimer modelUpdateTimer;
+    QAtomicInt modelUpdateScheduled;
+    bool resettingModel;
+    bool announcingRows;
+    bool changingRows; // only used in the model's thread
+
+    // Retention policies
+    int maxMessageCount;
+    int maxMessageBytes;
+    int maxMessageAge;
+    int branchRetentionLevel;
+    QAtomicInt messageCount;
+    QAtomicInt messageBytes;
+
+    // Rate limiting. States are looked up by level and context. Messages of
+    // levels that are not in rateLevels skip rate limiting without locking.
+    // suppressedCounts holds at most MaxRateStates contexts.
+    mutable QMutex rateMutex;
+    QList<LogRateLimit> rateLimits;
+    QHash< QPair<int,QString>, LogRateState > rateStates;
+    QHash<QString,int> suppressedCounts;
+    QAtomicInt rateLimitCount;
+    QAtomicInt rateLevels;
+    QAtomicInt rateGeneration;
+    QAtomicInt suppressedCount;
+
+    // Categories of Qt messages that are logged. A null list means all
+    // categories. Replaced lists are retained until the log is destroyed,
+    // since the message handler reads them without locking.
+    QMutex qtCategoryMutex;
+    QAtomicPointer< const QList<QByteArray> > qtCategories;
+    QList< const QList<QByteArray>* > retiredQtCategories;
+
+    bool isQtCategoryLogged(const char *category) const {
+        const QList<QByteArray> *categories = this->qtCategories.loadAcquire();
+        if(!categories)
+            return true;
+        if(!category)
+            category = "default";
+        for(int i=0; i<categories->count(); i++) {
+            const QByteArray &prefix = categories->at(i);
+            if(::strncmp(category, prefix.constData(), size_t(prefix.size())) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    const LogRateLimit *findRateLimit(int level, const QString &context) const {
+        const LogRateLimit *retLimit = nullptr;
+        for(int i=0; i<this->rateLimits.count(); i++) {
+            const LogRateLimit &limit = this->rateLimits.at(i);
+            if(limit.level != level || !context.startsWith(limit.contextPrefix))
+                continue;
+            if(!retLimit || limit.contextPrefix.length() > retLimit->contextPrefix.length())
+                retLimit = &limit;
+        }
+        return retLimit;
+    }
+
+    static int rateLevelBit(int level) {
+        return (level >= 0 && level < 31) ? (1 << level) : int(1u << 31);
+    }
+
+    // Must be called with rateMutex locked, after rateLimits change or rateStates
+    // are dropped. Adding states only ever adds levels to rateLevels.
+    void updateRateTables() {
+        int levels = 0;
+        Q_FOREACH(const LogRateLimit &limit, this->rateLimits)
+            levels |= rateLevelBit(limit.level);
+        QHash< QPair<int,QString>, LogRateState >::const_iterator it = this->rateStates.constBegin();
+        for(; it != this->rateStates.constEnd(); ++it)
+            levels |= rateLevelBit(it.key().first);
+        this->rateLevels.storeRelease(levels);
+        this->rateLimitCount.storeRelease(this->rateLimits.count() + this->rateStates.count());
+    }
+
+    LogThreadData *localData() {
+        if(!this->threadData.hasLocalData())
+            this->threadData.setLocalData(new LogThreadData);
+        return this->threadData.localData();
+    }
+
+    // Branches opened by the calling thread. The bottom-most branch is not
+    // part of the tree under rootMessage, until it is closed.
+    QStack<GCF::LogMessage*> &stack() {
+        return this->localData()->stack;
+    }
 
-    GCF::LogMessage *currentBranch() const {
-        if(this->stack.count()) return this->stack.top();
-        return this->rootMessage;
+    bool hasRetentionLimits() const {
+        return this->maxMessageCount || this->maxMessageBytes || this->maxMessageAge;
     }
 };
 
@@ -202,28 +602,37 @@ GCF_INTERFACE_END
 #if QT_VERSION >= 0x050000
 void qtMsgToLogHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-    QByteArray localMsg = msg.toLocal8Bit();
-    QString logMsg = QString("%1 (%2:%3 in %4)").arg(localMsg.constData())
-            .arg(context.file).arg(context.line).arg(context.function);
-
+    int level = GCF::LogMessage::Debug;
+    QString logContext;
     switch (type)
     {
     case QtInfoMsg:
-        GCF::Log::instance()->debug("QtInfoMsg", logMsg);
+        logContext = QStringLiteral("QtInfoMsg");
         break;
     case QtDebugMsg:
-        GCF::Log::instance()->debug("QtDebugMsg", logMsg);
+        logContext = QStringLiteral("QtDebugMsg");
         break;
     case QtWarningMsg:
-        GCF::Log::instance()->warning("QtWarningMsg", logMsg);
+        level = GCF::LogMessage::Warning;
+        logContext = QStringLiteral("QtWarningMsg");
         break;
     case QtCriticalMsg:
-        GCF::Log::instance()->debug("QtCriticalMsg", logMsg);
+        logContext = QStringLiteral("QtCriticalMsg");
         break;
     case QtFatalMsg:
-        GCF::Log::instance()->fatal("QtFatalMsg", logMsg);
-        abort();
+        level = GCF::LogMessage::Fatal;
+        logContext = QStringLiteral("QtFatalMsg");
+        break;
     }
+
+    // Level and category are checked before anything is allocated. The message
+    // text is shared, and the context fields are stored without formatting.
+    GCF::Log *log = GCF::Log::instance();
+    if(GCF::Log::isEnabled(level) && log->d->isQtCategoryLogged(context.category))
+        log->addMessage(level, logContext, QByteArray(), msg, QString(), &context);
+
+    if(type == QtFatalMsg)
+        abort();
 }
 #else
 void qtMsgToLogHandler(QtMsgType type, const char *msg)
@@ -249,6 +658,10 @@ void qtMsgToLogHandler(QtMsgType type, const char *msg)
 }
 
 Q_GLOBAL_STATIC(GCF::Log2, GCFGlobalLog)
+Q_GLOBAL_STATIC(GCF::LogSlab<GCF::LogMessage>, LogMessageSlab)
+Q_GLOBAL_STATIC(GCF::LogSlab<GCF::LogMessageData>, LogMessageDataSlab)
+
+QAtomicInt GCF::Log::LevelThreshold(GCF::LogMessage::User);
 
 /**
  * \return pointer to the only instance of this class in the application
@@ -273,6 +686,15 @@ GCF::Log::Log()
  */
 GCF::Log::~Log()
 {
+    if(d->writer)
+    {
+        d->writer->stop();
+        delete d->writer;
+    }
+
+    delete d->qtCategories.loadAcquire();
+    qDeleteAll(d->retiredQtCategories);
+
     delete d;
 }
 
@@ -353,7 +775,12 @@ QString GCF::Log::logFileName() const
  * \c qFatal() and \c qCritical() messages to the log. By default logging of \c QtDebug
  * messages is disabled.
  *
+ * The file, line, function and category of such messages are available from
+ * \ref GCF::LogMessage::sourceFile(), \ref GCF::LogMessage::sourceLine(),
+ * \ref GCF::LogMessage::sourceFunction() and \ref GCF::LogMessage::category().
+ *
  * \param val true if QtDebug messages need to be logged, false otherwise.
+ * \sa setQtMessageCategories()
  */
 void GCF::Log::setLogQtMessages(bool val)
 {
@@ -376,184 +803,849 @@ void GCF::Log::setLogQtMessages(bool val)
 }
 
 /**
- * \return true if \c QtDebug messages are logged. False otherwise.
+ * Restricts logging of Qt messages to those whose category starts with one of
+ * the strings in \c categories. Messages of other categories are dropped before
+ * any memory is allocated for them. An empty list (default) logs messages of all
+ * categories. Messages logged using \c qDebug() and friends, without a category,
+ * belong to the \c "default" category.
+ *
+ * \code
+ * GCF::Log::instance()->setLogQtMessages(true);
+ * GCF::Log::instance()->setQtMessageCategories(QStringList() << "default" << "qt.network");
+ * \endcode
+ *
  * \sa setLogQtMessages()
  */
-bool GCF::Log::isLogQtMessages() const
+void GCF::Log::setQtMessageCategories(const QStringList &categories)
 {
-    return d->logQtMessages;
+    QList<QByteArray> *list = nullptr;
+    if(!categories.isEmpty())
+    {
+        list = new QList<QByteArray>;
+        Q_FOREACH(const QString &category, categories)
+            list->append(category.toLatin1());
+    }
+
+    QMutexLocker locker(&d->qtCategoryMutex);
+    const QList<QByteArray> *oldList = d->qtCategories.fetchAndStoreOrdered(list);
+    if(oldList)
+        d->retiredQtCategories.append(oldList);
 }
 
 /**
- * Logs a fatal message into the current branch
- *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param errorCode a code associated with this message
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * \return categories of Qt messages that are logged. An empty list means
+ * all categories.
+ * \sa setQtMessageCategories()
  */
-void GCF::Log::fatal(const QString &context, const QByteArray &errorCode,
-                     const QString &message, const QString &details)
+QStringList GCF::Log::qtMessageCategories() const
 {
-    QMutexLocker locker(&d->messageMutex);
-    GCF::LogMessage *msg = new GCF::LogMessage(GCF::LogMessage::Fatal,
-                                               context, errorCode, message, details,
-                                               d->currentBranch());
-    this->dumpLogMessage(msg);
+    QStringList retList;
+    const QList<QByteArray> *list = d->qtCategories.loadAcquire();
+    if(list)
+    {
+        Q_FOREACH(const QByteArray &category, *list)
+            retList.append(QString::fromLatin1(category));
+    }
+
+    return retList;
 }
 
 /**
- * Logs a error message into the current branch
+ * Enables or disables asynchronous logging. By default logging is synchronous.
  *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param errorCode a code associated with this message
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * In the synchronous mode, the default handler opens the log file, writes the
+ * message and closes the file each time a top-level message is handled.
+ *
+ * In the asynchronous mode, the default handler only formats the message and
+ * posts it to a writer thread; which keeps the log file open and writes messages
+ * in batches. Posting a message does not take any lock, so threads that log
+ * are not held up by disk I/O. Handlers set using \ref setHandler() continue
+ * to be called as before; messages they forward to \ref handleLogMessage()
+ * are written asynchronously.
+ *
+ * Call \ref flush() to make sure that all posted messages have been written.
+ *
+ * \param val true if logging should be asynchronous, false otherwise.
  */
-void GCF::Log::error(const QString &context, const QByteArray &errorCode,
-                     const QString &message, const QString &details)
+void GCF::Log::setAsynchronous(bool val)
 {
-    QMutexLocker locker(&d->messageMutex);
-    GCF::LogMessage *msg = new GCF::LogMessage(GCF::LogMessage::Error,
-                                               context, errorCode, message, details,
-                                               d->currentBranch());
-    this->dumpLogMessage(msg);
+    QMutexLocker locker(&d->handlerMutex);
+    QWriteLocker writerLocker(&d->writerLock);
+    if(val == (d->writer != nullptr))
+        return;
+
+    if(val)
+    {
+        d->writer = new GCF::LogWriter;
+        d->writer->start(QThread::LowPriority);
+    }
+    else
+    {
+        d->writer->stop();
+        delete d->writer;
+        d->writer = nullptr;
+    }
 }
 
 /**
- * Logs a warning message into the current branch
- *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param errorCode a code associated with this message
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * \return true if logging is asynchronous. False otherwise.
+ * \sa setAsynchronous()
  */
-void GCF::Log::warning(const QString &context, const QByteArray &errorCode,
-                       const QString &message, const QString &details)
+bool GCF::Log::isAsynchronous() const
 {
-    QMutexLocker locker(&d->messageMutex);
-    GCF::LogMessage *msg = new GCF::LogMessage(GCF::LogMessage::Warning,
-                                               context, errorCode, message, details,
-                                               d->currentBranch());
-    this->dumpLogMessage(msg);
+    return d->writer != nullptr;
 }
 
 /**
- * Logs a warning message into the current branch
+ * In the asynchronous mode, this function blocks until all messages posted so
+ * far have been written into the log file and the log file is closed. The file
+ * is opened again when the next message is written. In the synchronous mode
+ * this function does nothing.
  *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param errorCode a code associated with this message
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * Summaries of messages suppressed by rate limits, that are yet to be logged,
+ * are logged before flushing.
+ *
+ * \sa setAsynchronous()
  */
-void GCF::Log::debug(const QString &context, const QByteArray &errorCode,
-                     const QString &message, const QString &details)
+void GCF::Log::flush()
 {
-    QMutexLocker locker(&d->messageMutex);
-    GCF::LogMessage *msg = new GCF::LogMessage(GCF::LogMessage::Debug,
-                                               context, errorCode, message, details,
-                                               d->currentBranch());
-    this->dumpLogMessage(msg);
+    if(d->rateLimitCount.loadAcquire())
+        this->logSuppressedMessages();
+
+    QMutexLocker locker(&d->handlerMutex);
+    if(d->writer)
+        d->writer->flush();
 }
 
 /**
- * Logs a information message into the current branch
+ * Sets the log level threshold. Messages whose level is higher than \c level
+ * are discarded. By default all messages are logged.
  *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param errorCode a code associated with this message
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * The check is done before the message is created. When logging is done using
+ * the \c GCF_LOG_INFO(), \c GCF_LOG_DEBUG(), \c GCF_LOG_WARNING(),
+ * \c GCF_LOG_ERROR() and \c GCF_LOG_FATAL() macros, the check is done even before
+ * the macro arguments are evaluated. So a discarded message costs a single
+ * comparison.
+ *
+ * \code
+ * GCF::Log::instance()->setLogLevel(GCF::LogMessage::Warning);
+ *
+ * // The QString::arg() below is never evaluated
+ * GCF_LOG_INFO( QString("Loaded %1 items").arg(items.count()) );
+ * \endcode
+ *
+ * \param level one of the \ref GCF::LogMessage::LogLevel values
  */
-void GCF::Log::info(const QString &context, const QByteArray &errorCode,
-                    const QString &message, const QString &details)
+void GCF::Log::setLogLevel(int level)
 {
-    QMutexLocker locker(&d->messageMutex);
-    GCF::LogMessage *msg = new GCF::LogMessage(GCF::LogMessage::Info,
-                                               context, errorCode, message, details,
-                                               d->currentBranch());
-    this->dumpLogMessage(msg);
+    LevelThreshold.storeRelease(level);
 }
 
 /**
- * \fn void GCF::Log::info(const QString &context, const QString &message, const QString &details=QString())
- *
- * Logs a information message into the current branch
- *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * \return the log level threshold
+ * \sa setLogLevel()
  */
+int GCF::Log::logLevel() const
+{
+    return LevelThreshold.loadAcquire();
+}
 
 /**
- * \fn void GCF::Log::debug(const QString &context, const QString &message, const QString &details=QString())
- *
- * Logs a debug message into the current branch
- *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * \fn bool GCF::Log::isEnabled(int level)
+ * \return true if messages of \c level are logged. False otherwise.
+ * \sa setLogLevel()
  */
 
 /**
- * \fn void GCF::Log::warning(const QString &context, const QString &message, const QString &details=QString())
- *
- * Logs a warning message into the current branch
+ * Logs a message of \c level into the current branch. This function is
+ * used by the \c GCF_LOG() family of macros, which pass a context computed
+ * at compile time.
  *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param level one of the \ref GCF::LogMessage::LogLevel values
+ * \param context context of the message, usually \c GCF_LOG_CONTEXT
  * \param message a brief one liner associated with this message
  * \param details a detailed multi-line text associated with this message
  */
+void GCF::Log::log(int level, const GCF::LogContext &context,
+                   const QString &message, const QString &details)
+{
+    if(!GCF::Log::isEnabled(level))
+        return;
+
+    switch(level)
+    {
+    case GCF::LogMessage::Fatal:
+        this->fatal(context.toString(), QByteArray(), message, details);
+        break;
+    case GCF::LogMessage::Error:
+        this->error(context.toString(), QByteArray(), message, details);
+        break;
+    case GCF::LogMessage::Warning:
+        this->warning(context.toString(), QByteArray(), message, details);
+        break;
+    case GCF::LogMessage::Debug:
+        this->debug(context.toString(), QByteArray(), message, details);
+        break;
+    default:
+        this->info(context.toString(), QByteArray(), message, details);
+        break;
+    }
+}
 
 /**
- * \fn void GCF::Log::error(const QString &context, const QString &message, const QString &details=QString())
+ * Sets the maximum number of messages that can be held in the log tree. When
+ * the number of messages exceeds this limit, the oldest messages are deleted;
+ * except for branches that are still open. Messages deleted this way are not
+ * handed over to the \ref handler().
  *
- * Logs a error message into the current branch
+ * \param count maximum number of messages. Zero (default) means no limit.
  *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * \note Log messages are typically held in the tree only while they are in an
+ * open branch; or if the \ref handler() does not delete the messages it handles.
  */
+void GCF::Log::setMaximumMessageCount(int count)
+{
+    QMutexLocker locker(&d->messageMutex);
+    d->maxMessageCount = qMax(count, 0);
+    this->enforceRetention(nullptr);
+    locker.unlock();
+
+    this->removeRetiredMessages();
+}
 
 /**
- * \fn void GCF::Log::fatal(const QString &context, const QString &message, const QString &details=QString())
- *
- * Logs a fatal message into the current branch
- *
- * \param context a string representing the context of the message. Use of
- * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
- * \param message a brief one liner associated with this message
- * \param details a detailed multi-line text associated with this message
+ * \return maximum number of messages that can be held in the log tree
+ * \sa setMaximumMessageCount()
  */
+int GCF::Log::maximumMessageCount() const
+{
+    return d->maxMessageCount;
+}
 
 /**
- * \internal
+ * Sets the maximum (approximate) memory in bytes that messages in the log tree
+ * can occupy. When the limit is exceeded, the oldest messages are deleted.
+ *
+ * \param bytes maximum memory. Zero (default) means no limit.
+ * \sa setMaximumMessageCount()
  */
-void GCF::Log::clear()
+void GCF::Log::setMaximumMessageBytes(int bytes)
 {
     QMutexLocker locker(&d->messageMutex);
-    d->rootMessage->clear();
-    d->stack.clear();
+    d->maxMessageBytes = qMax(bytes, 0);
+    this->enforceRetention(nullptr);
+    locker.unlock();
+
+    this->removeRetiredMessages();
 }
 
 /**
- * \return list of top-level log messages and branches.
+ * \return maximum memory in bytes that messages in the log tree can occupy
+ * \sa setMaximumMessageBytes()
  */
-QList<GCF::LogMessage*> GCF::Log::logMessages() const
+int GCF::Log::maximumMessageBytes() const
 {
-    return d->rootMessage->children();
+    return d->maxMessageBytes;
 }
 
 /**
- * \return a string representation of the log
+ * Sets the maximum age of messages in the log tree. Messages older than \c msecs
+ * are deleted the next time a message is logged.
+ *
+ * \param msecs maximum age in milliseconds. Zero (default) means no limit.
+ * \sa setMaximumMessageCount()
+ */
+void GCF::Log::setMaximumMessageAge(int msecs)
+{
+    QMutexLocker locker(&d->messageMutex);
+    d->maxMessageAge = qMax(msecs, 0);
+    this->enforceRetention(nullptr);
+    locker.unlock();
+
+    this->removeRetiredMessages();
+}
+
+/**
+ * \return maximum age in milliseconds of messages in the log tree
+ * \sa setMaximumMessageAge()
+ */
+int GCF::Log::maximumMessageAge() const
+{
+    return d->maxMessageAge;
+}
+
+/**
+ * Sets the level of messages that are retained in a branch once it is closed.
+ * For example, if \c level is \ref GCF::LogMessage::Warning, then info and debug
+ * messages are dropped from a branch when the \ref GCF::LogMessageBranch goes out
+ * of scope. Sub-branches that end up with no messages are dropped too.
+ *
+ * \param level one of the \ref GCF::LogMessage::LogLevel values. By default it is
+ * \ref GCF::LogMessage::User, which retains all messages.
+ */
+void GCF::Log::setBranchRetentionLevel(int level)
+{
+    d->branchRetentionLevel = level;
+}
+
+/**
+ * \return level of messages that are retained in a branch once it is closed
+ * \sa setBranchRetentionLevel()
+ */
+int GCF::Log::branchRetentionLevel() const
+{
+    return d->branchRetentionLevel;
+}
+
+/**
+ * \return number of messages currently held in the log tree
+ */
+int GCF::Log::messageCount() const
+{
+    return d->messageCount.loadAcquire();
+}
+
+/**
+ * \return approximate memory in bytes occupied by messages in the log tree
+ */
+int GCF::Log::messageBytes() const
+{
+    return d->messageBytes.loadAcquire();
+}
+
+/**
+ * Limits the number of messages of \c level that can be logged per second from
+ * any one context starting with \c contextPrefix. Messages beyond the limit are
+ * dropped, except that every \c sampleInterval'th of them is logged when
+ * \c sampleInterval is non-zero. When the next message arrives from the context
+ * after the one-second window, a summary message of the form
+ * "Suppressed K messages" is logged before it.
+ *
+ * \code
+ * // At most 10 warnings per second from each context of the IPC module, and
+ * // one in every 100 after that
+ * GCF::Log::instance()->setRateLimit(GCF::LogMessage::Warning, 10, "Ipc", 100);
+ * \endcode
+ *
+ * Limits are applied per context string. Since \c GCF_DEFAULT_LOG_CONTEXT
+ * includes the line number, every log statement is limited separately. If
+ * more than one limit applies to a context, then the one with the longest
+ * prefix is used.
+ *
+ * \param level one of the \ref GCF::LogMessage::LogLevel values
+ * \param maxPerSecond maximum number of messages logged per second from a context
+ * \param contextPrefix prefix of contexts to which the limit applies. An empty
+ * prefix applies the limit to all contexts.
+ * \param sampleInterval if non-zero, one in every \c sampleInterval messages
+ * beyond the limit is logged anyway.
+ *
+ * Passing zero for both \c maxPerSecond and \c sampleInterval removes the limit.
+ * By default no limits are set.
+ */
+void GCF::Log::setRateLimit(int level, int maxPerSecond, const QString &contextPrefix, int sampleInterval)
+{
+    maxPerSecond = qMax(maxPerSecond, 0);
+    sampleInterval = qMax(sampleInterval, 0);
+
+    QMutexLocker locker(&d->rateMutex);
+    for(int i=d->rateLimits.count()-1; i>=0; i--)
+    {
+        const LogRateLimit &limit = d->rateLimits.at(i);
+        if(limit.level == level && limit.contextPrefix == contextPrefix)
+            d->rateLimits.removeAt(i);
+    }
+
+    if(maxPerSecond || sampleInterval)
+    {
+        LogRateLimit limit;
+        limit.level = level;
+        limit.contextPrefix = contextPrefix;
+        limit.maxPerSecond = maxPerSecond;
+        limit.sampleInterval = sampleInterval;
+        d->rateLimits.append(limit);
+    }
+
+    // Limits are looked up again for every context
+    QHash< QPair<int,QString>, LogRateState >::iterator it = d->rateStates.begin();
+    for(; it != d->rateStates.end(); ++it)
+        it.value().resolved = false;
+    d->rateGeneration.ref();
+
+    // States with suppressed messages are kept until their summary is logged
+    if(d->rateLimits.isEmpty())
+    {
+        it = d->rateStates.begin();
+        while(it != d->rateStates.end())
+        {
+            if(it.value().suppressed == 0)
+                it = d->rateStates.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    d->updateRateTables();
+}
+
+/**
+ * \return maximum number of messages of \c level logged per second from each
+ * context starting with \c contextPrefix. Zero if no limit is set.
+ * \sa setRateLimit()
+ */
+int GCF::Log::rateLimit(int level, const QString &contextPrefix) const
+{
+    QMutexLocker locker(&d->rateMutex);
+    Q_FOREACH(const LogRateLimit &limit, d->rateLimits)
+    {
+        if(limit.level == level && limit.contextPrefix == contextPrefix)
+            return limit.maxPerSecond;
+    }
+
+    return 0;
+}
+
+/**
+ * \return sample interval of messages beyond the rate limit of \c level and
+ * \c contextPrefix. Zero if no limit is set.
+ * \sa setRateLimit()
+ */
+int GCF::Log::sampleInterval(int level, const QString &contextPrefix) const
+{
+    QMutexLocker locker(&d->rateMutex);
+    Q_FOREACH(const LogRateLimit &limit, d->rateLimits)
+    {
+        if(limit.level == level && limit.contextPrefix == contextPrefix)
+            return limit.sampleInterval;
+    }
+
+    return 0;
+}
+
+/**
+ * Removes all rate limits. Summaries of messages suppressed so far are
+ * logged right away.
+ * \sa setRateLimit()
+ */
+void GCF::Log::clearRateLimits()
+{
+    this->logSuppressedMessages();
+
+    QMutexLocker locker(&d->rateMutex);
+    d->rateLimits.clear();
+    d->rateStates.clear();
+    d->rateGeneration.ref();
+    d->updateRateTables();
+}
+
+/**
+ * \return total number of messages suppressed by rate limits
+ * \sa setRateLimit(), resetSuppressedMessageCounts()
+ */
+int GCF::Log::suppressedMessageCount() const
+{
+    return d->suppressedCount.loadAcquire();
+}
+
+/**
+ * \return number of messages from \c context suppressed by rate limits. Counts
+ * are kept for at most 4096 contexts; messages suppressed from further contexts
+ * are counted only in \ref suppressedMessageCount().
+ * \sa setRateLimit(), resetSuppressedMessageCounts()
+ */
+int GCF::Log::suppressedMessageCount(const QString &context) const
+{
+    QMutexLocker locker(&d->rateMutex);
+    return d->suppressedCounts.value(context, 0);
+}
+
+/**
+ * Resets counters returned by \ref suppressedMessageCount() to zero
+ */
+void GCF::Log::resetSuppressedMessageCounts()
+{
+    QMutexLocker locker(&d->rateMutex);
+    d->suppressedCounts.clear();
+    d->suppressedCount.storeRelease(0);
+}
+
+/**
+ * \return true if \c QtDebug messages are logged. False otherwise.
+ * \sa setLogQtMessages()
+ */
+bool GCF::Log::isLogQtMessages() const
+{
+    return d->logQtMessages;
+}
+
+/**
+ * Logs a fatal message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param errorCode a code associated with this message
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+void GCF::Log::fatal(const QString &context, const QByteArray &errorCode,
+                     const QString &message, const QString &details)
+{
+    if(!GCF::Log::isEnabled(GCF::LogMessage::Fatal))
+        return;
+
+    this->addMessage(GCF::LogMessage::Fatal, context, errorCode, message, details);
+}
+
+/**
+ * Logs a error message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param errorCode a code associated with this message
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+void GCF::Log::error(const QString &context, const QByteArray &errorCode,
+                     const QString &message, const QString &details)
+{
+    if(!GCF::Log::isEnabled(GCF::LogMessage::Error))
+        return;
+
+    this->addMessage(GCF::LogMessage::Error, context, errorCode, message, details);
+}
+
+/**
+ * Logs a warning message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param errorCode a code associated with this message
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+void GCF::Log::warning(const QString &context, const QByteArray &errorCode,
+                       const QString &message, const QString &details)
+{
+    if(!GCF::Log::isEnabled(GCF::LogMessage::Warning))
+        return;
+
+    this->addMessage(GCF::LogMessage::Warning, context, errorCode, message, details);
+}
+
+/**
+ * Logs a warning message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param errorCode a code associated with this message
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+void GCF::Log::debug(const QString &context, const QByteArray &errorCode,
+                     const QString &message, const QString &details)
+{
+    if(!GCF::Log::isEnabled(GCF::LogMessage::Debug))
+        return;
+
+    this->addMessage(GCF::LogMessage::Debug, context, errorCode, message, details);
+}
+
+/**
+ * Logs a information message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param errorCode a code associated with this message
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+void GCF::Log::info(const QString &context, const QByteArray &errorCode,
+                    const QString &message, const QString &details)
+{
+    if(!GCF::Log::isEnabled(GCF::LogMessage::Info))
+        return;
+
+    this->addMessage(GCF::LogMessage::Info, context, errorCode, message, details);
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::addMessage(int level, const QString &context, const QByteArray &errorCode,
+                          const QString &message, const QString &details,
+                          const QMessageLogContext *source)
+{
+    if(d->rateLimitCount.loadAcquire() && !this->admitMessage(level, context))
+        return;
+
+    this->insertMessage(level, context, errorCode, message, details, source);
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::insertMessage(int level, const QString &context, const QByteArray &errorCode,
+                             const QString &message, const QString &details,
+                             const QMessageLogContext *source)
+{
+    QStack<GCF::LogMessage*> &stack = d->stack();
+    if(stack.isEmpty())
+    {
+        QMutexLocker locker(&d->messageMutex);
+        GCF::LogMessage *msg = new GCF::LogMessage(level, context, errorCode, message, details,
+                                                   d->rootMessage);
+        if(source)
+            msg->d->setSource(*source);
+        this->enforceRetention(msg);
+        this->dumpLogMessage(msg);
+        locker.unlock();
+
+        if(d->hasRetentionLimits())
+            this->removeRetiredMessages();
+        return;
+    }
+
+    // Branches of this thread are not visible to any other thread, until
+    // the top-level branch is closed. So no locking is needed here.
+    GCF::LogMessage *msg = new GCF::LogMessage(level, context, errorCode, message, details,
+                                               stack.top());
+    if(source)
+        msg->d->setSource(*source);
+    if(d->hasRetentionLimits())
+    {
+        {
+            QMutexLocker locker(&d->messageMutex);
+            this->enforceRetention(msg);
+        }
+        this->removeRetiredMessages();
+    }
+    this->dumpLogMessage(msg);
+}
+
+/**
+ * \internal
+ *
+ * \return true if a message of \c level from \c context is within the rate
+ * limits. Logs the summary of messages suppressed in the previous window, if any.
+ */
+bool GCF::Log::admitMessage(int level, const QString &context)
+{
+    // Messages of levels without limits and pending summaries, and messages
+    // from contexts that this thread already found to be unlimited, are
+    // admitted without taking rateMutex.
+    if(!(d->rateLevels.loadAcquire() & LogData::rateLevelBit(level)))
+        return true;
+
+    const QPair<int,QString> key(level, context);
+    LogThreadData *threadData = d->localData();
+    if(threadData->rateGeneration == d->rateGeneration.loadAcquire() &&
+       threadData->unlimitedRateKeys.contains(key))
+        return true;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int summarize = 0;
+    bool admit = true;
+
+    {
+        QMutexLocker locker(&d->rateMutex);
+
+        QHash< QPair<int,QString>, LogRateState >::iterator it = d->rateStates.find(key);
+        if(it == d->rateStates.end())
+        {
+            if(d->rateLimits.isEmpty())
+                return true;
+
+            // Drop states that have nothing left to summarize
+            if(d->rateStates.count() >= LogData::MaxRateStates)
+            {
+                it = d->rateStates.begin();
+                while(it != d->rateStates.end())
+                {
+                    if(it.value().suppressed == 0)
+                        it = d->rateStates.erase(it);
+                    else
+                        ++it;
+                }
+            }
+
+            it = d->rateStates.insert(key, LogRateState());
+            d->rateLevels.storeRelease(d->rateLevels.loadAcquire() | LogData::rateLevelBit(level));
+            d->rateLimitCount.storeRelease(d->rateLimits.count() + d->rateStates.count());
+        }
+
+        if(d->rateLimits.isEmpty())
+        {
+            // All limits were removed; summarize and forget the state
+            summarize = it.value().suppressed;
+            d->rateStates.erase(it);
+            d->updateRateTables();
+        }
+        else
+        {
+            LogRateState &state = it.value();
+            if(!state.resolved)
+            {
+                const LogRateLimit *limit = d->findRateLimit(level, context);
+                state.resolved = true;
+                state.limited = (limit != nullptr);
+                state.maxPerSecond = limit ? limit->maxPerSecond : 0;
+                state.sampleInterval = limit ? limit->sampleInterval : 0;
+            }
+
+            admit = state.admit(now, summarize);
+            if(!admit)
+            {
+                QHash<QString,int>::iterator sit = d->suppressedCounts.find(context);
+                if(sit != d->suppressedCounts.end())
+                    ++sit.value();
+                else if(d->suppressedCounts.count() < LogData::MaxRateStates)
+                    d->suppressedCounts.insert(context, 1);
+                d->suppressedCount.ref();
+            }
+            else if(!state.limited && !state.suppressed)
+            {
+                // Nothing to track for this context. The state is dropped and
+                // later messages take the lock-free path in this thread.
+                d->rateStates.erase(it);
+                d->rateLimitCount.storeRelease(d->rateLimits.count() + d->rateStates.count());
+
+                const int generation = d->rateGeneration.loadAcquire();
+                if(threadData->rateGeneration != generation ||
+                   threadData->unlimitedRateKeys.count() >= LogData::MaxRateStates)
+                {
+                    threadData->unlimitedRateKeys.clear();
+                    threadData->rateGeneration = generation;
+                }
+                threadData->unlimitedRateKeys.insert(key);
+            }
+        }
+    }
+
+    if(summarize)
+        this->insertMessage(level, context, QByteArray(),
+                            QString("Suppressed %1 messages").arg(summarize), QString());
+
+    return admit;
+}
+
+/**
+ * \internal
+ *
+ * Logs summaries of all messages suppressed by rate limits so far.
+ */
+void GCF::Log::logSuppressedMessages()
+{
+    QList< QPair< QPair<int,QString>, int > > summaries;
+
+    {
+        QMutexLocker locker(&d->rateMutex);
+        QHash< QPair<int,QString>, LogRateState >::iterator it = d->rateStates.begin();
+        for(; it != d->rateStates.end(); ++it)
+        {
+            if(it.value().suppressed)
+            {
+                summaries.append(qMakePair(it.key(), it.value().suppressed));
+                it.value().suppressed = 0;
+            }
+        }
+    }
+
+    for(int i=0; i<summaries.count(); i++)
+    {
+        const QPair<int,QString> &key = summaries.at(i).first;
+        this->insertMessage(key.first, key.second, QByteArray(),
+                            QString("Suppressed %1 messages").arg(summaries.at(i).second),
+                            QString());
+    }
+}
+
+/**
+ * \fn void GCF::Log::info(const QString &context, const QString &message, const QString &details=QString())
+ *
+ * Logs a information message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+
+/**
+ * \fn void GCF::Log::debug(const QString &context, const QString &message, const QString &details=QString())
+ *
+ * Logs a debug message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+
+/**
+ * \fn void GCF::Log::warning(const QString &context, const QString &message, const QString &details=QString())
+ *
+ * Logs a warning message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+
+/**
+ * \fn void GCF::Log::error(const QString &context, const QString &message, const QString &details=QString())
+ *
+ * Logs a error message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+
+/**
+ * \fn void GCF::Log::fatal(const QString &context, const QString &message, const QString &details=QString())
+ *
+ * Logs a fatal message into the current branch
+ *
+ * \param context a string representing the context of the message. Use of
+ * \c GCF_DEFAULT_LOG_CONTEXT for this parameter is recommended
+ * \param message a brief one liner associated with this message
+ * \param details a detailed multi-line text associated with this message
+ */
+
+/**
+ * \internal
+ */
+void GCF::Log::clear()
+{
+    // Views call back into the model during a reset, so messageMutex is
+    // held only while the messages are deleted.
+#if QT_VERSION >= 0x050000
+    this->beginResetModel();
+#endif
+    {
+        QMutexLocker locker(&d->messageMutex);
+        d->resettingModel = true;
+        d->rootMessage->clear();
+        d->resettingModel = false;
+    }
+#if QT_VERSION >= 0x050000
+    this->endResetModel();
+#else
+    this->reset();
+#endif
+}
+
+/**
+ * \return list of top-level log messages and branches.
+ */
+QList<GCF::LogMessage*> GCF::Log::logMessages() const
+{
+    return d->rootMessage->children();
+}
+
+/**
+ * \return a string representation of the log
  */
 QString GCF::Log::toString() const
 {
@@ -661,10 +1753,10 @@ int GCF::Log::rowCount(const QModelIndex &parent) const
     if(parent.isValid())
     {
         GCF::LogMessage *msg = static_cast<GCF::LogMessage*>(parent.internalPointer());
-        return msg->children().count();
+        return qMin(msg->d->modelChildCount, msg->d->children.count());
     }
 
-    return d->rootMessage->children().count();
+    return qMin(d->rootMessage->d->modelChildCount, d->rootMessage->d->children.count());
 }
 
 /**
@@ -729,130 +1821,569 @@ QModelIndex GCF::Log::index(int row, int column, const QModelIndex &parent) cons
     else
         parentMsg = d->rootMessage;
 
-    if(row < 0 || row >= parentMsg->children().count())
+    if(row < 0 || row >= qMin(parentMsg->d->modelChildCount, parentMsg->d->children.count()))
         return QModelIndex();
 
-    return this->createIndex(row, column, parentMsg->children().at(row));
+    return this->createIndex(row, column, parentMsg->children().at(row));
+}
+
+/**
+ * \internal
+ */
+QVariant GCF::Log::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(orientation == Qt::Horizontal && role == Qt::DisplayRole)
+    {
+        switch(section)
+        {
+        case 0: return tr("Error Level");
+        case 1: return tr("Context");
+        case 2: return tr("Code");
+        case 3: return tr("Message");
+        case 4: return tr("Details");
+        default: break;
+        }
+    }
+
+    return QVariant();
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::dumpLogMessage(GCF::LogMessage *message)
+{
+    QMutexLocker locker(&d->handlerMutex);
+    if(!message)
+        return;
+
+    LogMessageHandlerInterface *handler = d->handler;
+    if(handler)
+    {
+        if(!d->versionLogged)
+        {
+            QString ctx = QString("GCF Logger");
+            QString msg = QString("Logging using GCF-%1").arg(GCF::version());
+            GCF::LogMessage *versionMsg
+                    = new GCF::LogMessage(GCF::LogMessage::Info, ctx,
+                                          QByteArray(), msg, QString(),
+                                          d->rootMessage);
+            handler->handleLogMessage(versionMsg);
+            d->versionLogged = true;
+        }
+
+        // In the asynchronous mode, top-level messages for the default handler
+        // are formatted and posted without holding up other threads that log.
+        if(handler == this && d->writer && message->parent() == d->rootMessage)
+        {
+            const QString fileName = this->logFileName();
+            locker.unlock();
+            if(this->postLogMessage(message, fileName))
+                return;
+
+            locker.relock();
+            handler = d->handler;
+            if(!handler)
+                return;
+        }
+
+        handler->handleLogMessage(message);
+    }
+}
+
+/**
+ * \internal
+ */
+GCF::LogMessage *GCF::Log::pushBranch(const QString &context)
+{
+    QStack<GCF::LogMessage*> &stack = d->stack();
+    GCF::LogMessage *parent = stack.isEmpty() ? nullptr : stack.top();
+    GCF::LogMessage *msg = new GCF::LogMessage(GCF::LogMessage::Info, context,
+                                               QByteArray(), QString(), QString(),
+                                               parent);
+    if(!parent)
+    {
+        // Handlers expect top-level branches to have the root as parent
+        msg->d->parent = d->rootMessage;
+        msg->d->detached = true;
+    }
+    stack.push(msg);
+    if(d->hasRetentionLimits())
+    {
+        {
+            QMutexLocker locker(&d->messageMutex);
+            this->enforceRetention(msg);
+        }
+        this->removeRetiredMessages();
+    }
+    return msg;
+}
+
+/**
+ * \internal
+ */
+GCF::LogMessage *GCF::Log::popBranch()
+{
+    QStack<GCF::LogMessage*> &stack = d->stack();
+    if(stack.isEmpty())
+        return nullptr;
+
+    return stack.pop();
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::mergeBranch(GCF::LogMessage *branch)
+{
+    QMutexLocker locker(&d->messageMutex);
+    branch->d->detached = false;
+    d->rootMessage->d->children.append(branch);
+
+    {
+        QMutexLocker modelLocker(&d->modelMutex);
+        d->insertedParents.insert(d->rootMessage);
+    }
+    this->scheduleModelUpdate();
+
+    this->enforceRetention(branch);
+    this->dumpLogMessage(branch);
+    locker.unlock();
+
+    if(d->hasRetentionLimits())
+        this->removeRetiredMessages();
+}
+
+bool GCF::Log::isInTree(GCF::LogMessage *msg) const
+{
+    while(msg && msg != d->rootMessage)
+    {
+        if(msg->d->detached)
+            return false;
+        msg = msg->d->parent;
+    }
+    return msg != nullptr;
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::messageUpdated(GCF::LogMessage *msg)
+{
+    const int bytes = msg->d->estimateBytes();
+    d->messageBytes.fetchAndAddOrdered(bytes - msg->d->bytes);
+    msg->d->bytes = bytes;
+
+    if(!this->isInTree(msg))
+        return;
+
+    {
+        QMutexLocker locker(&d->modelMutex);
+        d->updatedMessages.insert(msg);
+    }
+
+    this->scheduleModelUpdate();
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::messageCreated(GCF::LogMessage *msg)
+{
+    msg->d->bytes = msg->d->estimateBytes();
+    d->messageCount.fetchAndAddOrdered(1);
+    d->messageBytes.fetchAndAddOrdered(msg->d->bytes);
+
+    // Messages in branches that are still open in some thread are announced
+    // when the branch gets merged into the tree.
+    if(!msg->parent() || !this->isInTree(msg))
+        return;
+
+    {
+        QMutexLocker locker(&d->modelMutex);
+        d->insertedParents.insert(msg->parent());
+    }
+
+    this->scheduleModelUpdate();
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::messageDestroyed(GCF::LogMessage *msg)
+{
+    QStack<GCF::LogMessage*> &stack = d->stack();
+    int index = stack.indexOf(msg);
+    if(index >= 0)
+        stack.remove(index, 1);
+
+    if(msg->d->bytes)
+    {
+        d->messageCount.fetchAndAddOrdered(-1);
+        d->messageBytes.fetchAndAddOrdered(-msg->d->bytes);
+        msg->d->bytes = 0;
+    }
+
+    if(msg->d->retired)
+        d->retiredMessages.removeAll(msg);
+
+    GCF::LogMessage *parentMsg = msg->d->parent;
+    if(!this->isInTree(msg))
+    {
+        // Not known to the model; simply take it out of its branch
+        if(parentMsg && !msg->d->detached)
+            parentMsg->d->children.removeAll(msg);
+        msg->d->parent = nullptr;
+        return;
+    }
+
+    {
+        // Children are no longer in the tree by the time they are destroyed
+        QMutexLocker locker(&d->modelMutex);
+        this->forgetModelUpdates(msg);
+    }
+
+    if(!parentMsg)
+        return;
+
+    int row = parentMsg->d->children.indexOf(msg);
+    if(row < 0)
+        return;
+
+    // Messages that the model has not announced yet can go away silently
+    if(d->resettingModel || row >= parentMsg->d->modelChildCount || !this->isKnownToModel(parentMsg))
+    {
+        parentMsg->d->children.removeAt(row);
+        if(row < parentMsg->d->modelChildCount)
+            --parentMsg->d->modelChildCount;
+        msg->d->parent = nullptr;
+        return;
+    }
+
+    this->beginRemoveRows(this->modelIndex(parentMsg), row, row);
+    parentMsg->d->children.removeAt(row);
+    --parentMsg->d->modelChildCount;
+    msg->d->parent = nullptr;
+    this->endRemoveRows();
+}
+
+/**
+ * \internal
+ */
+void GCF::Log::timerEvent(QTimerEvent *te)
+{
+    if(te->timerId() != d->modelUpdateTimer.timerId())
+    {
+        QAbstractItemModel::timerEvent(te);
+        return;
+    }
+
+    d->modelUpdateTimer.stop();
+    d->modelUpdateScheduled.storeRelease(0);
+
+    // Messages retired by other threads are removed here, so that their
+    // rows are removed in this thread.
+    this->removeRetiredMessages();
+
+    // Messages retired from here on (by views that log while handling the
+    // signals below, for instance) are removed by the next timerEvent().
+    d->changingRows = true;
+
+    QList<GCF::LogMessage*> parents;
+    QList<QModelIndex> updates;
+    {
+        QMutexLocker locker(&d->messageMutex);
+
+        // Indexes of updated messages are computed while the messages are
+        // sure to be alive. Rows are only ever appended, so they remain
+        // valid while new rows are announced below.
+        QMutexLocker modelLocker(&d->modelMutex);
+        Q_FOREACH(GCF::LogMessage *msg, d->updatedMessages)
+        {
+            if(this->isKnownToModel(msg))
+                updates.append(this->modelIndex(msg));
+        }
+        d->updatedMessages.clear();
+
+        parents = d->insertedParents.values();
+        d->announcingParents = d->insertedParents;
+        d->insertedParents.clear();
+
+        // Announce rows in parents closer to the root first. A branch that
+        // becomes visible brings its whole subtree with it.
+        std::sort(parents.begin(), parents.end(), GCF::Log::depthLessThan);
+    }
+
+    Q_FOREACH(GCF::LogMessage *parentMsg, parents)
+    {
+        d->messageMutex.lock();
+
+        // Parents that were destroyed in the meantime are no longer here
+        bool alive = false;
+        {
+            QMutexLocker modelLocker(&d->modelMutex);
+            alive = d->announcingParents.remove(parentMsg);
+        }
+
+        if(!alive || !this->isKnownToModel(parentMsg))
+        {
+            d->messageMutex.unlock();
+            continue;
+        }
+
+        const int first = parentMsg->d->modelChildCount;
+        const int last = parentMsg->d->children.count()-1;
+        if(last < first)
+        {
+            d->messageMutex.unlock();
+            continue;
+        }
+
+        // While the lock is released, retention retires messages instead of
+        // deleting them. That keeps the parent and rows [first, last] in
+        // place until they have been announced.
+        QModelIndex parentIndex = this->modelIndex(parentMsg);
+        d->announcingRows = true;
+        d->messageMutex.unlock();
+
+        this->beginInsertRows(parentIndex, first, last);
+        d->messageMutex.lock();
+        parentMsg->d->modelChildCount = last+1;
+        for(int i=first; i<=last; i++)
+            this->announceSubtree(parentMsg->d->children.at(i));
+        d->announcingRows = false;
+        d->messageMutex.unlock();
+        this->endInsertRows();
+    }
+
+    Q_FOREACH(const QModelIndex &index, updates)
+        emit dataChanged(index, index.sibling(index.row(), 4));
+
+    d->changingRows = false;
+}
+
+void GCF::Log::enforceRetention(GCF::LogMessage *keep)
+{
+    if(!d->maxMessageCount && !d->maxMessageBytes && !d->maxMessageAge)
+        return;
+
+    const qint64 now = d->maxMessageAge ? QDateTime::currentMSecsSinceEpoch() : 0;
+    while(1)
+    {
+        const bool overCount = d->maxMessageCount && d->messageCount.loadAcquire() > d->maxMessageCount;
+        const bool overBytes = d->maxMessageBytes && d->messageBytes.loadAcquire() > d->maxMessageBytes;
+        if(!overCount && !overBytes && !d->maxMessageAge)
+            return;
+
+        GCF::LogMessage *oldest = this->findPrunableMessage(d->rootMessage, keep);
+        if(!oldest && !d->stack().isEmpty())
+            oldest = this->findPrunableMessage(d->stack().first(), keep);
+        if(!oldest)
+            return;
+
+        const bool tooOld = d->maxMessageAge && now - oldest->d->timestamp > qint64(d->maxMessageAge);
+        if(!overCount && !overBytes && !tooOld)
+            return;
+
+        // Rows are removed only in the model's thread, and only after
+        // messageMutex is released. Messages that are not known to the model
+        // are deleted right away; unless rows are being announced, in which
+        // case deleting them could shift the rows.
+        if(this->isInTree(oldest) && (d->announcingRows || this->isKnownToModel(oldest)))
+            this->retireMessage(oldest);
+        else
+            delete oldest;
+    }
+}
+
+void GCF::Log::retireMessage(GCF::LogMessage *msg)
+{
+    // The message no longer counts towards retention limits, and is no
+    // longer a candidate for pruning. It is deleted from timerEvent().
+    this->uncountMessage(msg);
+    msg->d->retired = true;
+    d->retiredMessages.append(msg);
+    this->scheduleModelUpdate();
+}
+
+/*
+ * Deletes retired messages. Rows of messages known to the model are removed
+ * with messageMutex released while the model signals are emitted, because
+ * views, proxies and persistent indexes call rowCount(), parent() and index()
+ * while handling them. Does nothing outside the model's thread, and while
+ * the model is already announcing changes.
+ */
+void GCF::Log::removeRetiredMessages()
+{
+    if(QThread::currentThread() != this->thread() || d->changingRows)
+        return;
+
+    d->changingRows = true;
+    d->messageMutex.lock();
+    while(!d->retiredMessages.isEmpty())
+    {
+        // Deleting a message takes it (and any retired message below it)
+        // out of retiredMessages.
+        GCF::LogMessage *msg = d->retiredMessages.first();
+        if(!this->isKnownToModel(msg))
+        {
+            delete msg;
+            continue;
+        }
+
+        // Other threads retire, rather than delete, messages known to the
+        // model. So the row stays in place while the lock is released.
+        GCF::LogMessage *parentMsg = msg->d->parent;
+        const int row = parentMsg->d->children.indexOf(msg);
+        const QModelIndex parentIndex = this->modelIndex(parentMsg);
+        d->messageMutex.unlock();
+
+        this->beginRemoveRows(parentIndex, row, row);
+        d->messageMutex.lock();
+        {
+            QMutexLocker modelLocker(&d->modelMutex);
+            this->forgetModelUpdates(msg);
+        }
+        parentMsg->d->children.removeAt(row);
+        --parentMsg->d->modelChildCount;
+        msg->d->parent = nullptr;
+        delete msg;
+        d->messageMutex.unlock();
+        this->endRemoveRows();
+
+        d->messageMutex.lock();
+    }
+    d->messageMutex.unlock();
+    d->changingRows = false;
+}
+
+/*
+ * Forgets pending model updates of msg and the messages below it. Must be
+ * called with modelMutex held.
+ */
+void GCF::Log::forgetModelUpdates(GCF::LogMessage *msg)
+{
+    d->insertedParents.remove(msg);
+    d->announcingParents.remove(msg);
+    d->updatedMessages.remove(msg);
+
+    for(int i=0; i<msg->d->children.count(); i++)
+        this->forgetModelUpdates(msg->d->children.at(i));
+}
+
+void GCF::Log::uncountMessage(GCF::LogMessage *msg)
+{
+    if(msg->d->bytes)
+    {
+        d->messageCount.fetchAndAddOrdered(-1);
+        d->messageBytes.fetchAndAddOrdered(-msg->d->bytes);
+        msg->d->bytes = 0;
+    }
+
+    for(int i=0; i<msg->d->children.count(); i++)
+        this->uncountMessage(msg->d->children.at(i));
 }
 
-/**
- * \internal
- */
-QVariant GCF::Log::headerData(int section, Qt::Orientation orientation, int role) const
+GCF::LogMessage *GCF::Log::findPrunableMessage(GCF::LogMessage *parent, GCF::LogMessage *keep) const
 {
-    if(orientation == Qt::Horizontal && role == Qt::DisplayRole)
+    // Children are in chronological order. Open branches cannot be deleted,
+    // but their older children can be.
+    for(int i=0; i<parent->d->children.count(); i++)
     {
-        switch(section)
+        GCF::LogMessage *child = parent->d->children.at(i);
+        if(child == keep || child->d->retired)
+            continue;
+
+        if(d->stack().contains(child))
         {
-        case 0: return tr("Error Level");
-        case 1: return tr("Context");
-        case 2: return tr("Code");
-        case 3: return tr("Message");
-        case 4: return tr("Details");
-        default: break;
+            GCF::LogMessage *msg = this->findPrunableMessage(child, keep);
+            if(msg)
+                return msg;
+            continue;
         }
+
+        return child;
     }
 
-    return QVariant();
+    return nullptr;
 }
 
-/**
- * \internal
- */
-void GCF::Log::dumpLogMessage(GCF::LogMessage *message)
+void GCF::Log::applyBranchRetention(GCF::LogMessage *branch)
 {
-    QMutexLocker locker(&d->handlerMutex);
-    if(!message)
+    if(d->branchRetentionLevel >= GCF::LogMessage::User)
         return;
 
-    LogMessageHandlerInterface *handler = d->handler;
-    if(handler)
+    for(int i=branch->d->children.count()-1; i>=0; i--)
     {
-        if(!d->versionLogged)
-        {
-            QString ctx = QString("GCF Logger");
-            QString msg = QString("Logging using GCF-%1").arg(GCF::version());
-            GCF::LogMessage *versionMsg
-                    = new GCF::LogMessage(GCF::LogMessage::Info, ctx,
-                                          QByteArray(), msg, QString(),
-                                          d->rootMessage);
-            handler->handleLogMessage(versionMsg);
-            d->versionLogged = true;
-        }
+        GCF::LogMessage *child = branch->d->children.at(i);
+        if(d->stack().contains(child))
+            continue;
 
-        handler->handleLogMessage(message);
+        this->applyBranchRetention(child);
+        if(child->d->children.isEmpty() && child->d->logLevel > d->branchRetentionLevel)
+            delete child;
     }
 }
 
-/**
- * \internal
- */
-GCF::LogMessage *GCF::Log::pushBranch(const QString &context)
+bool GCF::Log::depthLessThan(GCF::LogMessage *a, GCF::LogMessage *b)
 {
-    QMutexLocker locker(&d->messageMutex);
-    GCF::LogMessage *msg = new GCF::LogMessage(GCF::LogMessage::Info, context,
-                                               QByteArray(), QString(), QString(),
-                                               d->currentBranch());
-    d->stack.push(msg);
-    return msg;
+    int depthA = 0, depthB = 0;
+    for(GCF::LogMessage *m=a; m; m=m->d->parent) ++depthA;
+    for(GCF::LogMessage *m=b; m; m=m->d->parent) ++depthB;
+    return depthA < depthB;
 }
 
-/**
- * \internal
- */
-GCF::LogMessage *GCF::Log::popBranch()
+void GCF::Log::scheduleModelUpdate()
 {
-    QMutexLocker locker(&d->messageMutex);
-    if(d->stack.isEmpty())
-        return nullptr;
+    if(!d->modelUpdateScheduled.testAndSetOrdered(0, 1))
+        return;
 
-    return d->stack.pop();
+    if(QThread::currentThread() == this->thread())
+        this->startModelUpdateTimer();
+    else
+        QMetaObject::invokeMethod(this, "startModelUpdateTimer", Qt::QueuedConnection);
 }
 
-/**
- * \internal
- */
-void GCF::Log::messageUpdated(GCF::LogMessage*)
+void GCF::Log::startModelUpdateTimer()
 {
-    // FIXME: #pragma message("Upgrade GCF::Log::messageUpdated() to do a smart update of the model")
-#if QT_VERSION >= 0x050000
-    this->beginResetModel();
-    this->endResetModel();
-#else
-    this->reset();
-#endif
+    if(!d->modelUpdateTimer.isActive())
+        d->modelUpdateTimer.start(50, this);
 }
 
-/**
- * \internal
- */
-void GCF::Log::messageCreated(GCF::LogMessage*)
+bool GCF::Log::isKnownToModel(GCF::LogMessage *msg) const
 {
-    // FIXME: #pragma message("Upgrade GCF::Log::messageCreated() to do a smart update of the model")
-#if QT_VERSION >= 0x050000
-    this->beginResetModel();
-    this->endResetModel();
-#else
-    this->reset();
-#endif
+    // The root is always known. Other messages are known if they fall within
+    // the announced children of every ancestor.
+    while(msg && msg != d->rootMessage)
+    {
+        GCF::LogMessage *parentMsg = msg->d->parent;
+        if(!parentMsg)
+            return false;
+
+        int row = parentMsg->d->children.indexOf(msg);
+        if(row < 0 || row >= parentMsg->d->modelChildCount)
+            return false;
+
+        msg = parentMsg;
+    }
+
+    return msg == d->rootMessage;
 }
 
-/**
- * \internal
- */
-void GCF::Log::messageDestroyed(GCF::LogMessage *msg)
+QModelIndex GCF::Log::modelIndex(GCF::LogMessage *msg) const
 {
-    int index = d->stack.indexOf(msg);
-    if(index >= 0)
-        d->stack.remove(index, 1);
+    if(!msg || msg == d->rootMessage || !msg->d->parent)
+        return QModelIndex();
 
-    // FIXME: #pragma message("Upgrade GCF::Log::messageDestroyed() to do a smart update of the model")
-#if QT_VERSION >= 0x050000
-    this->beginResetModel();
-    this->endResetModel();
-#else
-    this->reset();
-#endif
+    int row = msg->d->parent->d->children.indexOf(msg);
+    return this->createIndex(row, 0, msg);
+}
+
+void GCF::Log::announceSubtree(GCF::LogMessage *msg)
+{
+    msg->d->modelChildCount = msg->d->children.count();
+    for(int i=0; i<msg->d->children.count(); i++)
+        this->announceSubtree(msg->d->children.at(i));
 }
 
 /**
@@ -864,6 +2395,9 @@ void GCF::Log::handleLogMessage(GCF::LogMessage *msg)
         return;
 
     QString fName = this->logFileName();
+    if(this->postLogMessage(msg, fName))
+        return;
+
     QFile file(fName);
     if( file.open(QFile::Append) == false )
     {
@@ -877,6 +2411,23 @@ void GCF::Log::handleLogMessage(GCF::LogMessage *msg)
     delete msg;
 }
 
+bool GCF::Log::postLogMessage(GCF::LogMessage *msg, const QString &fileName)
+{
+    QReadLocker locker(&d->writerLock);
+    if(!d->writer)
+        return false;
+
+    QString text;
+    {
+        QTextStream ts(&text, QIODevice::WriteOnly);
+        this->print(msg, ts);
+    }
+
+    d->writer->post(fileName, text);
+    delete msg;
+    return true;
+}
+
 /**
  * \internal
  */
@@ -892,7 +2443,11 @@ void GCF::Log::print(GCF::LogMessage *msg, QTextStream &ts)
 
     ts << QString(indent*2, QChar(' ')) << msg->context()
        << " : LogLevel(" << msg->logLevel() << ") "
-       << msg->message() << msg->details() << "\n";
+       << msg->message() << msg->details();
+    if(!msg->d->sourceFile.isEmpty())
+        ts << " (" << msg->d->sourceFile << ":" << msg->d->sourceLine
+           << " in " << msg->d->sourceFunction << ")";
+    ts << "\n";
 
     for(int i=0; i<msg->children().count(); i++)
         d->handler->print(msg->children().at(i), ts);
@@ -911,6 +2466,209 @@ QString GCF::Log::defaultLogContext(const QString &fnInfo, const QString &file,
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+\class GCF::LogContext Log.h <GCF3/Log>
+\brief Describes where a log message originated
+\ingroup gcf_core
+
+Instances of this class are created by the \c GCF_LOG_CONTEXT macro. The file-name
+part of \c __FILE__ is located at compile time, so creating a context only
+stores three values. The context string is built by \ref toString(), which is
+called only when a message is actually logged.
+*/
+
+/**
+ * \return the context as a string of the form \c File:Line-function; which is
+ * the same form returned by \ref GCF::Log::defaultLogContext().
+ */
+QString GCF::LogContext::toString() const
+{
+    const char *dot = m_file ? ::strchr(m_file, '.') : nullptr;
+    QString fileName = dot ? QString::fromLatin1(m_file, int(dot-m_file)) : QString::fromLatin1(m_file);
+    return fileName + QLatin1Char(':') + QString::number(m_line)
+            + QLatin1Char('-') + QString::fromLatin1(m_function);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+GCF::LogWriter::LogWriter() : m_tail(0)
+{
+    for(int i=0; i<Capacity; i++)
+        m_records[i].sequence.storeRelease(i);
+}
+
+GCF::LogWriter::~LogWriter()
+{
+    this->stop();
+}
+
+void GCF::LogWriter::post(const QString &fileName, const QString &text)
+{
+    // When the ring is full, the producer has no option but to wait for
+    // the writer to catch up. The wait is timed, in case a wakeup from the
+    // writer is missed.
+    while(!this->tryPost(fileName, text))
+    {
+        QMutexLocker locker(&m_waitMutex);
+        m_blocked.ref();
+        m_wakeup.wakeOne();
+        m_space.wait(&m_waitMutex, 10);
+        m_blocked.deref();
+    }
+
+    if(m_sleeping.loadAcquire())
+        this->wakeWriter();
+}
+
+void GCF::LogWriter::flush()
+{
+    if(!this->isRunning())
+        return;
+
+    const int target = m_head.loadAcquire();
+    m_closeFile.storeRelease(1);
+    this->wakeWriter();
+
+    QMutexLocker locker(&m_waitMutex);
+    while(int(uint(m_written.loadAcquire()) - uint(target)) < 0 || m_closeFile.loadAcquire())
+    {
+        m_wakeup.wakeOne();
+        m_idle.wait(&m_waitMutex, 10);
+    }
+}
+
+void GCF::LogWriter::stop()
+{
+    if(!this->isRunning())
+        return;
+
+    m_stop.storeRelease(1);
+    this->wakeWriter();
+    this->wait();
+}
+
+void GCF::LogWriter::run()
+{
+    while(1)
+    {
+        if(this->writeBatch())
+            continue;
+
+        if(m_stop.loadAcquire())
+            break;
+
+        QMutexLocker locker(&m_waitMutex);
+        m_sleeping.storeRelease(1);
+        if(this->isEmpty())
+        {
+            if(m_closeFile.loadAcquire())
+            {
+                m_stream.setDevice(nullptr);
+                m_file.close();
+                m_closeFile.storeRelease(0);
+            }
+
+            m_idle.wakeAll();
+            if(!m_stop.loadAcquire())
+                m_wakeup.wait(&m_waitMutex, 100);
+        }
+        m_sleeping.storeRelease(0);
+    }
+
+    m_stream.setDevice(nullptr);
+    m_file.close();
+    m_closeFile.storeRelease(0);
+
+    QMutexLocker locker(&m_waitMutex);
+    m_idle.wakeAll();
+}
+
+bool GCF::LogWriter::tryPost(const QString &fileName, const QString &text)
+{
+    int pos = m_head.loadAcquire();
+    Record *record = nullptr;
+    while(1)
+    {
+        record = &m_records[uint(pos) % uint(Capacity)];
+        const int diff = int(uint(record->sequence.loadAcquire()) - uint(pos));
+        if(diff == 0)
+        {
+            if(m_head.testAndSetOrdered(pos, int(uint(pos)+1)))
+                break;
+            pos = m_head.loadAcquire();
+        }
+        else if(diff < 0)
+            return false; // ring is full
+        else
+            pos = m_head.loadAcquire();
+    }
+
+    record->fileName = fileName;
+    record->text = text;
+    record->sequence.storeRelease(int(uint(pos)+1));
+    return true;
+}
+
+int GCF::LogWriter::writeBatch()
+{
+    int count = 0;
+    while(count < BatchSize)
+    {
+        Record &record = m_records[m_tail % uint(Capacity)];
+        if(uint(record.sequence.loadAcquire()) != m_tail+1)
+            break;
+
+        if(!m_file.isOpen() || m_file.fileName() != record.fileName)
+        {
+            m_stream.setDevice(nullptr);
+            m_file.close();
+            m_file.setFileName(record.fileName);
+            if(m_file.open(QFile::Append))
+                m_stream.setDevice(&m_file);
+            else
+                qDebug() << "Cannot write into log file " << record.fileName;
+        }
+
+        if(m_stream.device())
+            m_stream << record.text;
+
+        record.fileName.clear();
+        record.text.clear();
+        record.sequence.storeRelease(int(m_tail + uint(Capacity)));
+        ++m_tail;
+        ++count;
+    }
+
+    if(count)
+    {
+        if(m_stream.device())
+            m_stream.flush();
+        m_written.fetchAndAddOrdered(count);
+
+        if(m_blocked.loadAcquire())
+        {
+            QMutexLocker locker(&m_waitMutex);
+            m_space.wakeAll();
+        }
+    }
+
+    return count;
+}
+
+bool GCF::LogWriter::isEmpty() const
+{
+    const Record &record = m_records[m_tail % uint(Capacity)];
+    return uint(record.sequence.loadAcquire()) != m_tail+1;
+}
+
+void GCF::LogWriter::wakeWriter()
+{
+    QMutexLocker locker(&m_waitMutex);
+    m_wakeup.wakeOne();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 /**
 \class GCF::LogMessage Log.h <GCF3/Log>
 \brief Represents a single message in the log
@@ -927,27 +2685,6 @@ This class is internal. You will need to use it only if you are writing your own
 handler.
 */
 
-namespace GCF
-{
-
-struct LogMessageData
-{
-    LogMessageData() : logLevel(GCF::LogMessage::Info), parent(nullptr) { }
-
-#ifdef Q_OS_MAC
-    char unused[4]; // Padding added to align this struct
-#endif
-    int logLevel;
-    QString context;
-    QByteArray logCode;
-    QString message;
-    QString details;
-    QList<LogMessage*> children;
-    LogMessage *parent;
-};
-
-}
-
 /**
  * \internal
  */
@@ -964,6 +2701,7 @@ GCF::LogMessage::LogMessage(int level,
     d->logCode = logCode;
     d->message = msg;
     d->details = details;
+    d->timestamp = QDateTime::currentMSecsSinceEpoch();
     d->parent = parent;
     if(d->parent)
         d->parent->d->children.append(this);
@@ -1091,9 +2829,99 @@ QString GCF::LogMessage::details() const
  */
 void GCF::LogMessage::clear()
 {
-    QList<GCF::LogMessage*> children(d->children);
-    d->children.clear();
-    qDeleteAll(children);
+    // Each child takes itself out of d->children while being destroyed
+    while(!d->children.isEmpty())
+        delete d->children.last();
+    d->modelChildCount = 0;
+}
+
+/**
+ * \return time at which this message was created, in milliseconds since epoch
+ */
+qint64 GCF::LogMessage::timestamp() const
+{
+    return d->timestamp;
+}
+
+/**
+ * \return name of the source file from which this message was logged. Only
+ * messages logged using \c qDebug(), \c qWarning() and so on have this.
+ * \sa GCF::Log::setLogQtMessages()
+ */
+QString GCF::LogMessage::sourceFile() const
+{
+    return QString::fromUtf8(d->sourceFile);
+}
+
+/**
+ * \return line number from which this message was logged
+ * \sa sourceFile()
+ */
+int GCF::LogMessage::sourceLine() const
+{
+    return d->sourceLine;
+}
+
+/**
+ * \return name of the function from which this message was logged
+ * \sa sourceFile()
+ */
+QString GCF::LogMessage::sourceFunction() const
+{
+    return QString::fromUtf8(d->sourceFunction);
+}
+
+/**
+ * \return category of the Qt message; for example \c "default" or \c "qt.network"
+ * \sa sourceFile()
+ */
+QString GCF::LogMessage::category() const
+{
+    return QString::fromUtf8(d->category);
+}
+
+/**
+ * \internal
+ */
+void *GCF::LogMessage::operator new(size_t size)
+{
+    if(size != sizeof(GCF::LogMessage) || !::LogMessageSlab())
+        return ::operator new(size);
+
+    return ::LogMessageSlab()->allocate();
+}
+
+/**
+ * \internal
+ */
+void GCF::LogMessage::operator delete(void *ptr, size_t size)
+{
+    if(!ptr)
+        return;
+
+    if(size != sizeof(GCF::LogMessage))
+        ::operator delete(ptr);
+    else if(::LogMessageSlab())
+        ::LogMessageSlab()->release(ptr);
+}
+
+void *GCF::LogMessageData::operator new(size_t size)
+{
+    if(size != sizeof(GCF::LogMessageData) || !::LogMessageDataSlab())
+        return ::operator new(size);
+
+    return ::LogMessageDataSlab()->allocate();
+}
+
+void GCF::LogMessageData::operator delete(void *ptr, size_t size)
+{
+    if(!ptr)
+        return;
+
+    if(size != sizeof(GCF::LogMessageData))
+        ::operator delete(ptr);
+    else if(::LogMessageDataSlab())
+        ::LogMessageDataSlab()->release(ptr);
 }
 
 /**
@@ -1150,6 +2978,11 @@ void yetAnotherFunction()
 If no message was logged after creation on the branch, then the branch's log message
 will automatically be deleted when the branch object is deleted.
 
+Branches are tracked per thread. Messages logged by a thread go into the innermost branch
+opened by that same thread; so branches opened concurrently in different threads never
+get mixed up. A top-level branch and its messages become part of the log tree (and
+visible through the model) only when the branch is closed.
+
 \note Never create an instance of this class on the heap.
 */
 
@@ -1183,10 +3016,11 @@ GCF::LogMessageBranch::~LogMessageBranch()
         GCF::LogMessage *branch = GCF::Log::instance()->popBranch();
         if(branch == m_branchMessage)
         {
+            GCF::Log::instance()->applyBranchRetention(m_branchMessage);
             if(m_branchMessage->children().count() == 0)
                 delete m_branchMessage;
-            else if(m_branchMessage->parent()->parent() == nullptr)
-                GCF::Log::instance()->dumpLogMessage(m_branchMessage);
+            else if(m_branchMessage->d->detached)
+                GCF::Log::instance()->mergeBranch(m_branchMessage);
         }
 
         m_branchMessage = nullptr;
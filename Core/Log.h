@@ -23,9 +23,13 @@
 
 #include <QString>
 #include <QByteArray>
+#include <QStringList>
+#include <QAtomicInt>
 #include <QTextStream>
 #include <QAbstractItemModel>
 
+#include <type_traits>
+
 namespace GCF
 {
 
@@ -33,6 +37,31 @@ class Log;
 class LogMessage;
 class LogMessageBranch;
 
+class GCF_EXPORT LogContext
+{
+public:
+    constexpr LogContext(const char *file, int line, const char *function)
+        : m_file(file), m_line(line), m_function(function) { }
+
+    constexpr const char *file() const { return m_file; }
+    constexpr int line() const { return m_line; }
+    constexpr const char *function() const { return m_function; }
+
+    QString toString() const;
+    operator QString() const { return this->toString(); }
+
+    // Returns the offset of the file-name part in path, by scanning backwards
+    // from index i. Meant to be evaluated at compile time on __FILE__.
+    static constexpr int fileNameOffset(const char *path, int i) {
+        return (i <= 0) ? 0 : (path[i-1] == '/' || path[i-1] == '\\') ? i : fileNameOffset(path, i-1);
+    }
+
+private:
+    const char *m_file;
+    int m_line;
+    const char *m_function;
+};
+
 GCF_INTERFACE_BEGIN
 
 class LogMessageHandlerInterface
@@ -77,6 +106,48 @@ public:
     void setLogQtMessages(bool val);
     bool isLogQtMessages() const;
 
+    void setQtMessageCategories(const QStringList &categories);
+    QStringList qtMessageCategories() const;
+
+    void setAsynchronous(bool val);
+    bool isAsynchronous() const;
+
+    void setLogLevel(int level);
+    int logLevel() const;
+    static bool isEnabled(int level) {
+        return level <= LevelThreshold.loadAcquire();
+    }
+
+    void log(int level, const GCF::LogContext &context,
+             const QString &message, const QString &details=QString());
+
+    // Retention policies for messages held in the log tree
+    void setMaximumMessageCount(int count);
+    int maximumMessageCount() const;
+
+    void setMaximumMessageBytes(int bytes);
+    int maximumMessageBytes() const;
+
+    void setMaximumMessageAge(int msecs);
+    int maximumMessageAge() const;
+
+    void setBranchRetentionLevel(int level);
+    int branchRetentionLevel() const;
+
+    int messageCount() const;
+    int messageBytes() const;
+
+    // Rate limiting and sampling of messages, per level and context prefix
+    void setRateLimit(int level, int maxPerSecond, const QString &contextPrefix=QString(),
+                      int sampleInterval=0);
+    int rateLimit(int level, const QString &contextPrefix=QString()) const;
+    int sampleInterval(int level, const QString &contextPrefix=QString()) const;
+    void clearRateLimits();
+
+    int suppressedMessageCount() const;
+    int suppressedMessageCount(const QString &context) const;
+    void resetSuppressedMessageCounts();
+
     void fatal(const QString &context, const QString &message,
                const QString &details=QString()) {
         this->fatal(context, QByteArray(), message, details);
@@ -134,14 +205,44 @@ protected:
     // These methods will only be used via GCF::LogMessageBranch
     GCF::LogMessage *pushBranch(const QString &context);
     GCF::LogMessage *popBranch();
+    void mergeBranch(GCF::LogMessage *branch);
     void messageUpdated(GCF::LogMessage *msg);
     void messageCreated(GCF::LogMessage *msg);
     void messageDestroyed(GCF::LogMessage *msg);
+    void timerEvent(QTimerEvent *te);
+
+private slots:
+    void startModelUpdateTimer();
+
+private:
+    void addMessage(int level, const QString &context, const QByteArray &errorCode,
+                    const QString &message, const QString &details,
+                    const QMessageLogContext *source=nullptr);
+    void insertMessage(int level, const QString &context, const QByteArray &errorCode,
+                       const QString &message, const QString &details,
+                       const QMessageLogContext *source=nullptr);
+    bool admitMessage(int level, const QString &context);
+    void logSuppressedMessages();
+    bool isInTree(GCF::LogMessage *msg) const;
+    void scheduleModelUpdate();
+    bool isKnownToModel(GCF::LogMessage *msg) const;
+    QModelIndex modelIndex(GCF::LogMessage *msg) const;
+    void announceSubtree(GCF::LogMessage *msg);
+    static bool depthLessThan(GCF::LogMessage *a, GCF::LogMessage *b);
+    void enforceRetention(GCF::LogMessage *keep);
+    GCF::LogMessage *findPrunableMessage(GCF::LogMessage *parent, GCF::LogMessage *keep) const;
+    void applyBranchRetention(GCF::LogMessage *branch);
+    void retireMessage(GCF::LogMessage *msg);
+    void removeRetiredMessages();
+    void forgetModelUpdates(GCF::LogMessage *msg);
+    bool postLogMessage(GCF::LogMessage *msg, const QString &fileName);
+    void uncountMessage(GCF::LogMessage *msg);
 
 public:
     // LogMessageHandlerInterface implementation
     void handleLogMessage(GCF::LogMessage *msg);
     void print(GCF::LogMessage *msg, QTextStream &ts);
+    void flush();
 
 public:
     static QString defaultLogContext(const QString &fnInfo, const QString &file, int line);
@@ -149,6 +250,10 @@ public:
 private:
     friend class LogMessageBranch;
     friend class LogMessage;
+#if QT_VERSION >= 0x050000
+    friend void qtMsgToLogHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg);
+#endif
+    static QAtomicInt LevelThreshold;
     LogData *d;
 };
 
@@ -175,9 +280,20 @@ public:
     QByteArray logCode() const;
     QString message() const;
     QString details() const;
+    qint64 timestamp() const;
+
+    // Source of messages logged from qDebug(), qWarning() and so on
+    QString sourceFile() const;
+    int sourceLine() const;
+    QString sourceFunction() const;
+    QString category() const;
 
     void clear();
 
+    // LogMessage objects are allocated from a slab owned by GCF::Log
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
 protected:
     LogMessage(int level,
                  const QString &context,
@@ -221,6 +337,25 @@ private:
 
 }
 
-#define GCF_DEFAULT_LOG_CONTEXT GCF::Log::defaultLogContext(Q_FUNC_INFO,__FILE__,__LINE__)
+#define GCF_LOG_FILE_NAME \
+    (__FILE__ + std::integral_constant<int, GCF::LogContext::fileNameOffset(__FILE__, int(sizeof(__FILE__))-1)>::value)
+
+#define GCF_LOG_CONTEXT GCF::LogContext(GCF_LOG_FILE_NAME, __LINE__, __func__)
+
+#define GCF_DEFAULT_LOG_CONTEXT GCF_LOG_CONTEXT.toString()
+
+// Log statements that are not evaluated at all, not even their arguments,
+// if the level is above GCF::Log::logLevel()
+#define GCF_LOG(level, ...) \
+    do { \
+        if(GCF::Log::isEnabled(level)) \
+            GCF::Log::instance()->log(level, GCF_LOG_CONTEXT, __VA_ARGS__); \
+    } while(0)
+
+#define GCF_LOG_FATAL(...) GCF_LOG(GCF::LogMessage::Fatal, __VA_ARGS__)
+#define GCF_LOG_ERROR(...) GCF_LOG(GCF::LogMessage::Error, __VA_ARGS__)
+#define GCF_LOG_WARNING(...) GCF_LOG(GCF::LogMessage::Warning, __VA_ARGS__)
+#define GCF_LOG_DEBUG(...) GCF_LOG(GCF::LogMessage::Debug, __VA_ARGS__)
+#define GCF_LOG_INFO(...) GCF_LOG(GCF::LogMessage::Info, __VA_ARGS__)
 
 #endif // LOG_H
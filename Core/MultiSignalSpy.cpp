@@ -0,0 +1,481 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "MultiSignalSpy.h"
+
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QVector>
+#include <QMetaMethod>
+#include <QMetaObject>
+
+namespace GCF
+{
+
+/*
+ * Signal indexes and argument types are resolved once per meta-object and
+ * shared by all spies, across threads.
+ */
+struct MultiSignalSpyCache
+{
+    QMutex mutex;
+    QHash< QPair<const QMetaObject*,QByteArray>, int > signalIndexes;
+    QHash< QPair<const QMetaObject*,int>, QList<int> > argumentTypes;
+    QHash< QPair<const QMetaObject*,int>, QByteArray > signatures;
+
+    int signalIndex(const QMetaObject *mo, const char *signal) {
+        const QPair<const QMetaObject*,QByteArray> key(mo, QByteArray(signal));
+        QMutexLocker locker(&mutex);
+        QHash< QPair<const QMetaObject*,QByteArray>, int >::const_iterator it = signalIndexes.constFind(key);
+        if(it != signalIndexes.constEnd())
+            return it.value();
+
+        int index = mo->indexOfSignal(signal);
+        if(index < 0)
+            index = mo->indexOfSignal(QMetaObject::normalizedSignature(signal).constData());
+        signalIndexes.insert(key, index);
+        return index;
+    }
+
+    bool resolve(QObject *sender, int signalIndex, QList<int> &types, QByteArray &signature);
+};
+
+Q_GLOBAL_STATIC(MultiSignalSpyCache, GlobalMultiSignalSpyCache)
+
+bool MultiSignalSpyCache::resolve(QObject *sender, int signalIndex, QList<int> &types, QByteArray &signature)
+{
+    const QMetaObject *mo = sender->metaObject();
+    const QPair<const QMetaObject*,int> key(mo, signalIndex);
+
+    QMutexLocker locker(&mutex);
+    if(argumentTypes.contains(key))
+    {
+        types = argumentTypes.value(key);
+        signature = signatures.value(key);
+        return true;
+    }
+
+    const QMetaMethod method = mo->method(signalIndex);
+#if QT_VERSION >= 0x050000
+    signature = method.methodSignature();
+#else
+    signature = QByteArray(method.signature());
+#endif
+
+    types.clear();
+    QList<QByteArray> paramTypes = method.parameterTypes();
+    for(int i=0; i<paramTypes.count(); i++)
+    {
+        int tp = QMetaType::type(paramTypes.at(i));
+#if QT_VERSION >= 0x050000
+        if(tp == QMetaType::UnknownType)
+        {
+            void *argv[] = { &tp, &i };
+            QMetaObject::metacall(sender, QMetaObject::RegisterMethodArgumentMetaType,
+                                  method.methodIndex(), argv);
+            if(tp == -1)
+                tp = QMetaType::UnknownType;
+        }
+        if(tp == QMetaType::UnknownType)
+#else
+        if(tp == QMetaType::Void)
+#endif
+        {
+            qWarning("Don't know how to handle '%s', use qRegisterMetaType to register it.",
+                     paramTypes.at(i).constData());
+            return false;
+        }
+        types << tp;
+    }
+
+    argumentTypes.insert(key, types);
+    signatures.insert(key, signature);
+    return true;
+}
+
+struct MultiSignalSpyData
+{
+    struct Connection
+    {
+        Connection() : sender(nullptr), signalIndex(-1), active(false) { }
+
+        QObject *sender;
+        int signalIndex;
+        QByteArray signal;
+        QList<int> argTypes; // shared with the cache
+        bool active;
+    };
+
+    // Dispatch table, indexed by connection ID
+    QVector<Connection> connections;
+    QList<int> freeIds;
+
+    QMultiHash< QPair<QObject*,int>, int > connectionIds; // (sender, signal-index) => IDs
+    QHash< QObject*, QList<int> > senderConnections;
+
+    // Method ID 0 handles destruction of senders. Method ID n+1
+    // handles emissions on connection n.
+    static int slotIndex(int methodId) {
+        return GCF::MultiSignalSpyBase::staticMetaObject.methodCount() + methodId;
+    }
+};
+
+}
+
+/**
+\class GCF::MultiSignalSpy MultiSignalSpy.h <GCF3/MultiSignalSpy>
+\brief Listens to emissions of any number of signals from any number of objects
+\ingroup gcf_core
+
+A \ref GCF::SignalSpy is a QObject that listens to one signal of one object. Tools
+that listen to a large number of signals, like bridges that forward signals over
+IPC, would need one such QObject per signal. This class connects a single object
+to as many signals of as many senders as needed.
+
+Every call to \ref connectSignal() returns a connection ID. Emissions are looked up
+by this ID in a dispatch table, so the cost of an emission does not depend on the
+number of connections. Signal indexes and argument types are resolved once per class
+of sender and shared by all instances of this class.
+
+Emissions are not recorded. By default the \ref caughtSignal() signal is emitted
+for every emission. Subclasses can reimplement \ref handleSignalEmission(), or
+\ref handleRawSignalEmission() to handle arguments without converting them to
+\c QVariant.
+
+\code
+GCF::MultiSignalSpy spy;
+spy.connectSignal(button1, SIGNAL(clicked()));
+spy.connectSignal(button2, SIGNAL(clicked()));
+spy.connectSignal(slider, SIGNAL(valueChanged(int)));
+
+connect(&spy, SIGNAL(caughtSignal(QObject*,QByteArray,QVariantList)),
+        logger, SLOT(logSignal(QObject*,QByteArray,QVariantList)));
+\endcode
+
+Connections of a sender are removed when the sender is destroyed.
+*/
+
+/**
+Constructor
+*/
+GCF::MultiSignalSpy::MultiSignalSpy(QObject *parent)
+    : GCF::MultiSignalSpyBase(parent)
+{
+    d = new MultiSignalSpyData;
+}
+
+/**
+Destructor
+*/
+GCF::MultiSignalSpy::~MultiSignalSpy()
+{
+    this->disconnectAll();
+    delete d;
+}
+
+/**
+Connects \c signal of \c sender to this spy. A signal can be connected more
+than once, in which case every emission is reported once per connection.
+
+\param sender object whose signal should be listened to
+\param signal signal (constructed using the SIGNAL macro)
+\return ID of the connection, or -1 if the connection could not be made.
+*/
+int GCF::MultiSignalSpy::connectSignal(QObject *sender, const char *signal)
+{
+    if(!sender || !signal || !*signal)
+        return -1;
+
+    MultiSignalSpyCache *cache = GlobalMultiSignalSpyCache();
+    const int signalIndex = cache->signalIndex(sender->metaObject(), signal+1);
+    if(signalIndex < 0)
+        return -1;
+
+    MultiSignalSpyData::Connection connection;
+    if(!cache->resolve(sender, signalIndex, connection.argTypes, connection.signal))
+        return -1;
+    connection.sender = sender;
+    connection.signalIndex = signalIndex;
+    connection.active = true;
+
+    int id = d->freeIds.isEmpty() ? d->connections.count() : d->freeIds.last();
+    if(!QMetaObject::connect(sender, signalIndex, this, MultiSignalSpyData::slotIndex(id+1)))
+        return -1;
+
+    if(id == d->connections.count())
+        d->connections.append(connection);
+    else
+    {
+        d->freeIds.removeLast();
+        d->connections[id] = connection;
+    }
+
+    QList<int> &senderIds = d->senderConnections[sender];
+    if(senderIds.isEmpty())
+    {
+        static const int destroyedIndex = QObject::staticMetaObject.indexOfSignal("destroyed(QObject*)");
+        QMetaObject::connect(sender, destroyedIndex, this, MultiSignalSpyData::slotIndex(0));
+    }
+    senderIds.append(id);
+    d->connectionIds.insert(qMakePair(sender, signalIndex), id);
+
+    return id;
+}
+
+/**
+Removes the connection whose ID is \c connectionId.
+
+\return true if the connection was removed, false if there was no such connection.
+*/
+bool GCF::MultiSignalSpy::disconnectSignal(int connectionId)
+{
+    if(connectionId < 0 || connectionId >= d->connections.count() ||
+       !d->connections.at(connectionId).active)
+        return false;
+
+    this->removeConnection(connectionId);
+    return true;
+}
+
+/**
+Removes all connections to \c signal of \c sender.
+
+\return number of connections removed
+*/
+int GCF::MultiSignalSpy::disconnectSignal(QObject *sender, const char *signal)
+{
+    if(!sender || !signal || !*signal)
+        return 0;
+
+    const int signalIndex = GlobalMultiSignalSpyCache()->signalIndex(sender->metaObject(), signal+1);
+    const QList<int> ids = d->connectionIds.values(qMakePair(sender, signalIndex));
+    Q_FOREACH(int id, ids)
+        this->removeConnection(id);
+
+    return ids.count();
+}
+
+/**
+Removes all connections to signals of \c sender.
+
+\return number of connections removed
+*/
+int GCF::MultiSignalSpy::disconnectSender(QObject *sender)
+{
+    const QList<int> ids = d->senderConnections.value(sender);
+    Q_FOREACH(int id, ids)
+        this->removeConnection(id);
+
+    return ids.count();
+}
+
+/**
+Removes all connections
+*/
+void GCF::MultiSignalSpy::disconnectAll()
+{
+    for(int i=0; i<d->connections.count(); i++)
+    {
+        if(d->connections.at(i).active)
+            this->removeConnection(i);
+    }
+}
+
+/**
+\return true if \c signal of \c sender is connected to this spy
+*/
+bool GCF::MultiSignalSpy::isConnected(QObject *sender, const char *signal) const
+{
+    if(!sender || !signal || !*signal)
+        return false;
+
+    const int signalIndex = GlobalMultiSignalSpyCache()->signalIndex(sender->metaObject(), signal+1);
+    return d->connectionIds.contains(qMakePair(sender, signalIndex));
+}
+
+/**
+\return total number of connections
+*/
+int GCF::MultiSignalSpy::connectionCount() const
+{
+    return d->connections.count() - d->freeIds.count();
+}
+
+/**
+\return number of connections to signals of \c sender
+*/
+int GCF::MultiSignalSpy::connectionCount(QObject *sender) const
+{
+    return d->senderConnections.value(sender).count();
+}
+
+/**
+\return sender of the connection whose ID is \c connectionId; null if there
+is no such connection.
+*/
+QObject *GCF::MultiSignalSpy::connectionSender(int connectionId) const
+{
+    if(connectionId < 0 || connectionId >= d->connections.count())
+        return nullptr;
+
+    return d->connections.at(connectionId).sender;
+}
+
+/**
+\return normalized signature of the signal of the connection whose ID is
+\c connectionId; empty if there is no such connection.
+*/
+QByteArray GCF::MultiSignalSpy::connectionSignal(int connectionId) const
+{
+    if(connectionId < 0 || connectionId >= d->connections.count())
+        return QByteArray();
+
+    return d->connections.at(connectionId).signal;
+}
+
+/**
+\return meta-type IDs of arguments of the signal of the connection whose ID
+is \c connectionId
+*/
+QList<int> GCF::MultiSignalSpy::connectionArgumentTypes(int connectionId) const
+{
+    if(connectionId < 0 || connectionId >= d->connections.count())
+        return QList<int>();
+
+    return d->connections.at(connectionId).argTypes;
+}
+
+/**
+\internal
+*/
+int GCF::MultiSignalSpy::qt_metacall(QMetaObject::Call call, int methodId, void **a)
+{
+    methodId = GCF::MultiSignalSpyBase::qt_metacall(call, methodId, a);
+    if(methodId < 0 || call != QMetaObject::InvokeMetaMethod)
+        return methodId;
+
+    if(methodId == 0)
+    {
+        this->senderDestroyed( *reinterpret_cast<QObject**>(a[1]) );
+        return -1;
+    }
+
+    const int id = methodId-1;
+    if(id >= d->connections.count() || !d->connections.at(id).active)
+        return -1;
+
+    // Copy, because handlers may add or remove connections
+    const QList<int> argTypes = d->connections.at(id).argTypes;
+    if(this->handleRawSignalEmission(id, a+1, argTypes))
+        return -1;
+
+    QVariantList args;
+    args.reserve(argTypes.count());
+    for(int i=0; i<argTypes.count(); i++)
+    {
+        if(argTypes.at(i) == QMetaType::QVariant)
+            args.append( *reinterpret_cast<QVariant*>(a[i+1]) );
+        else
+            args.append( QVariant(argTypes.at(i), a[i+1]) );
+    }
+
+    this->handleSignalEmission(id, args);
+    return -1;
+}
+
+/**
+This virtual function is called whenever a signal emission is caught, before
+arguments are converted to \c QVariant. If the function returns true, the emission
+is considered handled and \ref handleSignalEmission() is not called. The default
+implementation returns false.
+
+\param connectionId ID of the connection on which the emission was caught
+\param args pointers to arguments of the signal. \c args[i] points to a value
+of type \c argTypes[i]
+\param argTypes meta-type IDs of the arguments
+*/
+bool GCF::MultiSignalSpy::handleRawSignalEmission(int connectionId, void **args, const QList<int> &argTypes)
+{
+    Q_UNUSED(connectionId);
+    Q_UNUSED(args);
+    Q_UNUSED(argTypes);
+    return false;
+}
+
+/**
+This virtual function is called whenever a signal emission is caught. The
+default implementation emits the \ref caughtSignal() signal.
+
+\param connectionId ID of the connection on which the emission was caught
+\param args arguments emitted by the signal
+*/
+void GCF::MultiSignalSpy::handleSignalEmission(int connectionId, const QVariantList &args)
+{
+    const MultiSignalSpyData::Connection &connection = d->connections.at(connectionId);
+    emit caughtSignal(connection.sender, connection.signal, args);
+}
+
+/**
+\fn void GCF::MultiSignalSpyBase::caughtSignal(QObject *sender, const QByteArray &signal, const QVariantList &args)
+
+This signal is emitted by \ref GCF::MultiSignalSpy::handleSignalEmission() for
+every signal emission caught.
+
+\param sender object that emitted the signal
+\param signal normalized signature of the signal
+\param args arguments emitted by the signal
+*/
+
+void GCF::MultiSignalSpy::removeConnection(int connectionId)
+{
+    MultiSignalSpyData::Connection &connection = d->connections[connectionId];
+    QObject *sender = connection.sender;
+
+    QMetaObject::disconnect(sender, connection.signalIndex, this,
+                            MultiSignalSpyData::slotIndex(connectionId+1));
+    d->connectionIds.remove(qMakePair(sender, connection.signalIndex), connectionId);
+
+    QHash< QObject*, QList<int> >::iterator it = d->senderConnections.find(sender);
+    if(it != d->senderConnections.end())
+    {
+        it.value().removeOne(connectionId);
+        if(it.value().isEmpty())
+        {
+            d->senderConnections.erase(it);
+            static const int destroyedIndex = QObject::staticMetaObject.indexOfSignal("destroyed(QObject*)");
+            QMetaObject::disconnect(sender, destroyedIndex, this, MultiSignalSpyData::slotIndex(0));
+        }
+    }
+
+    connection = MultiSignalSpyData::Connection();
+    d->freeIds.append(connectionId);
+}
+
+void GCF::MultiSignalSpy::senderDestroyed(QObject *sender)
+{
+    // Qt removes connections of the sender on its own
+    const QList<int> ids = d->senderConnections.take(sender);
+    Q_FOREACH(int id, ids)
+    {
+        MultiSignalSpyData::Connection &connection = d->connections[id];
+        d->connectionIds.remove(qMakePair(sender, connection.signalIndex), id);
+        connection = MultiSignalSpyData::Connection();
+        d->freeIds.append(id);
+    }
+}
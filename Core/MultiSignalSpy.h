@@ -0,0 +1,86 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef MULTISIGNALSPY_H
+#define MULTISIGNALSPY_H
+
+#include "GCFGlobal.h"
+
+#include <QList>
+#include <QObject>
+#include <QVariantList>
+
+namespace GCF
+{
+
+class GCF_EXPORT MultiSignalSpyBase : public QObject
+{
+    Q_OBJECT
+
+public:
+    virtual ~MultiSignalSpyBase() { }
+
+signals:
+    void caughtSignal(QObject *sender, const QByteArray &signal, const QVariantList &args);
+
+protected:
+    MultiSignalSpyBase(QObject *parent) : QObject(parent) { }
+};
+
+struct MultiSignalSpyData;
+class GCF_EXPORT MultiSignalSpy : public MultiSignalSpyBase
+{
+public:
+    MultiSignalSpy(QObject *parent=nullptr);
+    ~MultiSignalSpy();
+
+    int connectSignal(QObject *sender, const char *signal);
+    bool disconnectSignal(int connectionId);
+    int disconnectSignal(QObject *sender, const char *signal);
+    int disconnectSender(QObject *sender);
+    void disconnectAll();
+
+    bool isConnected(QObject *sender, const char *signal) const;
+    int connectionCount() const;
+    int connectionCount(QObject *sender) const;
+
+    QObject *connectionSender(int connectionId) const;
+    QByteArray connectionSignal(int connectionId) const;
+    QList<int> connectionArgumentTypes(int connectionId) const;
+
+protected:
+#if QT_VERSION >= 0x050000
+    int qt_metacall(QMetaObject::Call call, int methodId, void **a) Q_DECL_OVERRIDE;
+#else
+    int qt_metacall(QMetaObject::Call call, int methodId, void **a);
+#endif
+
+    virtual bool handleRawSignalEmission(int connectionId, void **args, const QList<int> &argTypes);
+    virtual void handleSignalEmission(int connectionId, const QVariantList &args);
+
+private:
+    void removeConnection(int connectionId);
+    void senderDestroyed(QObject *sender);
+
+private:
+    MultiSignalSpyData *d;
+};
+
+}
+
+#endif // MULTISIGNALSPY_H
@@ -92,7 +92,8 @@ class SignalSpy : public SignalSpyBase
 {
 public:
     SignalSpy(QObject *sender, const char *signal, QObject *parent=nullptr)
-        : SignalSpyBase(parent), m_sender(sender), m_valid(false) {
+        : SignalSpyBase(parent), m_sender(sender), m_valid(false),
+          m_historyLimit(-1), m_emissionCount(0) {
         // First find out if the signal is valid in sender
         if(sender && signal) {
             QByteArray signalMember(signal+1);
@@ -151,12 +152,20 @@ public:
     bool isValid() const { return m_sender.data() && m_valid; }
     QObject *sender() const { return m_sender.data(); }
     QByteArray signal() const { return m_signal; }
+    QList<int> argumentTypes() const { return m_argTypes; }
+
+    void setHistoryLimit(int limit) {
+        m_historyLimit = limit < 0 ? -1 : limit;
+        this->trimHistory();
+    }
+    int historyLimit() const { return m_historyLimit; }
+    int emissionCount() const { return m_emissionCount; }
 
     bool wait(int timeout=5000) {
         return m_waitLoop.enter(timeout) >= 0;
     }
 
-    void clear() { m_emissions.clear(); }
+    void clear() { m_emissions.clear(); m_emissionCount = 0; }
     int count() const { return m_emissions.count(); }
     bool isEmpty() const { return m_emissions.isEmpty(); }
     const QVariantList &first() const { return m_emissions.first(); }
@@ -179,15 +188,22 @@ protected:
             return methodId;
         if(call == QMetaObject::InvokeMetaMethod) {
             if(methodId == 0) {
-                QVariantList args;
-                for(int i=0; i<m_argTypes.count(); i++) {
-                    if(m_argTypes.at(i) == QMetaType::QVariant)
-                        args.append( *reinterpret_cast<QVariant*>(a[i+1]) );
-                    else
-                        args.append( QVariant(m_argTypes.at(i), a[i+1]) );
+                ++m_emissionCount;
+                if(!this->handleRawSignalEmission(a+1, m_argTypes)) {
+                    QVariantList args;
+                    args.reserve(m_argTypes.count());
+                    for(int i=0; i<m_argTypes.count(); i++) {
+                        if(m_argTypes.at(i) == QMetaType::QVariant)
+                            args.append( *reinterpret_cast<QVariant*>(a[i+1]) );
+                        else
+                            args.append( QVariant(m_argTypes.at(i), a[i+1]) );
+                    }
+                    if(m_historyLimit != 0) {
+                        m_emissions.append(args);
+                        this->trimHistory();
+                    }
+                    this->handleSignalEmission(args);
                 }
-                m_emissions.append(args);
-                this->handleSignalEmission(args);
                 m_waitLoop.exitLoop();
             }
             --methodId;
@@ -195,15 +211,31 @@ protected:
         return methodId;
     }
 
+    virtual bool handleRawSignalEmission(void **args, const QList<int> &argTypes) {
+        Q_UNUSED(args);
+        Q_UNUSED(argTypes);
+        return false;
+    }
+
     virtual void handleSignalEmission(const QVariantList &args) {
         emit caughtSignal(args);
     }
 
+private:
+    void trimHistory() {
+        if(m_historyLimit >= 0) {
+            while(m_emissions.count() > m_historyLimit)
+                m_emissions.removeFirst();
+        }
+    }
+
 private:
     QPointer<QObject> m_sender;
     QByteArray m_signal;
     QList<int> m_argTypes;
     bool m_valid;
+    int m_historyLimit;
+    int m_emissionCount;
     WaitEventLoop m_waitLoop;
     QList< QVariantList > m_emissions;
 };
@@ -0,0 +1,437 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "ThreadedJob.h"
+
+#include <QMutex>
+#include <QPointer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QThreadStorage>
+
+namespace GCF
+{
+
+/*
+ * State of one execution of ThreadedJob::run(). It is shared between the
+ * job and the runnable, so that a run that was cancelled (and is still
+ * winding down) does not see flags meant for a newer run of the same job.
+ */
+struct ThreadedJobRun
+{
+    ThreadedJobRun(int g) : generation(g), cancelled(0), suspended(0) { }
+
+    const int generation;
+    QAtomicInt cancelled;
+    QAtomicInt suspended;
+    QMutex mutex;
+    QWaitCondition resumed;
+
+    void wake() {
+        QMutexLocker locker(&mutex);
+        resumed.wakeAll();
+    }
+};
+
+struct ThreadedJobData
+{
+    ThreadedJobData() : generation(0), finishPending(false),
+        finishSuccess(false), activeRuns(0) { }
+
+    QPointer<QThreadPool> threadPool;
+    QSharedPointer<ThreadedJobRun> run;
+    int generation;
+
+    // Outcome of run() that could not be reported because the
+    // job was suspended when run() returned.
+    bool finishPending;
+    bool finishSuccess;
+    QString finishError;
+
+    QMutex activeMutex;
+    QWaitCondition idle;
+    int activeRuns;
+};
+
+typedef QThreadStorage< QSharedPointer<ThreadedJobRun> > ThreadedJobRunStorage;
+Q_GLOBAL_STATIC(ThreadedJobRunStorage, CurrentThreadedJobRun)
+
+class ThreadedJobRunnable : public QRunnable
+{
+public:
+    ThreadedJobRunnable(GCF::ThreadedJob *job, const QSharedPointer<ThreadedJobRun> &run)
+        : m_job(job), m_run(run) { }
+
+    void run() {
+        CurrentThreadedJobRun()->setLocalData(m_run);
+        GCF::Result result = m_run->cancelled.loadAcquire() ?
+                    GCF::Result(false, QString(), "Cancelled") : m_job->run();
+        CurrentThreadedJobRun()->setLocalData(QSharedPointer<ThreadedJobRun>());
+
+        QMetaObject::invokeMethod(m_job, "onRunFinished", Qt::QueuedConnection,
+                                  Q_ARG(int, m_run->generation),
+                                  Q_ARG(bool, result.isSuccess()),
+                                  Q_ARG(QString, result.message()));
+
+        // The job waits for this in its destructor, so it must not
+        // be accessed after this point.
+        ThreadedJobData *d = m_job->d;
+        QMutexLocker locker(&d->activeMutex);
+        --d->activeRuns;
+        d->idle.wakeAll();
+    }
+
+private:
+    GCF::ThreadedJob *m_job;
+    QSharedPointer<ThreadedJobRun> m_run;
+};
+
+}
+
+/**
+\class GCF::ThreadedJob ThreadedJob.h <GCF3/ThreadedJob>
+\brief Base class for jobs whose work is done in a thread pool
+\ingroup gcf_core
+
+Subclasses reimplement \ref run() to carry out CPU bound work, like filtering
+an image, hashing a file or indexing content. When the job is started, \ref run()
+is executed on a thread from \ref threadPool(). The job completes when
+\ref run() returns; it is aborted with the error message of the returned
+\ref GCF::Result if the result is a failure.
+
+\code
+class HashJob : public GCF::ThreadedJob
+{
+public:
+    HashJob(const QString &fileName, QObject *parent=0)
+        : GCF::ThreadedJob("Hash", parent), m_fileName(fileName) { }
+    ~HashJob() { this->wait(); }
+
+protected:
+    GCF::Result run() {
+        QFile file(m_fileName);
+        if(!file.open(QFile::ReadOnly))
+            return GCF::Result(false, QString(), file.errorString());
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        while(!file.atEnd()) {
+            if(!this->checkpoint())
+                return false;
+            hash.addData(file.read(65536));
+            this->reportProgress(int(file.pos()*100/file.size()));
+        }
+        m_hash = hash.result();
+        return true;
+    }
+
+private:
+    QString m_fileName;
+    QByteArray m_hash;
+};
+\endcode
+
+Cancel, suspend and resume are cooperative. Calling \ref cancel(), \ref suspend()
+or \ref resume() only sets a flag that \ref run() is expected to look at
+regularly by calling \ref checkpoint() or \ref isCancelRequested(). The state of
+the job changes right away; a cancelled job is complete even if \ref run() is yet
+to return, and whatever it returns is ignored.
+
+Functions of \ref GCF::AbstractJob that report progress, status and errors must
+only be called from the thread that owns the job. From within \ref run(), use
+\ref reportProgress(), \ref reportStatus() and \ref reportError() instead. They
+queue the report to the thread that owns the job.
+
+The destructor cancels the run and waits for \ref run() to return. Since
+members of the subclass are destroyed by then, subclasses whose \ref run()
+accesses their own members must call \ref wait() in their destructor.
+*/
+
+/**
+Constructor
+
+\param kind categorization of the job
+\param parent parent object
+*/
+GCF::ThreadedJob::ThreadedJob(const QString &kind, QObject *parent)
+    : GCF::AbstractJob(kind, parent)
+{
+    d = new ThreadedJobData;
+}
+
+/**
+Destructor. Cancels the current run, if any, and waits for it to return.
+*/
+GCF::ThreadedJob::~ThreadedJob()
+{
+    if(d->run)
+    {
+        d->run->cancelled.storeRelease(1);
+        d->run->suspended.storeRelease(0);
+        d->run->wake();
+    }
+
+    this->wait();
+    delete d;
+}
+
+/**
+Sets the thread pool on which \ref run() is executed, the next time the job
+is started or retried. By default \c QThreadPool::globalInstance() is used.
+
+\param pool thread pool to use. If null, the global thread pool is used.
+*/
+void GCF::ThreadedJob::setThreadPool(QThreadPool *pool)
+{
+    d->threadPool = pool;
+}
+
+/**
+\return the thread pool on which \ref run() is executed
+*/
+QThreadPool *GCF::ThreadedJob::threadPool() const
+{
+    return d->threadPool ? d->threadPool.data() : QThreadPool::globalInstance();
+}
+
+/**
+Blocks the calling thread until \ref run() returns.
+
+\note The outcome of \ref run() is reported to the job through the event loop
+of the thread that owns the job. So the job will not be complete when this
+function returns, until events are processed.
+
+\param msecs maximum time to wait in milliseconds. If negative, there is no limit.
+\return true if \ref run() is not executing anymore, false on timeout.
+*/
+bool GCF::ThreadedJob::wait(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker locker(&d->activeMutex);
+    while(d->activeRuns > 0)
+    {
+        if(msecs < 0)
+        {
+            d->idle.wait(&d->activeMutex);
+            continue;
+        }
+
+        const qint64 remaining = msecs - timer.elapsed();
+        if(remaining <= 0 || !d->idle.wait(&d->activeMutex, ulong(remaining)))
+            return d->activeRuns == 0;
+    }
+
+    return true;
+}
+
+/**
+\fn GCF::Result GCF::ThreadedJob::run()
+
+Reimplement this function to do the work of the job. It is executed on a
+thread from \ref threadPool(); so it must not access widgets or any object
+that is not thread-safe. Call \ref checkpoint() regularly to support cancel,
+suspend and resume.
+
+\return success if the work was done. Otherwise the job is aborted with the
+error message of the result.
+*/
+
+/**
+This function can be called from within \ref run().
+
+\return true if the job was cancelled (or destroyed) and \ref run() should
+return as soon as possible. Always returns false when called from outside of
+\ref run().
+*/
+bool GCF::ThreadedJob::isCancelRequested() const
+{
+    QSharedPointer<ThreadedJobRun> run = CurrentThreadedJobRun()->localData();
+    return run && run->cancelled.loadAcquire();
+}
+
+/**
+This function can be called from within \ref run(). It blocks for as long as
+the job is suspended.
+
+\return false if the job was cancelled and \ref run() should return right
+away, true if \ref run() can continue.
+*/
+bool GCF::ThreadedJob::checkpoint()
+{
+    QSharedPointer<ThreadedJobRun> run = CurrentThreadedJobRun()->localData();
+    if(!run)
+        return true;
+
+    QMutexLocker locker(&run->mutex);
+    while(run->suspended.loadAcquire() && !run->cancelled.loadAcquire())
+        run->resumed.wait(&run->mutex);
+
+    return !run->cancelled.loadAcquire();
+}
+
+/**
+Reports progress from within \ref run(). The progress is set on the job, using
+\ref setProgress(), in the thread that owns the job.
+
+\param val progress value of job in percentage
+\param msg progress message of job
+*/
+void GCF::ThreadedJob::reportProgress(int val, const QString &msg)
+{
+    QSharedPointer<ThreadedJobRun> run = CurrentThreadedJobRun()->localData();
+    if(run)
+        QMetaObject::invokeMethod(this, "onRunProgress", Qt::QueuedConnection,
+                                  Q_ARG(int, run->generation), Q_ARG(int, val),
+                                  Q_ARG(QString, msg));
+}
+
+/**
+Reports status from within \ref run(). The status is set on the job, using
+\ref setStatus(), in the thread that owns the job.
+
+\param msg status message of the job
+*/
+void GCF::ThreadedJob::reportStatus(const QString &msg)
+{
+    QSharedPointer<ThreadedJobRun> run = CurrentThreadedJobRun()->localData();
+    if(run)
+        QMetaObject::invokeMethod(this, "onRunStatus", Qt::QueuedConnection,
+                                  Q_ARG(int, run->generation), Q_ARG(QString, msg));
+}
+
+/**
+Reports a non-critical error from within \ref run(). The error is set on the
+job, using \ref setError(), in the thread that owns the job. To abort the job,
+return a failure result from \ref run() instead.
+
+\param errMsg error message
+*/
+void GCF::ThreadedJob::reportError(const QString &errMsg)
+{
+    QSharedPointer<ThreadedJobRun> run = CurrentThreadedJobRun()->localData();
+    if(run)
+        QMetaObject::invokeMethod(this, "onRunError", Qt::QueuedConnection,
+                                  Q_ARG(int, run->generation), Q_ARG(QString, errMsg));
+}
+
+/**
+Queues \ref run() for execution on \ref threadPool().
+*/
+GCF::Result GCF::ThreadedJob::startJob()
+{
+    d->run = QSharedPointer<ThreadedJobRun>(new ThreadedJobRun(++d->generation));
+    d->finishPending = false;
+
+    d->activeMutex.lock();
+    ++d->activeRuns;
+    d->activeMutex.unlock();
+
+    this->threadPool()->start(new ThreadedJobRunnable(this, d->run));
+    return true;
+}
+
+/**
+Requests \ref run() to return. Whatever it returns is ignored.
+*/
+GCF::Result GCF::ThreadedJob::cancelJob()
+{
+    if(d->run)
+    {
+        d->run->cancelled.storeRelease(1);
+        d->run->wake();
+    }
+
+    d->finishPending = false;
+    return true;
+}
+
+/**
+Requests \ref run() to block at its next \ref checkpoint().
+*/
+GCF::Result GCF::ThreadedJob::suspendJob()
+{
+    if(!d->run)
+        return GCF::Result(false, QString(), "Job is not running");
+
+    d->run->suspended.storeRelease(1);
+    return true;
+}
+
+/**
+Unblocks \ref run() if it is waiting in \ref checkpoint().
+*/
+GCF::Result GCF::ThreadedJob::resumeJob()
+{
+    if(!d->run)
+        return GCF::Result(false, QString(), "Job is not running");
+
+    d->run->suspended.storeRelease(0);
+    d->run->wake();
+
+    // The job can complete only after it is marked as resumed.
+    if(d->finishPending)
+        QMetaObject::invokeMethod(this, "completeRun", Qt::QueuedConnection);
+
+    return true;
+}
+
+void GCF::ThreadedJob::onRunProgress(int generation, int val, const QString &msg)
+{
+    if(generation == d->generation)
+        this->setProgress(val, msg);
+}
+
+void GCF::ThreadedJob::onRunStatus(int generation, const QString &msg)
+{
+    if(generation == d->generation && this->isRunning())
+        this->setStatus(msg);
+}
+
+void GCF::ThreadedJob::onRunError(int generation, const QString &errMsg)
+{
+    if(generation == d->generation && this->isRunning())
+        this->setError(errMsg);
+}
+
+void GCF::ThreadedJob::onRunFinished(int generation, bool success, const QString &errMsg)
+{
+    if(generation != d->generation || !this->isRunning())
+        return;
+
+    d->finishPending = true;
+    d->finishSuccess = success;
+    d->finishError = errMsg;
+    this->completeRun();
+}
+
+void GCF::ThreadedJob::completeRun()
+{
+    if(!d->finishPending || !this->isRunning() || this->isSuspended())
+        return;
+
+    d->finishPending = false;
+    if(d->finishSuccess)
+        this->done();
+    else
+        this->abort(d->finishError);
+}
@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef THREADEDJOB_H
+#define THREADEDJOB_H
+
+#include "GCFGlobal.h"
+#include "AbstractJob.h"
+
+class QThreadPool;
+
+namespace GCF
+{
+
+struct ThreadedJobData;
+class GCF_EXPORT ThreadedJob : public AbstractJob
+{
+    Q_OBJECT
+
+public:
+    ThreadedJob(const QString &kind, QObject *parent=nullptr);
+    ~ThreadedJob();
+
+    void setThreadPool(QThreadPool *pool);
+    QThreadPool *threadPool() const;
+
+    bool wait(int msecs=-1);
+
+protected:
+    virtual GCF::Result run() = 0;
+
+    bool isCancelRequested() const;
+    bool checkpoint();
+    void reportProgress(int val, const QString &msg=QString());
+    void reportStatus(const QString &msg);
+    void reportError(const QString &errMsg);
+
+    GCF::Result startJob();
+    GCF::Result cancelJob();
+    GCF::Result suspendJob();
+    GCF::Result resumeJob();
+
+private:
+    Q_SLOT void onRunProgress(int generation, int val, const QString &msg);
+    Q_SLOT void onRunStatus(int generation, const QString &msg);
+    Q_SLOT void onRunError(int generation, const QString &errMsg);
+    Q_SLOT void onRunFinished(int generation, bool success, const QString &errMsg);
+    Q_SLOT void completeRun();
+
+private:
+    friend class ThreadedJobRunnable;
+    ThreadedJobData *d;
+};
+
+}
+
+#endif // THREADEDJOB_H
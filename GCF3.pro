@@ -10,6 +10,7 @@ SUBDIRS += \
     Gui \
     Ipc \
     Investigator \
+    Tools \
     # Fiber \
     # GDrive
 
@@ -23,16 +23,19 @@ HEADERS += \
     IpcServer.h \
     IpcServer_p.h \
     IpcCall.h \
+    IpcCall_p.h \
     IpcCommon_p.h \
     IpcRemoteObject.h \
-    IpcServerDiscovery.h
+    IpcServerDiscovery.h \
+    IpcTrace.h
 
 SOURCES += \
     IpcServer.cpp \
     IpcCall.cpp \
     IpcCommon_p.cpp \
     IpcRemoteObject.cpp \
-    IpcServerDiscovery.cpp
+    IpcServerDiscovery.cpp \
+    IpcTrace.cpp
 
 OTHER_FILES += \
     Ipc.dox
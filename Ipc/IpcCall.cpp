@@ -17,13 +17,16 @@
 ****************************************************************************/
 
 #include "IpcCall.h"
+#include "IpcCall_p.h"
 #include "IpcCommon_p.h"
 #include "../Core/Log.h"
 
 #include <QTimer>
-#include <QTcpSocket>
-#include <QDataStream>
-#include <QSemaphore>
+#include <QMutex>
+#include <QPointer>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QThreadStorage>
 
 Q_GLOBAL_STATIC(QObject, GlobalIpcCallParent)
 
@@ -54,6 +57,18 @@ void abcd::callDone(bool val) {
     }
 }
 \endcode
+
+Calls made from a thread to the same address and port share a single socket
+connection. Many calls can be in flight on that connection at the same time; their
+responses are matched by message-id and delivered as soon as they arrive. The
+connection is kept open for \ref keepAliveDuration() milliseconds after the last
+call on it is done, so that subsequent calls don't have to pay for a new connection.
+
+The number of calls that can be active on a destination (address and port) at any
+point of time is limited; see \ref setCallLimit(). Calls placed beyond that limit are
+queued and admitted in the order in which they were placed, as soon as an active call
+to the same destination is done. Use \ref callMetrics() to know how deep the queue
+has grown and how long calls had to wait in it.
  */
 
 namespace GCF
@@ -64,7 +79,8 @@ struct IpcCallData
     IpcCallData() : port(0),
         done(false), success(false),
         messageId(-1), autoDelete(false),
-        socket(nullptr), timeoutTimer(nullptr) { }
+        timeoutTimer(nullptr),
+        admission(NotAdmitted), queueWaitTime(-1) { }
 
     QHostAddress address;
     quint16 port;
@@ -89,15 +105,153 @@ struct IpcCallData
 #ifdef Q_OS_MAC
     char unused3[3]; // Padding
 #endif
-    QTcpSocket *socket;
+    QPointer<GCF::IpcCallConnection> connection;
     QTimer *timeoutTimer;
 
-    static QSemaphore CallSemaphore;
+    // Admission state is guarded by IpcCallAdmission::mutex
+    enum AdmissionState { NotAdmitted, Queued, Admitted, Released };
+    int admission;
+    int queueWaitTime;
+    QElapsedTimer queueTimer;
+
+    static QAtomicInt KeepAliveDuration;
+};
+
+inline QString IpcCallDestination(const QHostAddress &addr, quint16 port)
+{
+    return QString("%1:%2").arg(addr.toString()).arg(port);
+}
+
+/*
+ * Admits calls on a per-destination basis. When a destination has as many active
+ * calls as its limit, new calls are queued. A slot freed by a call that is done is
+ * handed over to the call at the head of the queue right away.
+ */
+struct IpcCallAdmission
+{
+    struct Waiter
+    {
+        GCF::IpcCall *call;
+        GCF::IpcCallData *data;
+    };
+
+    struct Destination
+    {
+        Destination() : limit(0), activeCalls(0), maxQueuedCalls(0),
+            admittedCalls(0), totalWaitTime(0), maxWaitTime(0) { }
+
+        int limit; // 0 means IpcCallAdmission::defaultLimit
+        int activeCalls;
+        QList<Waiter> queue;
+        int maxQueuedCalls;
+        qint64 admittedCalls;
+        qint64 totalWaitTime;
+        qint64 maxWaitTime;
+    };
+
+    IpcCallAdmission() : defaultLimit(20) { }
+
+    int limit(const Destination &dest) const {
+        return dest.limit > 0 ? dest.limit : defaultLimit;
+    }
+
+    bool admit(GCF::IpcCall *call, GCF::IpcCallData *data);
+    void release(GCF::IpcCallData *data);
+    void admitQueuedCalls(Destination &dest);
+
+    QMutex mutex;
+    int defaultLimit;
+    QMap<QString, Destination> destinations;
 };
 
+struct IpcCallConnectionPool
+{
+    ~IpcCallConnectionPool() {
+        QList<GCF::IpcCallConnection*> list = connections.values();
+        connections.clear();
+        qDeleteAll(list);
+    }
+
+    QMap<QString, GCF::IpcCallConnection*> connections;
+};
+
+}
+
+QAtomicInt GCF::IpcCallData::KeepAliveDuration(30000);
+
+Q_GLOBAL_STATIC(QThreadStorage<GCF::IpcCallConnectionPool*>, IpcCallConnectionPools)
+Q_GLOBAL_STATIC(GCF::IpcCallAdmission, IpcCallAdmissions)
+
+bool GCF::IpcCallAdmission::admit(GCF::IpcCall *call, GCF::IpcCallData *data)
+{
+    QMutexLocker locker(&mutex);
+
+    Destination &dest = destinations[GCF::IpcCallDestination(data->address, data->port)];
+    if(dest.queue.isEmpty() && dest.activeCalls < this->limit(dest))
+    {
+        ++dest.activeCalls;
+        ++dest.admittedCalls;
+        data->admission = GCF::IpcCallData::Admitted;
+        data->queueWaitTime = 0;
+        return true;
+    }
+
+    Waiter waiter;
+    waiter.call = call;
+    waiter.data = data;
+    dest.queue.append(waiter);
+    dest.maxQueuedCalls = qMax(dest.maxQueuedCalls, dest.queue.count());
+
+    data->admission = GCF::IpcCallData::Queued;
+    data->queueTimer.start();
+    return false;
+}
+
+void GCF::IpcCallAdmission::release(GCF::IpcCallData *data)
+{
+    QMutexLocker locker(&mutex);
+
+    if(data->admission == GCF::IpcCallData::NotAdmitted ||
+       data->admission == GCF::IpcCallData::Released)
+        return;
+
+    Destination &dest = destinations[GCF::IpcCallDestination(data->address, data->port)];
+    if(data->admission == GCF::IpcCallData::Queued)
+    {
+        for(int i=0; i<dest.queue.count(); i++)
+        {
+            if(dest.queue.at(i).data == data)
+            {
+                dest.queue.removeAt(i);
+                break;
+            }
+        }
+    }
+    else
+        --dest.activeCalls;
+
+    data->admission = GCF::IpcCallData::Released;
+    this->admitQueuedCalls(dest);
 }
 
-QSemaphore GCF::IpcCallData::CallSemaphore(20);
+void GCF::IpcCallAdmission::admitQueuedCalls(Destination &dest)
+{
+    // Must be called with the mutex locked
+    while(!dest.queue.isEmpty() && dest.activeCalls < this->limit(dest))
+    {
+        Waiter waiter = dest.queue.takeFirst();
+        waiter.data->admission = GCF::IpcCallData::Admitted;
+        waiter.data->queueWaitTime = int(waiter.data->queueTimer.elapsed());
+
+        ++dest.activeCalls;
+        ++dest.admittedCalls;
+        dest.totalWaitTime += waiter.data->queueWaitTime;
+        dest.maxWaitTime = qMax(dest.maxWaitTime, qint64(waiter.data->queueWaitTime));
+
+        // The call may live in another thread
+        QMetaObject::invokeMethod(waiter.call, "onAdmitted", Qt::QueuedConnection);
+    }
+}
 
 /**
  * Constructor
@@ -135,6 +289,14 @@ GCF::IpcCall::IpcCall(const QHostAddress &addr, quint16 port,
  */
 GCF::IpcCall::~IpcCall()
 {
+    // Calls parented to GlobalIpcCallParent can outlive the admission queue
+    GCF::IpcCallAdmission *admission = ::IpcCallAdmissions();
+    if(admission)
+        admission->release(d);
+
+    if(d->connection)
+        d->connection->detach(this);
+
     delete d;
 }
 
@@ -248,6 +410,143 @@ bool GCF::IpcCall::isAutoDelete() const
     return d->autoDelete;
 }
 
+/**
+ * Sets the duration for which an idle connection to a remote application is kept
+ * open, after all calls made on it are done. Calls made within that duration reuse
+ * the connection. A value of 0 closes the connection as soon as it becomes idle.
+ * If no duration is set, then a default value of 30 seconds is used.
+ *
+ * @param msecs duration in milliseconds
+ *
+ * \note the duration applies to all calls made from all threads in the application.
+ */
+void GCF::IpcCall::setKeepAliveDuration(int msecs)
+{
+    GCF::IpcCallData::KeepAliveDuration.fetchAndStoreOrdered(qMax(0, msecs));
+}
+
+/**
+ * @return duration in milliseconds for which idle connections are kept open.
+ */
+int GCF::IpcCall::keepAliveDuration()
+{
+    return GCF::IpcCallData::KeepAliveDuration.loadAcquire();
+}
+
+/**
+ * @return time in milliseconds for which this call had to wait for admission, because
+ * its destination already had as many active calls as its \ref callLimit(). The function
+ * returns -1 if the call has not been admitted yet.
+ */
+int GCF::IpcCall::queueWaitTime() const
+{
+    QMutexLocker locker(&::IpcCallAdmissions()->mutex);
+    return d->queueWaitTime;
+}
+
+/**
+ * Limits the number of calls that can be active on a destination at any point of time.
+ * Calls placed beyond the limit are queued and admitted in order, as and when active
+ * calls are done. If no limit is set for a destination, then \ref defaultCallLimit()
+ * applies to it.
+ *
+ * @param addr address of the computer where the remote application is running
+ * @param port port number on which the remote application's \ref GCF::IpcServer is listening
+ * @param limit maximum number of active calls. A value of 0 or less resets the limit
+ * to \ref defaultCallLimit().
+ */
+void GCF::IpcCall::setCallLimit(const QHostAddress &addr, quint16 port, int limit)
+{
+    GCF::IpcCallAdmission *admission = ::IpcCallAdmissions();
+    QMutexLocker locker(&admission->mutex);
+
+    GCF::IpcCallAdmission::Destination &dest
+            = admission->destinations[GCF::IpcCallDestination(addr, port)];
+    dest.limit = qMax(0, limit);
+    admission->admitQueuedCalls(dest);
+}
+
+/**
+ * @return maximum number of calls that can be active on the destination at any
+ * point of time.
+ */
+int GCF::IpcCall::callLimit(const QHostAddress &addr, quint16 port)
+{
+    GCF::IpcCallAdmission *admission = ::IpcCallAdmissions();
+    QMutexLocker locker(&admission->mutex);
+
+    const QString key = GCF::IpcCallDestination(addr, port);
+    if(admission->destinations.contains(key))
+        return admission->limit(admission->destinations[key]);
+
+    return admission->defaultLimit;
+}
+
+/**
+ * Sets the limit on active calls for destinations that have no limit of their own.
+ * If no default limit is set, then a default value of 20 is used.
+ *
+ * @param limit maximum number of active calls. Values less than 1 are ignored.
+ */
+void GCF::IpcCall::setDefaultCallLimit(int limit)
+{
+    if(limit < 1)
+        return;
+
+    GCF::IpcCallAdmission *admission = ::IpcCallAdmissions();
+    QMutexLocker locker(&admission->mutex);
+
+    admission->defaultLimit = limit;
+
+    QMap<QString,GCF::IpcCallAdmission::Destination>::iterator it = admission->destinations.begin();
+    QMap<QString,GCF::IpcCallAdmission::Destination>::iterator end = admission->destinations.end();
+    for(; it != end; ++it)
+        admission->admitQueuedCalls(it.value());
+}
+
+/**
+ * @return the limit on active calls for destinations that have no limit of their own.
+ */
+int GCF::IpcCall::defaultCallLimit()
+{
+    GCF::IpcCallAdmission *admission = ::IpcCallAdmissions();
+    QMutexLocker locker(&admission->mutex);
+    return admission->defaultLimit;
+}
+
+/**
+ * @return a map of metrics about calls made to the destination. The map contains
+ * the following keys
+ *
+ * \li \c callLimit - maximum number of active calls, see \ref callLimit()
+ * \li \c activeCalls - number of calls that are active right now
+ * \li \c queuedCalls - number of calls waiting for admission right now
+ * \li \c maxQueuedCalls - largest number of calls that were waiting at any point of time
+ * \li \c admittedCalls - total number of calls admitted so far
+ * \li \c totalWaitTime - sum of the time (in milliseconds) that admitted calls waited for
+ * \li \c averageWaitTime - average time (in milliseconds) that admitted calls waited for
+ * \li \c maxWaitTime - longest time (in milliseconds) that any admitted call waited for
+ */
+QVariantMap GCF::IpcCall::callMetrics(const QHostAddress &addr, quint16 port)
+{
+    GCF::IpcCallAdmission *admission = ::IpcCallAdmissions();
+    QMutexLocker locker(&admission->mutex);
+
+    const GCF::IpcCallAdmission::Destination dest
+            = admission->destinations.value(GCF::IpcCallDestination(addr, port));
+
+    QVariantMap retMap;
+    retMap["callLimit"] = admission->limit(dest);
+    retMap["activeCalls"] = dest.activeCalls;
+    retMap["queuedCalls"] = dest.queue.count();
+    retMap["maxQueuedCalls"] = dest.maxQueuedCalls;
+    retMap["admittedCalls"] = dest.admittedCalls;
+    retMap["totalWaitTime"] = dest.totalWaitTime;
+    retMap["averageWaitTime"] = dest.admittedCalls ? double(dest.totalWaitTime)/double(dest.admittedCalls) : 0.0;
+    retMap["maxWaitTime"] = dest.maxWaitTime;
+    return retMap;
+}
+
 /**
  * Blocks until the \ref done() signal is emitted or timeout
  * @return true if the call was successful, false otherwise.
@@ -273,15 +572,23 @@ void GCF::IpcCall::emitDone(bool success, const QString &msg)
     if(d->done)
         return;
 
-    d->CallSemaphore.release();
+    ::IpcCallAdmissions()->release(d);
+
+    delete d->timeoutTimer;
+    d->timeoutTimer = nullptr;
+
+    if(d->connection)
+    {
+        GCF::IpcCallConnection *connection = d->connection;
+        d->connection = nullptr;
+        connection->detach(this);
+    }
 
     d->done = true;
     d->success = success;
     d->errorMessage = msg;
 
-    if(d->success)
-        GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, "Success!");
-    else
+    if(!d->success)
         GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT,
                                    QString("Call failed: %1").arg(d->errorMessage));
 
@@ -306,26 +613,9 @@ int GCF::IpcCall::timeoutDuration() const
 
 void GCF::IpcCall::onCall()
 {
-    if(d->socket) // The call is already underway.
+    if(d->connection || d->done) // The call is already underway.
         return;
 
-    /*
-     We are going to limit the number of active IpcCalls at a given point of time.
-     This is dont to ensure that we dont overload the system and go beyond the
-     pipe/socket limit.
-     */
-    if(!d->CallSemaphore.tryAcquire())
-    {
-        QTimer::singleShot(100, this, SLOT(onCall()));
-        return;
-    }
-
-    GCF::LogMessageBranch branch( QString("Calling %1::%2 with %3 args on %4:%5")
-                                  .arg(d->object).arg(d->method)
-                                  .arg(d->arguments.count())
-                                  .arg(d->address.toString())
-                                  .arg(d->port));
-
     if(d->address.isNull())
     {
         emitDone(false, tr("Invalid host address"));
@@ -344,14 +634,31 @@ void GCF::IpcCall::onCall()
         return;
     }
 
-    d->socket = new QTcpSocket(this);
-    connect(d->socket, SIGNAL(connected()), this, SLOT(onConnected()));
-    d->socket->connectToHost(d->address, d->port);
+    /*
+     We are going to limit the number of active IpcCalls to a destination at a given
+     point of time. This is done to ensure that we dont overload the remote application.
+     If the call cannot be admitted right away, onAdmitted() is invoked when it is.
+     */
+    if(!::IpcCallAdmissions()->admit(this, d))
+        return;
+
+    this->onAdmitted();
+}
+
+void GCF::IpcCall::onAdmitted()
+{
+    if(d->connection || d->done)
+        return;
 
     d->timeoutTimer = new QTimer(this);
     connect(d->timeoutTimer, SIGNAL(timeout()), this, SLOT(onConnectTimeout()));
     d->timeoutTimer->setInterval(this->timeoutDuration());
     d->timeoutTimer->start();
+
+    // If the pooled connection is already open, onConnected() is called
+    // right away. Otherwise it is called once the connection is established.
+    d->connection = GCF::IpcCallConnection::get(d->address, d->port);
+    d->connection->attach(this);
 }
 
 void GCF::IpcCall::onConnected()
@@ -359,35 +666,19 @@ void GCF::IpcCall::onConnected()
     delete d->timeoutTimer;
     d->timeoutTimer = nullptr;
 
-    disconnect(d->socket, SIGNAL(connected()), this, SLOT(onConnected()));
-    connect(d->socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
-    connect(d->socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
-    connect(d->socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
-
     GCF::IpcMessage message(GCF::IpcMessage::IPC_CALL);
     message.data()["object"] = d->object;
     message.data()["method"] = d->method;
     message.data()["arguments"] = d->arguments;
-
-    QByteArray packet;
-    QDataStream ds(&packet, QIODevice::WriteOnly);
-    ds << message.toByteArray();
-
-    QString msg = QString("Sending message-id %1 of type %2 int %3 bytes to %4:%5")
-            .arg(message.id())
-            .arg(QString::fromLatin1(message.type()))
-            .arg(packet.size()-int(sizeof(qint32)))
-            .arg(d->socket->peerAddress().toString())
-            .arg(d->socket->peerPort());
-    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, msg);
+    message.data()["keepAlive"] = true;
     d->messageId = message.id();
 
-    d->socket->write(packet);
-
     d->timeoutTimer = new QTimer(this);
     connect(d->timeoutTimer, SIGNAL(timeout()), this, SLOT(onCallTimeout()));
     d->timeoutTimer->setInterval(this->timeoutDuration());
     d->timeoutTimer->start();
+
+    d->connection->sendCall(this, message);
 }
 
 void GCF::IpcCall::onReadyRead()
@@ -408,63 +699,36 @@ void GCF::IpcCall::onBytesWritten()
     }
 }
 
-void GCF::IpcCall::onDisconnected()
+void GCF::IpcCall::onResponse(const GCF::IpcMessage &message)
 {
-    if(d->socket->bytesAvailable())
+    if(message.type() == GCF::IpcMessage::IPC_CALL)
     {
-        QDataStream ds(d->socket);
-        quint32 size = 0;
-        ds >> size;
-
-        GCF::IpcMessage message;
-        if(d->socket->bytesAvailable() >= qint64(size))
-            message = GCF::IpcMessage::fromByteArray(d->socket->read(qint64(size)));
-
-        QString msg = QString("Processing incoming message-id %1 of type %2 from %3 bytes from %4:%5")
-                .arg(message.id())
-                .arg(QString::fromLatin1(message.type()))
-                .arg(size)
-                .arg(d->socket->peerAddress().toString())
-                .arg(d->socket->peerPort());
-        GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, msg);
-
-        if(message.type() == GCF::IpcMessage::IPC_CALL && message.isResponse())
-        {
-            d->success = message.result().isSuccess();
-            d->errorMessage = message.result().message();
-            d->result = message.result().data();
-            d->done = true;
-            d->CallSemaphore.release();
-            emit done(d->success);
-            if(d->autoDelete)
-                this->deleteLater();
-        }
-        else
-        {
-            // This never happens. We cannot write a test case to
-            // validate the emission of this error message.
-            emitDone(false, tr("Invalid response sent by the server"));
-        }
+        d->result = message.result().data();
+        emitDone(message.result().isSuccess(), message.result().message());
     }
     else
-        emitDone(false, tr("The connection was cut before any response could be received"));
+    {
+        // This never happens. We cannot write a test case to
+        // validate the emission of this error message.
+        emitDone(false, tr("Invalid response sent by the server"));
+    }
+}
+
+void GCF::IpcCall::onConnectionLost()
+{
+    d->connection = nullptr;
+    emitDone(false, tr("The connection was cut before any response could be received"));
 }
 
 void GCF::IpcCall::onConnectTimeout()
 {
-    d->timeoutTimer->deleteLater();
-    d->timeoutTimer = nullptr;
-    disconnect(d->socket, SIGNAL(connected()), this, SLOT(onConnected()));
-    d->socket->abort();
     emitDone(false, tr("A connection timeout occured"));
 }
 
 void GCF::IpcCall::onCallTimeout()
 {
-    d->timeoutTimer->deleteLater();
-    d->timeoutTimer = nullptr;
-    disconnect(d->socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
-    d->socket->abort();
+    // The connection is shared with other calls, so we only stop waiting
+    // for the response. If it arrives later, it will simply be ignored.
     emitDone(false, tr("A call timeout occured"));
 }
 
@@ -472,3 +736,200 @@ int GCF::IpcCall::messageId() const
 {
     return d->messageId;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+
+GCF::IpcCallConnection *GCF::IpcCallConnection::get(const QHostAddress &addr, quint16 port)
+{
+    QThreadStorage<GCF::IpcCallConnectionPool*> *pools = ::IpcCallConnectionPools();
+    if(!pools->hasLocalData())
+        pools->setLocalData(new GCF::IpcCallConnectionPool);
+
+    GCF::IpcCallConnectionPool *pool = pools->localData();
+    const QString key = GCF::IpcCallDestination(addr, port);
+
+    GCF::IpcCallConnection *connection = pool->connections.value(key);
+    if(!connection)
+    {
+        connection = new GCF::IpcCallConnection(addr, port);
+        pool->connections[key] = connection;
+    }
+
+    return connection;
+}
+
+GCF::IpcCallConnection::IpcCallConnection(const QHostAddress &addr, quint16 port)
+    : QObject(nullptr), m_address(addr), m_port(port), m_retired(false)
+{
+    m_socket = new GCF::IpcSocket(this);
+    connect(m_socket, SIGNAL(connected()), this, SLOT(onConnected()));
+    connect(m_socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    connect(m_socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError()));
+    connect(m_socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect(m_socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+    connect(m_socket, SIGNAL(incomingMessage(GCF::IpcMessage)),
+            this, SLOT(onIncomingMessage(GCF::IpcMessage)));
+
+    m_idleTimer.setSingleShot(true);
+    connect(&m_idleTimer, SIGNAL(timeout()), this, SLOT(onIdleTimeout()));
+
+    m_socket->connectToHost(m_address, m_port);
+}
+
+GCF::IpcCallConnection::~IpcCallConnection()
+{
+    // Calls still waiting for the connection will report a connection timeout
+    // on their own. Calls that have been sent will never get a response.
+    m_waitingCalls.clear();
+
+    QList<GCF::IpcCall*> calls = m_pendingCalls.values();
+    m_pendingCalls.clear();
+    Q_FOREACH(GCF::IpcCall *call, calls)
+        call->onConnectionLost();
+}
+
+bool GCF::IpcCallConnection::isConnected() const
+{
+    return !m_retired && m_socket->state() == QAbstractSocket::ConnectedState;
+}
+
+void GCF::IpcCallConnection::attach(GCF::IpcCall *call)
+{
+    if(!call)
+        return;
+
+    m_idleTimer.stop();
+
+    if(this->isConnected())
+        call->onConnected();
+    else if(!m_waitingCalls.contains(call))
+        m_waitingCalls.append(call);
+}
+
+void GCF::IpcCallConnection::detach(GCF::IpcCall *call)
+{
+    m_waitingCalls.removeAll(call);
+
+    const qint32 messageId = call->messageId();
+    if(m_pendingCalls.value(messageId) == call)
+        m_pendingCalls.remove(messageId);
+
+    this->updateIdleTimer();
+}
+
+void GCF::IpcCallConnection::sendCall(GCF::IpcCall *call, const GCF::IpcMessage &message)
+{
+    m_pendingCalls[message.id()] = call;
+    m_socket->sendMessage(message);
+}
+
+void GCF::IpcCallConnection::retire()
+{
+    if(m_retired)
+        return;
+
+    m_retired = true;
+    m_idleTimer.stop();
+
+    // New calls must not be handed this connection anymore.
+    QThreadStorage<GCF::IpcCallConnectionPool*> *pools = ::IpcCallConnectionPools();
+    if(pools->hasLocalData())
+    {
+        const QString key = GCF::IpcCallDestination(m_address, m_port);
+        GCF::IpcCallConnectionPool *pool = pools->localData();
+        if(pool->connections.value(key) == this)
+            pool->connections.remove(key);
+    }
+
+    this->deleteLater();
+}
+
+void GCF::IpcCallConnection::updateIdleTimer()
+{
+    if(m_retired)
+        return;
+
+    const bool idle = m_waitingCalls.isEmpty() && m_pendingCalls.isEmpty();
+    if(!idle)
+    {
+        m_idleTimer.stop();
+        return;
+    }
+
+    if(this->isConnected())
+    {
+        m_idleTimer.setInterval(GCF::IpcCall::keepAliveDuration());
+        m_idleTimer.start();
+        return;
+    }
+
+    // Nobody is waiting for a connection that is yet to be established.
+    this->retire();
+    m_socket->abort();
+}
+
+void GCF::IpcCallConnection::onConnected()
+{
+    QList<GCF::IpcCall*> calls = m_waitingCalls;
+    m_waitingCalls.clear();
+    Q_FOREACH(GCF::IpcCall *call, calls)
+        call->onConnected();
+
+    this->updateIdleTimer();
+}
+
+void GCF::IpcCallConnection::onDisconnected()
+{
+    // Responses that came in just before the connection was cut
+    // should still be delivered.
+    m_socket->processPendingMessages();
+
+    QList<GCF::IpcCall*> calls = m_pendingCalls.values();
+    m_pendingCalls.clear();
+    Q_FOREACH(GCF::IpcCall *call, calls)
+        call->onConnectionLost();
+
+    this->retire();
+}
+
+void GCF::IpcCallConnection::onError()
+{
+    // Errors on an established connection are followed by disconnected().
+    // If the connection could not be established, then calls waiting on it
+    // will report a connection timeout.
+    if(m_pendingCalls.isEmpty())
+        this->retire();
+}
+
+void GCF::IpcCallConnection::onReadyRead()
+{
+    QList<GCF::IpcCall*> calls = m_pendingCalls.values();
+    Q_FOREACH(GCF::IpcCall *call, calls)
+        call->onReadyRead();
+}
+
+void GCF::IpcCallConnection::onBytesWritten()
+{
+    QList<GCF::IpcCall*> calls = m_pendingCalls.values();
+    Q_FOREACH(GCF::IpcCall *call, calls)
+        call->onBytesWritten();
+}
+
+void GCF::IpcCallConnection::onIncomingMessage(const GCF::IpcMessage &message)
+{
+    if(!message.isResponse())
+        return;
+
+    // Responses to calls that have timed out or were deleted are ignored.
+    GCF::IpcCall *call = m_pendingCalls.take(message.id());
+    if(call)
+        call->onResponse(message);
+
+    this->updateIdleTimer();
+}
+
+void GCF::IpcCallConnection::onIdleTimeout()
+{
+    this->retire();
+    m_socket->disconnectFromHost();
+}
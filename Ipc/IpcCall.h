@@ -22,10 +22,14 @@
 #include "IpcCommon.h"
 #include <QHostAddress>
 #include <QVariantList>
+#include <QVariantMap>
 
 namespace GCF
 {
 
+class IpcMessage;
+class IpcCallConnection;
+
 struct IpcCallData;
 class GCF_IPC_EXPORT IpcCall : public QObject
 {
@@ -58,19 +62,32 @@ public:
     void setAutoDelete(bool val);
     bool isAutoDelete() const;
 
+    int queueWaitTime() const;
+
+    static void setKeepAliveDuration(int msecs);
+    static int keepAliveDuration();
+
+    static void setCallLimit(const QHostAddress &addr, quint16 port, int limit);
+    static int callLimit(const QHostAddress &addr, quint16 port);
+    static void setDefaultCallLimit(int limit);
+    static int defaultCallLimit();
+    static QVariantMap callMetrics(const QHostAddress &addr, quint16 port);
+
 signals:
     virtual void done(bool success);
 
 private:
     void emitDone(bool success, const QString &msg);
     int timeoutDuration() const;
+    void onResponse(const GCF::IpcMessage &message);
+    void onConnectionLost();
 
 private slots:
     void onCall();
+    void onAdmitted();
     void onConnected();
     void onReadyRead();
     void onBytesWritten();
-    void onDisconnected();
     void onConnectTimeout();
     void onCallTimeout();
 
@@ -78,6 +95,7 @@ protected:
     int messageId() const;
 
 private:
+    friend class IpcCallConnection;
     IpcCallData *d;
 };
 
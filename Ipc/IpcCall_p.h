@@ -0,0 +1,82 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef IPCCALL_P_H
+#define IPCCALL_P_H
+
+#include "IpcCommon_p.h"
+
+#include <QMap>
+#include <QList>
+#include <QTimer>
+#include <QHostAddress>
+
+namespace GCF
+{
+
+class IpcCall;
+
+/*
+ * Keeps one socket connection open to a (address, port) pair and multiplexes
+ * all IpcCall requests made to it from one thread. Responses are matched to
+ * calls by message-id as soon as they arrive. Instances are pooled per thread
+ * and are fetched using IpcCallConnection::get().
+ */
+class IpcCallConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    static IpcCallConnection *get(const QHostAddress &addr, quint16 port);
+    ~IpcCallConnection();
+
+    QHostAddress address() const { return m_address; }
+    quint16 port() const { return m_port; }
+    bool isConnected() const;
+
+    void attach(GCF::IpcCall *call);
+    void detach(GCF::IpcCall *call);
+    void sendCall(GCF::IpcCall *call, const GCF::IpcMessage &message);
+
+private:
+    IpcCallConnection(const QHostAddress &addr, quint16 port);
+    void retire();
+    void updateIdleTimer();
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onError();
+    void onReadyRead();
+    void onBytesWritten();
+    void onIncomingMessage(const GCF::IpcMessage &message);
+    void onIdleTimeout();
+
+private:
+    QHostAddress m_address;
+    quint16 m_port;
+    bool m_retired;
+    GCF::IpcSocket *m_socket;
+    QTimer m_idleTimer;
+    QList<GCF::IpcCall*> m_waitingCalls;
+    QMap<qint32, GCF::IpcCall*> m_pendingCalls;
+};
+
+}
+
+#endif // IPCCALL_P_H
@@ -36,5 +36,30 @@
 #define GCF_IPC_VERSION_MINOR GCF_VERSION_MINOR
 #define GCF_IPC_VERSION_REVISION GCF_VERSION_REVISION
 
+namespace GCF
+{
+
+enum IpcWireFormat
+{
+    IpcLegacyWireFormat = 1,
+    IpcCompactWireFormat = 2
+};
+
+GCF_IPC_EXPORT void setIpcWireFormat(IpcWireFormat format);
+GCF_IPC_EXPORT IpcWireFormat ipcWireFormat();
+
+enum IpcTransport
+{
+    IpcTcpTransport = 0x01,
+    IpcLocalTransport = 0x02,
+    IpcSharedMemoryTransport = 0x04,
+    IpcAllTransports = IpcTcpTransport|IpcLocalTransport|IpcSharedMemoryTransport
+};
+
+GCF_IPC_EXPORT void setIpcTransports(int transports);
+GCF_IPC_EXPORT int ipcTransports();
+
+}
+
 #endif // IPCCOMMON_H
 
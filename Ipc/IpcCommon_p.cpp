@@ -17,10 +17,18 @@
 ****************************************************************************/
 
 #include "IpcCommon_p.h"
+#include "IpcTrace.h"
 #include "../Core/Log.h"
 #include "../Core/Application.h"
 
 #include <QHostAddress>
+#include <QAtomicInt>
+#include <QtEndian>
+#include <QDateTime>
+#include <QMutex>
+#include <QCoreApplication>
+
+#include <cstring>
 
 /*
  * Additional UUIDs can be used from the list below and then further generated if needed
@@ -76,8 +84,13 @@ GCF::IpcMessage GCF::IpcMessage::fromByteArray(const QByteArray &bytes)
 QByteArray GCF::IpcMessage::toByteArray(const IpcMessage &message)
 {
     QByteArray bytes;
-
     QDataStream ds(&bytes, QIODevice::WriteOnly);
+    write(ds, message);
+    return bytes;
+}
+
+void GCF::IpcMessage::write(QDataStream &ds, const IpcMessage &message)
+{
     ds << message.id();
     ds << message.type();
     ds << message.isResponse();
@@ -86,81 +99,1052 @@ QByteArray GCF::IpcMessage::toByteArray(const IpcMessage &message)
     ds << message.result().code();
     ds << message.result().message();
     ds << message.result().data();
+}
+
+/*
+ * Compact wire format (version 2)
+ *
+ * marker  : 1 byte, always IpcMessage::CompactFormatMarker. Legacy messages begin with
+ *           the big-endian message-id. Its first byte equals the marker only for
+ *           negative ids, which are used once the id counter wraps around; a legacy
+ *           peer sending such a message is misread.
+ * opcode  : 1 byte. Bits 0-6 identify the message type (0 means that the 36 byte
+ *           type string follows). Bit 7 is set for responses. Opcodes 0x7E and 0x7F
+ *           are reserved for the shared memory control frames of IpcSocket.
+ * id      : varint
+ * data    : varint count, followed by count (key, value) pairs. Well known keys
+ *           are sent as a 1 byte code; others as code 0 followed by the key string.
+ *           Values are tagged; string values of object, method, property and
+ *           signal names are interned using IpcWireDictionary.
+ * result  : 1 byte flags (success, has-code, has-message, has-data) followed by
+ *           the parts that are present.
+ *
+ * Strings are sent as a varint length followed by UTF-8 bytes. Varints are
+ * unsigned LEB128.
+ */
+
+namespace GCF
+{
+
+enum IpcWireValueTag
+{
+    IpcWireVariant = 0,
+    IpcWireInternedIndex = 1,
+    IpcWireInternedString = 2,
+    IpcWireString = 3
+};
+
+enum IpcWireResultFlag
+{
+    IpcWireResultSuccess = 0x01,
+    IpcWireResultCode = 0x02,
+    IpcWireResultMessage = 0x04,
+    IpcWireResultData = 0x08
+};
+
+static const char *IpcWireKeys[] = {
+    nullptr, "object", "method", "arguments", "propertyName", "propertyValue",
+    "signal", "properties", "signals", "members", "keepAlive"
+};
+static const int IpcWireKeyCount = int(sizeof(IpcWireKeys)/sizeof(IpcWireKeys[0]));
+
+static int ipcWireKeyCode(const QString &key)
+{
+    for(int i=1; i<IpcWireKeyCount; i++)
+        if(key == QLatin1String(IpcWireKeys[i]))
+            return i;
+    return 0;
+}
+
+static bool ipcWireIsInternedKey(int keyCode)
+{
+    // object, method, propertyName and signal
+    return keyCode == 1 || keyCode == 2 || keyCode == 4 || keyCode == 6;
+}
+
+static int ipcWireOpcode(const QByteArray &type)
+{
+    if(type == GCF::IpcMessage::REQUEST_OBJECT) return 1;
+    if(type == GCF::IpcMessage::GET_PROPERTY_VALUE) return 2;
+    if(type == GCF::IpcMessage::SET_PROPERTY_VALUE) return 3;
+    if(type == GCF::IpcMessage::REQUEST_CONNECTION) return 4;
+    if(type == GCF::IpcMessage::SIGNAL_DELIVERY) return 5;
+    if(type == GCF::IpcMessage::IPC_CALL) return 6;
+    return 0;
+}
+
+static QByteArray ipcWireType(int opcode)
+{
+    switch(opcode)
+    {
+    case 1: return GCF::IpcMessage::REQUEST_OBJECT;
+    case 2: return GCF::IpcMessage::GET_PROPERTY_VALUE;
+    case 3: return GCF::IpcMessage::SET_PROPERTY_VALUE;
+    case 4: return GCF::IpcMessage::REQUEST_CONNECTION;
+    case 5: return GCF::IpcMessage::SIGNAL_DELIVERY;
+    case 6: return GCF::IpcMessage::IPC_CALL;
+    default: break;
+    }
+    return QByteArray();
+}
+
+static void ipcWriteVarint(QDataStream &ds, quint32 value)
+{
+    char bytes[5];
+    int count = 0;
+    do
+    {
+        uchar byte = uchar(value & 0x7F);
+        value >>= 7;
+        if(value)
+            byte |= 0x80;
+        bytes[count++] = char(byte);
+    }
+    while(value);
+
+    ds.writeRawData(bytes, count);
+}
+
+static bool ipcReadVarint(QDataStream &ds, quint32 *value)
+{
+    quint32 result = 0;
+    for(int shift=0; shift<35; shift += 7)
+    {
+        char byte = 0;
+        if(ds.readRawData(&byte, 1) != 1)
+            return false;
+
+        result |= quint32(uchar(byte) & 0x7F) << shift;
+        if( !(uchar(byte) & 0x80) )
+        {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void ipcWriteString(QDataStream &ds, const QString &string)
+{
+    const QByteArray utf8 = string.toUtf8();
+    ipcWriteVarint(ds, quint32(utf8.size()));
+    ds.writeRawData(utf8.constData(), utf8.size());
+}
+
+static bool ipcReadString(QDataStream &ds, QString *string)
+{
+    quint32 size = 0;
+    if(!ipcReadVarint(ds, &size) || qint64(size) > ds.device()->bytesAvailable())
+        return false;
+
+    QByteArray utf8(int(size), Qt::Uninitialized);
+    if(ds.readRawData(utf8.data(), int(size)) != int(size))
+        return false;
+
+    *string = QString::fromUtf8(utf8.constData(), utf8.size());
+    return true;
+}
+
+}
+
+GCF::IpcMessage GCF::IpcMessage::fromCompactByteArray(const QByteArray &bytes,
+                                                      IpcWireDictionary *dictionary)
+{
+    GCF::IpcMessage message;
+    if(!isCompactByteArray(bytes))
+        return message;
+
+    QDataStream ds(bytes);
+    quint8 marker = 0, opcode = 0;
+    ds >> marker >> opcode;
+
+    QByteArray type;
+    if( (opcode & 0x7F) == 0 )
+        ds >> type;
+    else if( (type = GCF::ipcWireType(opcode & 0x7F)).isEmpty() )
+        return GCF::IpcMessage(); // Opcode from a newer version of the format
 
+    quint32 id = 0, count = 0;
+    if(!GCF::ipcReadVarint(ds, &id) || !GCF::ipcReadVarint(ds, &count))
+        return GCF::IpcMessage();
+
+    QVariantMap data;
+    for(quint32 i=0; i<count; i++)
+    {
+        quint8 keyCode = 0, tag = 0;
+        ds >> keyCode;
+
+        QString key;
+        if(keyCode > 0 && keyCode < GCF::IpcWireKeyCount)
+            key = QString::fromLatin1(GCF::IpcWireKeys[keyCode]);
+        else if(!GCF::ipcReadString(ds, &key))
+            return GCF::IpcMessage();
+
+        ds >> tag;
+        switch(tag)
+        {
+        case GCF::IpcWireVariant: {
+            QVariant value;
+            ds >> value;
+            data[key] = value;
+            } break;
+        case GCF::IpcWireInternedIndex: {
+            quint32 index = 0;
+            if(!dictionary || !GCF::ipcReadVarint(ds, &index) || int(index) >= dictionary->count())
+                return GCF::IpcMessage();
+            data[key] = dictionary->at(int(index));
+            } break;
+        case GCF::IpcWireInternedString:
+        case GCF::IpcWireString: {
+            QString value;
+            if(!GCF::ipcReadString(ds, &value))
+                return GCF::IpcMessage();
+            if(tag == GCF::IpcWireInternedString && dictionary)
+                dictionary->add(value);
+            data[key] = value;
+            } break;
+        default:
+            return GCF::IpcMessage();
+        }
+
+        if(ds.status() != QDataStream::Ok)
+            return GCF::IpcMessage();
+    }
+
+    quint8 flags = 0;
+    ds >> flags;
+
+    QString code, error;
+    QVariant result;
+    if( (flags & GCF::IpcWireResultCode) && !GCF::ipcReadString(ds, &code) )
+        return GCF::IpcMessage();
+    if( (flags & GCF::IpcWireResultMessage) && !GCF::ipcReadString(ds, &error) )
+        return GCF::IpcMessage();
+    if(flags & GCF::IpcWireResultData)
+        ds >> result;
+
+    if(ds.status() != QDataStream::Ok)
+        return GCF::IpcMessage();
+
+    message.m_id = qint32(id);
+    message.m_type = type;
+    message.m_isResponse = (opcode & 0x80) != 0;
+    message.m_data = data;
+    message.setResult( GCF::Result((flags & GCF::IpcWireResultSuccess) != 0, code, error, result) );
+    return message;
+}
+
+QByteArray GCF::IpcMessage::toCompactByteArray(const IpcMessage &message,
+                                               IpcWireDictionary *dictionary)
+{
+    QByteArray bytes;
+    QDataStream ds(&bytes, QIODevice::WriteOnly);
+    writeCompact(ds, message, dictionary);
     return bytes;
 }
 
+void GCF::IpcMessage::writeCompact(QDataStream &ds, const IpcMessage &message,
+                                   IpcWireDictionary *dictionary)
+{
+    const int opcode = GCF::ipcWireOpcode(message.type());
+    ds << quint8(CompactFormatMarker);
+    ds << quint8(opcode | (message.isResponse() ? 0x80 : 0x00));
+    if(opcode == 0)
+        ds << message.type();
+
+    GCF::ipcWriteVarint(ds, quint32(message.id()));
+    GCF::ipcWriteVarint(ds, quint32(message.data().count()));
+
+    QVariantMap::const_iterator it = message.data().constBegin();
+    QVariantMap::const_iterator end = message.data().constEnd();
+    for(; it != end; ++it)
+    {
+        const int keyCode = GCF::ipcWireKeyCode(it.key());
+        ds << quint8(keyCode);
+        if(keyCode == 0)
+            GCF::ipcWriteString(ds, it.key());
+
+        if(GCF::ipcWireIsInternedKey(keyCode) && it.value().type() == QVariant::String)
+        {
+            const QString value = it.value().toString();
+            const int index = dictionary ? dictionary->indexOf(value) : -1;
+            if(index >= 0)
+            {
+                ds << quint8(GCF::IpcWireInternedIndex);
+                GCF::ipcWriteVarint(ds, quint32(index));
+            }
+            else if(dictionary && dictionary->add(value))
+            {
+                ds << quint8(GCF::IpcWireInternedString);
+                GCF::ipcWriteString(ds, value);
+            }
+            else
+            {
+                ds << quint8(GCF::IpcWireString);
+                GCF::ipcWriteString(ds, value);
+            }
+        }
+        else
+            ds << quint8(GCF::IpcWireVariant) << it.value();
+    }
+
+    const GCF::Result &result = message.m_result;
+    quint8 flags = 0;
+    if(result.isSuccess())
+        flags |= GCF::IpcWireResultSuccess;
+    if(!result.code().isEmpty())
+        flags |= GCF::IpcWireResultCode;
+    if(!result.message().isEmpty())
+        flags |= GCF::IpcWireResultMessage;
+    if(result.data().isValid())
+        flags |= GCF::IpcWireResultData;
+
+    ds << flags;
+    if(flags & GCF::IpcWireResultCode)
+        GCF::ipcWriteString(ds, result.code());
+    if(flags & GCF::IpcWireResultMessage)
+        GCF::ipcWriteString(ds, result.message());
+    if(flags & GCF::IpcWireResultData)
+        ds << result.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static QAtomicInt IpcPreferredWireFormat(GCF::IpcCompactWireFormat);
+
+/**
+\ingroup gcf_ipc
+
+Sets the wire format that IPC connections made by this application should use.
+By default \c GCF::IpcCompactWireFormat is used, but only with peers that support
+it. Peers advertise support for the compact format while exchanging their first
+message; with older peers the legacy format is used. Set \c GCF::IpcLegacyWireFormat
+to always use the legacy format.
+
+\note the setting applies to connections that are made after this function is called.
+*/
+void GCF::setIpcWireFormat(GCF::IpcWireFormat format)
+{
+    ::IpcPreferredWireFormat.fetchAndStoreOrdered(int(format));
+}
+
+/**
+\ingroup gcf_ipc
+
+\return the wire format that IPC connections made by this application would use,
+if the peer supports it.
+*/
+GCF::IpcWireFormat GCF::ipcWireFormat()
+{
+    return GCF::IpcWireFormat(::IpcPreferredWireFormat.loadAcquire());
+}
+
+static QAtomicInt IpcEnabledTransports(GCF::IpcAllTransports);
+
+/**
+\ingroup gcf_ipc
+
+Sets the transports that IPC connections made by, and to, this application may use.
+\c transports is a combination of \c GCF::IpcTransport values. By default all
+transports are enabled.
+
+\li \c GCF::IpcTcpTransport is always used for peers on other hosts. It cannot be
+disabled.
+\li \c GCF::IpcLocalTransport makes \ref GCF::IpcServer also listen on a local socket
+(named pipe on Windows), and connections to servers on this host go through it.
+\li \c GCF::IpcSharedMemoryTransport makes large messages exchanged over local sockets
+go through a shared memory segment.
+
+\note \ref GCF::IpcServer instances that are already listening are not affected.
+*/
+void GCF::setIpcTransports(int transports)
+{
+    ::IpcEnabledTransports.fetchAndStoreOrdered(transports | GCF::IpcTcpTransport);
+}
+
+/**
+\ingroup gcf_ipc
+
+\return transports that IPC connections made by, and to, this application may use.
+*/
+int GCF::ipcTransports()
+{
+    return ::IpcEnabledTransports.loadAcquire();
+}
+
+QString GCF::ipcLocalServerName(const QHostAddress &addr, quint16 port)
+{
+    // Only one server per address family can listen on a TCP port of this host.
+    // So the family and port are good enough to identify the server's local socket.
+    if(addr.protocol() == QAbstractSocket::IPv6Protocol)
+        return QString("GCF3Ipc6-%1").arg(port);
+    return QString("GCF3Ipc-%1").arg(port);
+}
+
+namespace GCF
+{
+
+struct IpcPeerTransportRegistry
+{
+    QMutex mutex;
+    QHash<QString, int> transports;
+
+    static QString key(const QHostAddress &addr, quint16 port) {
+        return QString("%1:%2").arg(addr.toString()).arg(port);
+    }
+};
+
+}
+
+Q_GLOBAL_STATIC(GCF::IpcPeerTransportRegistry, IpcPeerTransports)
+
+/*
+Records the transports supported by the server at \c addr and \c port, for
+instance as advertised by GCF::IpcServerDiscovery. Local transports should
+only be recorded for servers on this host.
+*/
+void GCF::ipcSetPeerTransports(const QHostAddress &addr, quint16 port, int transports)
+{
+    GCF::IpcPeerTransportRegistry *registry = ::IpcPeerTransports();
+    if(!registry)
+        return;
+
+    QMutexLocker locker(&registry->mutex);
+    registry->transports[GCF::IpcPeerTransportRegistry::key(addr, port)] = transports;
+}
+
+/*
+\return transports supported by the server at \c addr and \c port, or 0 if
+they are not known.
+*/
+int GCF::ipcPeerTransports(const QHostAddress &addr, quint16 port)
+{
+    GCF::IpcPeerTransportRegistry *registry = ::IpcPeerTransports();
+    if(!registry)
+        return 0;
+
+    QMutexLocker locker(&registry->mutex);
+    return registry->transports.value(GCF::IpcPeerTransportRegistry::key(addr, port), 0);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 GCF::IpcSocket::IpcSocket(QObject *parent)
-    :QTcpSocket(parent), m_incomingMessageSize(0)
+    :QObject(parent), m_device(nullptr), m_tcpSocket(nullptr),
+     m_localSocket(nullptr), m_port(0), m_localConnected(false),
+     m_incomingMessageSize(0),
+     m_peerWireFormat(GCF::IpcLegacyWireFormat),
+     m_advertised(false), m_peerSharedMemory(false), m_sharedMemoryAdvertised(false),
+     m_sharedMemoryOut(nullptr), m_sharedMemoryIn(nullptr),
+     m_sharedMemoryHead(0), m_sharedMemoryTail(0)
 {
-    connect(this, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
-    connect(this, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
 }
 
 GCF::IpcSocket::~IpcSocket()
 {
 }
 
+/*
+Connects to the IpcServer listening on \c addr and \c port. If the server is
+known to be (or is likely to be) on this host, a local socket is tried first.
+If that does not work out, the connection is made over TCP.
+*/
+void GCF::IpcSocket::connectToHost(const QHostAddress &addr, quint16 port)
+{
+    if(m_device)
+        return;
+
+    m_address = addr;
+    m_port = port;
+
+    bool sameHost = false;
+    const int peerTransports = GCF::ipcPeerTransports(addr, port);
+    if(peerTransports)
+        sameHost = (peerTransports & GCF::IpcLocalTransport) != 0;
+    else
+        sameHost = (addr == QHostAddress(QHostAddress::LocalHost) ||
+                    addr == QHostAddress(QHostAddress::LocalHostIPv6));
+
+    if(sameHost && (GCF::ipcTransports() & GCF::IpcLocalTransport))
+    {
+        m_localSocket = new QLocalSocket(this);
+        this->setDevice(m_localSocket);
+
+        // This may fail right away, in which case onLocalSocketError() will have
+        // switched over to TCP by the time this function returns.
+        m_localSocket->connectToServer(GCF::ipcLocalServerName(addr, port));
+        return;
+    }
+
+    this->connectOverTcp();
+}
+
+#if QT_VERSION >= 0x050000
+bool GCF::IpcSocket::setSocketDescriptor(qintptr handle)
+#else
+bool GCF::IpcSocket::setSocketDescriptor(int handle)
+#endif
+{
+    if(m_device)
+        return false;
+
+    m_tcpSocket = new QTcpSocket(this);
+    this->setDevice(m_tcpSocket);
+    return m_tcpSocket->setSocketDescriptor(handle);
+}
+
+/*
+Makes this socket use an already connected local socket, as returned by
+QLocalServer::nextPendingConnection(). Ownership of \c socket is transferred.
+*/
+void GCF::IpcSocket::setLocalSocket(QLocalSocket *socket)
+{
+    if(m_device || !socket)
+        return;
+
+    socket->setParent(this);
+    m_localSocket = socket;
+    m_localConnected = true;
+    this->setDevice(m_localSocket);
+
+    // Data may have arrived before we started listening for readyRead()
+    if(m_localSocket->bytesAvailable())
+        QMetaObject::invokeMethod(this, "onReadyRead", Qt::QueuedConnection);
+}
+
+int GCF::IpcSocket::transport() const
+{
+    return m_localSocket ? int(GCF::IpcLocalTransport) : int(GCF::IpcTcpTransport);
+}
+
+bool GCF::IpcSocket::isUsingSharedMemory() const
+{
+    return m_localSocket && m_peerSharedMemory &&
+           (GCF::ipcTransports() & GCF::IpcSharedMemoryTransport);
+}
+
+QAbstractSocket::SocketState GCF::IpcSocket::state() const
+{
+    if(m_tcpSocket)
+        return m_tcpSocket->state();
+
+    // QLocalSocket::LocalSocketState values are the same as those of
+    // QAbstractSocket::SocketState
+    if(m_localSocket)
+        return QAbstractSocket::SocketState(int(m_localSocket->state()));
+
+    return QAbstractSocket::UnconnectedState;
+}
+
+QString GCF::IpcSocket::errorString() const
+{
+    return m_device ? m_device->errorString() : QString();
+}
+
+QHostAddress GCF::IpcSocket::peerAddress() const
+{
+    if(m_tcpSocket)
+        return m_tcpSocket->peerAddress();
+
+    if(m_localSocket && m_address.isNull())
+        return QHostAddress(QHostAddress::LocalHost);
+
+    return m_address;
+}
+
+quint16 GCF::IpcSocket::peerPort() const
+{
+    return m_tcpSocket ? m_tcpSocket->peerPort() : m_port;
+}
+
+qint64 GCF::IpcSocket::bytesAvailable() const
+{
+    return m_device ? m_device->bytesAvailable() : 0;
+}
+
+qint64 GCF::IpcSocket::bytesToWrite() const
+{
+    return m_device ? m_device->bytesToWrite() : 0;
+}
+
+bool GCF::IpcSocket::waitForConnected(int msecs)
+{
+    if(m_localSocket && !m_localConnected)
+    {
+        if(m_localSocket->waitForConnected(msecs))
+            return true;
+    }
+
+    if(m_tcpSocket)
+        return m_tcpSocket->waitForConnected(msecs);
+
+    return m_localConnected && m_localSocket;
+}
+
+bool GCF::IpcSocket::waitForBytesWritten(int msecs)
+{
+    return m_device ? m_device->waitForBytesWritten(msecs) : false;
+}
+
+void GCF::IpcSocket::disconnectFromHost()
+{
+    if(m_tcpSocket)
+        m_tcpSocket->disconnectFromHost();
+    else if(m_localSocket)
+        m_localSocket->disconnectFromServer();
+}
+
+void GCF::IpcSocket::abort()
+{
+    if(m_tcpSocket)
+        m_tcpSocket->abort();
+    else if(m_localSocket)
+        m_localSocket->abort();
+}
+
 void GCF::IpcSocket::sendMessage(const GCF::IpcMessage &message)
 {
-    if(this->state() != QTcpSocket::ConnectedState)
+    if(this->state() != QAbstractSocket::ConnectedState)
     {
         emit writeBufferEmpty();
         return;
     }
 
-    QByteArray packet;
-    QDataStream ds(&packet, QIODevice::WriteOnly);
-    ds << message.toByteArray();
+    // The message is serialised straight into the send buffer, after a
+    // placeholder for the length prefix. The prefix is patched in once the
+    // size is known; so the frame is built in a single pass.
+    if(m_sendBuffer.capacity() < InitialBufferSize)
+        m_sendBuffer.reserve(InitialBufferSize);
+    m_sendBuffer.resize(0); // Keeps the reserved capacity, unlike clear()
+
+    const int wireFormat = GCF::ipcWireFormat();
+    const GCF::IpcMessage *outgoing = &message;
+    GCF::IpcMessage advertisement;
+    if(!m_advertised)
+    {
+        // Let the peer know about the wire format and transports that this end
+        // supports. Peers that don't know about these keys simply ignore them.
+        const bool sharedMemory = m_localSocket &&
+                (GCF::ipcTransports() & GCF::IpcSharedMemoryTransport);
+        if(wireFormat >= GCF::IpcCompactWireFormat || sharedMemory)
+        {
+            advertisement = message;
+            if(wireFormat >= GCF::IpcCompactWireFormat)
+                advertisement.data()["wireFormat"] = wireFormat;
+            if(sharedMemory)
+                advertisement.data()["sharedMemory"] = true;
+            outgoing = &advertisement;
+        }
+        m_advertised = true;
+        m_sharedMemoryAdvertised = sharedMemory;
+    }
+
+    {
+        QDataStream ds(&m_sendBuffer, QIODevice::WriteOnly);
+        ds << quint32(0);
+
+        if(wireFormat >= GCF::IpcCompactWireFormat && m_peerWireFormat >= GCF::IpcCompactWireFormat)
+            GCF::IpcMessage::writeCompact(ds, *outgoing, &m_sendDictionary);
+        else
+            GCF::IpcMessage::write(ds, *outgoing);
+    }
+
+    const int packetSize = m_sendBuffer.size();
+    const int messageSize = packetSize - int(sizeof(quint32));
+
+    connect(this, SIGNAL(disconnected()), this, SLOT(deleteLater()), Qt::UniqueConnection);
+
+    // Large messages to a peer on this host are handed over through shared
+    // memory, if there is room for them. Otherwise they are written to the socket.
+    const bool sentThroughSharedMemory = messageSize >= SharedMemoryThreshold &&
+            this->isUsingSharedMemory() &&
+            this->writeToSharedMemory(m_sendBuffer.constData()+sizeof(quint32), messageSize);
+    if(!sentThroughSharedMemory)
+    {
+        qToBigEndian<quint32>(quint32(messageSize), reinterpret_cast<uchar*>(m_sendBuffer.data()));
+        m_device->write(m_sendBuffer.constData(), qint64(packetSize));
+    }
+
+    // Dont hold on to memory used by the occasional large message
+    if(m_sendBuffer.capacity() > MaxRetainedBufferSize)
+        m_sendBuffer = QByteArray();
 
-    connect(this, SIGNAL(disconnected()), this, SLOT(deleteLater()));
-    this->write(packet);
+    if(GCF::IpcTrace::isEnabled())
+        this->trace(GCF::IpcTraceEvent::MessageSent, message, messageSize);
+}
 
-    QString msg = QString("Sending message-id %1 of type %2 int %3 bytes to %4:%5")
-            .arg(message.id())
-            .arg(QString::fromLatin1(message.type()))
-            .arg(packet.size()-int(sizeof(qint32)))
-            .arg(this->peerAddress().toString())
-            .arg(this->peerPort());
-    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, msg);
+/*
+Emits incomingMessage() for every complete message that is already buffered
+in the socket. This is useful for draining the socket before it is let go,
+for instance when the connection was cut right after a response was sent.
+*/
+void GCF::IpcSocket::processPendingMessages()
+{
+    while(this->readMessage());
 }
 
 void GCF::IpcSocket::onReadyRead()
 {
+    // Process all complete messages that have arrived, but only upto a budget
+    // per call. That way a chatty peer cannot starve other sockets and timers
+    // in the event loop.
+    int count = 0;
+    while(count < MaxMessagesPerReadyRead && this->readMessage())
+        ++count;
+
+    if(count == 0)
+        return; // When this slot is called next, maybe the whole message is available!
+
+    if(count == MaxMessagesPerReadyRead && this->bytesAvailable())
+        QMetaObject::invokeMethod(this, "onReadyRead", Qt::QueuedConnection);
+    else if(this->bytesAvailable() == 0)
+        emit readBufferEmpty();
+}
+
+void GCF::IpcSocket::onLocalSocketConnected()
+{
+    m_localConnected = true;
+    emit connected();
+}
+
+void GCF::IpcSocket::onLocalSocketError()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(this->sender());
+    if(!socket || socket != m_localSocket)
+        return;
+
+    if(!m_localConnected && !m_address.isNull())
+    {
+        // The server is not listening on a local socket, or we are not allowed
+        // to connect to it. Remember that and connect over TCP instead.
+        GCF::ipcSetPeerTransports(m_address, m_port, GCF::IpcTcpTransport);
+
+        m_localSocket->disconnect(this);
+        m_localSocket->deleteLater();
+        m_localSocket = nullptr;
+        m_device = nullptr;
+
+        this->connectOverTcp();
+        return;
+    }
+
+    // QLocalSocket::LocalSocketError values are the same as those of
+    // QAbstractSocket::SocketError
+    emit error(QAbstractSocket::SocketError(int(socket->error())));
+}
+
+void GCF::IpcSocket::setDevice(QIODevice *device)
+{
+    m_device = device;
+
+    connect(m_device, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect(m_device, SIGNAL(readyRead()), this, SIGNAL(readyRead()));
+    connect(m_device, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+    connect(m_device, SIGNAL(bytesWritten(qint64)), this, SIGNAL(bytesWritten(qint64)));
+
+    if(m_device == m_tcpSocket)
+    {
+        connect(m_tcpSocket, SIGNAL(connected()), this, SIGNAL(connected()));
+        connect(m_tcpSocket, SIGNAL(disconnected()), this, SIGNAL(disconnected()));
+        connect(m_tcpSocket, SIGNAL(error(QAbstractSocket::SocketError)),
+                this, SIGNAL(error(QAbstractSocket::SocketError)));
+    }
+    else if(m_device == m_localSocket)
+    {
+        connect(m_localSocket, SIGNAL(connected()), this, SLOT(onLocalSocketConnected()));
+        connect(m_localSocket, SIGNAL(disconnected()), this, SIGNAL(disconnected()));
+        connect(m_localSocket, SIGNAL(error(QLocalSocket::LocalSocketError)),
+                this, SLOT(onLocalSocketError()));
+    }
+}
+
+void GCF::IpcSocket::connectOverTcp()
+{
+    m_tcpSocket = new QTcpSocket(this);
+    this->setDevice(m_tcpSocket);
+    m_tcpSocket->connectToHost(m_address, m_port);
+}
+
+bool GCF::IpcSocket::readMessage()
+{
+    if(!m_device)
+        return false;
+
     if(m_incomingMessageSize == 0)
     {
-        QDataStream ds(this);
-        ds >> m_incomingMessageSize;
+        // The length prefix itself may arrive in pieces. Dont consume any
+        // of it until all of it is available.
+        uchar prefix[sizeof(quint32)];
+        if(m_device->peek(reinterpret_cast<char*>(prefix), qint64(sizeof(prefix))) != qint64(sizeof(prefix)))
+            return false;
+
+        const qint32 size = qint32(qFromBigEndian<quint32>(prefix));
+        if(size < 0)
+        {
+            QString msg = QString("Invalid message size %1 received from %2:%3. Closing connection.")
+                    .arg(size)
+                    .arg(this->peerAddress().toString())
+                    .arg(this->peerPort());
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT, msg);
+            this->abort();
+            return false;
+        }
+
+        m_device->read(reinterpret_cast<char*>(prefix), qint64(sizeof(prefix)));
+        m_incomingMessageSize = size;
     }
 
-    if( qint32(this->bytesAvailable()) < m_incomingMessageSize )
-        return; // When this slot is called next, maybe the whole message is available!
+    if( m_device->bytesAvailable() < qint64(m_incomingMessageSize) )
+        return false;
 
-    QByteArray messageBytes = this->read(qint64(m_incomingMessageSize));
-    GCF::IpcMessage message = GCF::IpcMessage::fromByteArray(messageBytes);
+    // Messages are read into a buffer that is reused across messages
+    const int frameSize = int(m_incomingMessageSize);
+    if(m_receiveBuffer.capacity() < InitialBufferSize)
+        m_receiveBuffer.reserve(InitialBufferSize);
+    m_receiveBuffer.resize(frameSize);
+    m_device->read(m_receiveBuffer.data(), qint64(frameSize));
     m_incomingMessageSize = 0;
 
-    QString msg = QString("Processing incoming message-id %1 of type %2 from %3 bytes from %4:%5")
-            .arg(message.id())
-            .arg(QString::fromLatin1(message.type()))
-            .arg(messageBytes.size())
-            .arg(this->peerAddress().toString())
-            .arg(this->peerPort());
-    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, msg);
+    // Frames that refer to, or release, messages in shared memory. They carry
+    // the compact format marker followed by a reserved opcode; so they cannot
+    // be mistaken for a legacy message any more than a compact message can.
+    int controlOpcode = 0;
+    if(m_receiveBuffer.size() >= 2 && GCF::IpcMessage::isCompactByteArray(m_receiveBuffer))
+    {
+        const int opcode = int(uchar(m_receiveBuffer.at(1)));
+        if(opcode == SharedMemoryAckOpcode || opcode == SharedMemoryFrameOpcode)
+            controlOpcode = opcode;
+    }
 
-    emit incomingMessage(message);
+    if(controlOpcode)
+    {
+        // Such frames are legal only on local sockets, and only once shared
+        // memory was negotiated. A peer is allowed to place messages in shared
+        // memory only after this end advertised support for it; and an ack
+        // can only refer to messages that this end placed in shared memory.
+        const bool legal = m_localSocket &&
+                (controlOpcode == SharedMemoryAckOpcode ? m_sharedMemoryOut != nullptr : m_sharedMemoryAdvertised);
+        if(!legal)
+        {
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                  "Received an unexpected shared memory frame. Closing connection.");
+            this->abort();
+            return false;
+        }
+    }
 
-    if(this->bytesAvailable() == 0)
-        emit readBufferEmpty();
+    if(controlOpcode == SharedMemoryAckOpcode)
+    {
+        QDataStream ds(m_receiveBuffer);
+        quint8 marker = 0, opcode = 0;
+        quint64 tail = 0;
+        ds >> marker >> opcode >> tail;
+        if(ds.status() == QDataStream::Ok && tail > m_sharedMemoryTail && tail <= m_sharedMemoryHead)
+        {
+            m_sharedMemoryTail = tail;
+            if(m_sharedMemoryTail == m_sharedMemoryHead && m_device->bytesToWrite() == 0)
+                emit writeBufferEmpty();
+        }
+        return true;
+    }
+
+    if(controlOpcode == SharedMemoryFrameOpcode && !this->readFromSharedMemory())
+        return false;
+
+    GCF::IpcMessage message;
+    if(GCF::IpcMessage::isCompactByteArray(m_receiveBuffer))
+    {
+        message = GCF::IpcMessage::fromCompactByteArray(m_receiveBuffer, &m_receiveDictionary);
+        m_peerWireFormat = qMax(m_peerWireFormat, int(GCF::IpcCompactWireFormat));
+    }
     else
-        QMetaObject::invokeMethod(this, "onReadyRead", Qt::QueuedConnection);
+        message = GCF::IpcMessage::fromByteArray(m_receiveBuffer);
+
+    // Capabilities advertised by the peer along with its first message
+    if(message.data().contains("wireFormat"))
+    {
+        const int wireFormat = message.data().take("wireFormat").toInt();
+        m_peerWireFormat = qMax(m_peerWireFormat, qMin(wireFormat, int(GCF::IpcCompactWireFormat)));
+    }
+    if(message.data().contains("sharedMemory"))
+        m_peerSharedMemory = message.data().take("sharedMemory").toBool();
+
+    const int messageSize = m_receiveBuffer.size();
+    if(GCF::IpcTrace::isEnabled())
+        this->trace(GCF::IpcTraceEvent::MessageReceived, message, messageSize);
+
+    if(m_receiveBuffer.capacity() > MaxRetainedBufferSize)
+        m_receiveBuffer = QByteArray();
+
+    emit incomingMessage(message);
+    return true;
+}
+
+/*
+The outgoing shared memory segment is used as a ring buffer. Each message is
+stored in one piece; a frame that tells the peer where to find it is sent over
+the socket. The peer copies the message out and acknowledges, after which the
+memory can be reused. Returns false if the message should be sent over the
+socket instead.
+*/
+bool GCF::IpcSocket::writeToSharedMemory(const char *data, int size)
+{
+    if(!m_sharedMemoryOut)
+    {
+        static QAtomicInt segmentCounter(1);
+        const QString key = QString("GCF3IpcShm-%1-%2")
+                .arg(QCoreApplication::applicationPid())
+                .arg(segmentCounter.fetchAndAddOrdered(1));
+
+        m_sharedMemoryOut = new QSharedMemory(key, this);
+        if(!m_sharedMemoryOut->create(SharedMemorySize))
+        {
+            QString msg = QString("Could not create shared memory segment: %1. "
+                                  "Messages will be sent over the socket.")
+                    .arg(m_sharedMemoryOut->errorString());
+            GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT, msg);
+
+            delete m_sharedMemoryOut;
+            m_sharedMemoryOut = nullptr;
+            m_peerSharedMemory = false;
+            return false;
+        }
+
+        m_sharedMemoryHead = 0;
+        m_sharedMemoryTail = 0;
+    }
+
+    // Skip the end of the segment, if the message doesnt fit there
+    const quint64 capacity = quint64(SharedMemorySize);
+    quint64 offset = m_sharedMemoryHead % capacity;
+    quint64 skip = 0;
+    if(offset + quint64(size) > capacity)
+    {
+        skip = capacity - offset;
+        offset = 0;
+    }
+
+    // The peer is yet to read earlier messages, if there isn't enough room
+    if(m_sharedMemoryHead - m_sharedMemoryTail + skip + quint64(size) > capacity)
+        return false;
+
+    ::memcpy(static_cast<char*>(m_sharedMemoryOut->data()) + offset, data, size_t(size));
+    m_sharedMemoryHead += skip + quint64(size);
+
+    QByteArray frame;
+    {
+        QDataStream ds(&frame, QIODevice::WriteOnly);
+        ds << quint32(0) << quint8(GCF::IpcMessage::CompactFormatMarker) << quint8(SharedMemoryFrameOpcode);
+        ds << m_sharedMemoryOut->key();
+        ds << quint32(offset) << quint32(size) << quint64(m_sharedMemoryHead);
+    }
+    qToBigEndian<quint32>(quint32(frame.size()) - quint32(sizeof(quint32)),
+                          reinterpret_cast<uchar*>(frame.data()));
+    m_device->write(frame);
+
+    return true;
+}
+
+/*
+Replaces the shared memory frame in the receive buffer with the message it
+refers to, and lets the peer know that the memory can be reused.
+*/
+bool GCF::IpcSocket::readFromSharedMemory()
+{
+    QString key;
+    quint32 offset = 0, size = 0;
+    quint64 head = 0;
+    {
+        QDataStream ds(m_receiveBuffer);
+        quint8 marker = 0, opcode = 0;
+        ds >> marker >> opcode >> key >> offset >> size >> head;
+        if(ds.status() != QDataStream::Ok)
+            key.clear();
+    }
+
+    QString errMsg;
+    if(key.isEmpty())
+        errMsg = "Invalid frame";
+    else if(!m_sharedMemoryIn || m_sharedMemoryIn->key() != key)
+    {
+        delete m_sharedMemoryIn;
+        m_sharedMemoryIn = new QSharedMemory(key, this);
+        if(!m_sharedMemoryIn->attach(QSharedMemory::ReadOnly))
+        {
+            errMsg = m_sharedMemoryIn->errorString();
+            delete m_sharedMemoryIn;
+            m_sharedMemoryIn = nullptr;
+        }
+    }
+
+    if(errMsg.isEmpty() && quint64(offset) + quint64(size) > quint64(m_sharedMemoryIn->size()))
+        errMsg = "Message lies outside the shared memory segment";
+
+    if(!errMsg.isEmpty())
+    {
+        QString msg = QString("Could not read message from shared memory: %1. Closing connection.")
+                .arg(errMsg);
+        GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT, msg);
+        this->abort();
+        return false;
+    }
+
+    m_receiveBuffer.resize(int(size));
+    ::memcpy(m_receiveBuffer.data(),
+             static_cast<const char*>(m_sharedMemoryIn->constData()) + offset, size_t(size));
+
+    QByteArray frame;
+    {
+        QDataStream ds(&frame, QIODevice::WriteOnly);
+        ds << quint32(0) << quint8(GCF::IpcMessage::CompactFormatMarker) << quint8(SharedMemoryAckOpcode);
+        ds << head;
+    }
+    qToBigEndian<quint32>(quint32(frame.size()) - quint32(sizeof(quint32)),
+                          reinterpret_cast<uchar*>(frame.data()));
+    m_device->write(frame);
+
+    return true;
+}
+
+void GCF::IpcSocket::trace(int eventType, const GCF::IpcMessage &message, int size)
+{
+    GCF::IpcTraceEvent event;
+    event.EventType = GCF::IpcTraceEvent::Type(eventType);
+    event.Timestamp = QDateTime::currentMSecsSinceEpoch();
+    event.MessageId = message.id();
+    event.MessageType = message.type();
+    event.IsResponse = message.isResponse();
+    event.Size = size;
+    event.PeerAddress = this->peerAddress();
+    event.PeerPort = this->peerPort();
+
+    // Latency of a response is measured from the time its request was seen
+    // on this socket. Signal deliveries never get a response.
+    if(!m_traceTimer.isValid())
+        m_traceTimer.start();
+    if(message.isResponse())
+    {
+        if(m_traceRequestTimes.contains(message.id()))
+            event.Latency = m_traceTimer.elapsed() - m_traceRequestTimes.take(message.id());
+    }
+    else if(message.type() != GCF::IpcMessage::SIGNAL_DELIVERY)
+    {
+        // Requests whose responses never came should not pile up
+        if(m_traceRequestTimes.size() >= 4096)
+            m_traceRequestTimes.clear();
+        m_traceRequestTimes[message.id()] = m_traceTimer.elapsed();
+    }
+
+    GCF::IpcTrace::record(event);
 }
 
 void GCF::IpcSocket::onBytesWritten()
 {
-    if(this->bytesToWrite() == 0)
+    // Messages in shared memory are yet to be read, if the peer has not
+    // acknowledged them. Those who close the socket once everything is
+    // written should wait till then.
+    if(this->bytesToWrite() == 0 && m_sharedMemoryHead == m_sharedMemoryTail)
         emit writeBufferEmpty();
 }
 
@@ -20,14 +20,52 @@
 #define IPCCOMMON_P_H
 
 #include <QTcpSocket>
+#include <QLocalSocket>
+#include <QHostAddress>
+#include <QSharedMemory>
 #include <QByteArray>
 #include <QDataStream>
 #include <QMetaType>
+#include <QAtomicInt>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
 #include "../Core/GCFGlobal.h"
+#include "IpcCommon.h"
 
 namespace GCF
 {
 
+/*
+ * Strings (object names, method names, property names...) that are interned
+ * on one end of a connection. The first occurance of a string is sent in full
+ * and both ends add it to their dictionary; from then on only its index is sent.
+ * Each socket keeps one dictionary for messages it sends and another for
+ * messages it receives.
+ */
+class IpcWireDictionary
+{
+public:
+    enum { MaxEntries = 1024 };
+
+    int indexOf(const QString &string) const { return m_indexes.value(string, -1); }
+    QString at(int index) const { return m_strings.value(index); }
+    int count() const { return m_strings.count(); }
+    bool isFull() const { return m_strings.count() >= MaxEntries; }
+
+    bool add(const QString &string) {
+        if(this->isFull())
+            return false;
+        m_indexes.insert(string, m_strings.count());
+        m_strings.append(string);
+        return true;
+    }
+
+private:
+    QHash<QString,int> m_indexes;
+    QVector<QString> m_strings;
+};
+
 class IpcMessage
 {
 public:
@@ -38,7 +76,7 @@ public:
     static QByteArray SIGNAL_DELIVERY;
     static QByteArray IPC_CALL;
 
-    IpcMessage() : m_id(-1) { }
+    IpcMessage() : m_id(-1), m_isResponse(false) { }
 
     IpcMessage(const IpcMessage &other)
         : m_id(other.m_id),
@@ -57,8 +95,9 @@ public:
     }
 
     IpcMessage(const QByteArray &type) : m_type(type), m_isResponse(false) {
-        static qint32 id = 1;
-        m_id = id++;
+        // Calls from several threads can construct messages at the same time
+        static QAtomicInt id(1);
+        m_id = id.fetchAndAddOrdered(1);
     }
     IpcMessage(qint32 id, const QByteArray &type) : m_id(id), m_type(type),
         m_isResponse(true) { }
@@ -87,6 +126,16 @@ public:
 
     QByteArray toByteArray() const { return toByteArray(*this); }
     static QByteArray toByteArray(const IpcMessage &message);
+    static void write(QDataStream &ds, const IpcMessage &message);
+
+    // Compact (version 2) wire format
+    static const uchar CompactFormatMarker = 0x82;
+    static bool isCompactByteArray(const QByteArray &bytes) {
+        return !bytes.isEmpty() && uchar(bytes.at(0)) == CompactFormatMarker;
+    }
+    static IpcMessage fromCompactByteArray(const QByteArray &bytes, IpcWireDictionary *dictionary);
+    static QByteArray toCompactByteArray(const IpcMessage &message, IpcWireDictionary *dictionary);
+    static void writeCompact(QDataStream &ds, const IpcMessage &message, IpcWireDictionary *dictionary);
 
 private:
     qint32 m_id;
@@ -96,7 +145,14 @@ private:
     GCF::Result m_result;
 };
 
-class IpcSocket : public QTcpSocket
+/*
+ * Connections are made over one of the transports in GCF::IpcTransport. TCP is
+ * always available. When the peer is on the same host, a QLocalSocket is used
+ * instead; and large messages are handed over through shared memory, if both
+ * ends support it. The rest of the module only sees IpcSocket, so the API below
+ * mirrors the parts of QAbstractSocket that it needs.
+ */
+class IpcSocket : public QObject
 {
     Q_OBJECT
 
@@ -104,21 +160,102 @@ public:
     IpcSocket(QObject *parent=0);
     ~IpcSocket();
 
+    void connectToHost(const QHostAddress &addr, quint16 port);
+#if QT_VERSION >= 0x050000
+    bool setSocketDescriptor(qintptr handle);
+#else
+    bool setSocketDescriptor(int handle);
+#endif
+    void setLocalSocket(QLocalSocket *socket);
+
+    int transport() const;
+    bool isUsingSharedMemory() const;
+
+    QAbstractSocket::SocketState state() const;
+    QString errorString() const;
+    QHostAddress peerAddress() const;
+    quint16 peerPort() const;
+    qint64 bytesAvailable() const;
+    qint64 bytesToWrite() const;
+    bool waitForConnected(int msecs=30000);
+    bool waitForBytesWritten(int msecs=30000);
+    void disconnectFromHost();
+    void abort();
+
     void sendMessage(const GCF::IpcMessage &message);
+    void processPendingMessages();
+
+    int peerWireFormat() const { return m_peerWireFormat; }
 
 private slots:
     void onReadyRead();
     void onBytesWritten();
+    void onLocalSocketConnected();
+    void onLocalSocketError();
 
 signals:
+    void connected();
+    void disconnected();
+    void error(QAbstractSocket::SocketError error);
+    void readyRead();
+    void bytesWritten(qint64 bytes);
+
     void incomingMessage(const GCF::IpcMessage &message);
     void readBufferEmpty();
     void writeBufferEmpty();
 
 private:
+    void setDevice(QIODevice *device);
+    void connectOverTcp();
+    bool readMessage();
+    bool writeToSharedMemory(const char *data, int size);
+    bool readFromSharedMemory();
+    void trace(int eventType, const GCF::IpcMessage &message, int size);
+
+private:
+    enum
+    {
+        InitialBufferSize = 4096,
+        MaxRetainedBufferSize = 1024*1024,
+        MaxMessagesPerReadyRead = 64,
+        SharedMemoryThreshold = 64*1024,
+        SharedMemorySize = 8*1024*1024,
+        // Opcodes of the compact format that are reserved for shared memory
+        // control frames. They never describe a message.
+        SharedMemoryFrameOpcode = 0x7F,
+        SharedMemoryAckOpcode = 0x7E
+    };
+
+    QIODevice *m_device;
+    QTcpSocket *m_tcpSocket;
+    QLocalSocket *m_localSocket;
+    QHostAddress m_address;
+    quint16 m_port;
+    bool m_localConnected;
+
     qint32 m_incomingMessageSize;
+    QByteArray m_sendBuffer;
+    QByteArray m_receiveBuffer;
+    int m_peerWireFormat;
+    bool m_advertised;
+    bool m_peerSharedMemory;
+    bool m_sharedMemoryAdvertised;
+    GCF::IpcWireDictionary m_sendDictionary;
+    GCF::IpcWireDictionary m_receiveDictionary;
+
+    QSharedMemory *m_sharedMemoryOut;
+    QSharedMemory *m_sharedMemoryIn;
+    quint64 m_sharedMemoryHead;
+    quint64 m_sharedMemoryTail;
+
+    QElapsedTimer m_traceTimer;
+    QHash<qint32, qint64> m_traceRequestTimes;
 };
 
+QString ipcLocalServerName(const QHostAddress &addr, quint16 port);
+void ipcSetPeerTransports(const QHostAddress &addr, quint16 port, int transports);
+int ipcPeerTransports(const QHostAddress &addr, quint16 port);
+
 }
 
 Q_DECLARE_METATYPE(GCF::IpcMessage)
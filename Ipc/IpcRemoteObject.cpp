@@ -47,6 +47,7 @@ public:
           m_port(parent->remotePort()),
           m_object(parent->remoteObjectPath()),
           m_method(method) {
+        this->setHistoryLimit(0);
         connect(sender, SIGNAL(destroyed()), this, SLOT(deleteLater()));
     }
 
@@ -56,7 +57,9 @@ public:
                    QObject *parent=nullptr)
         : GCF::SignalSpy(sender, signal, parent),
           m_address(address), m_port(port), m_object(object),
-          m_method(method) { }
+          m_method(method) {
+        this->setHistoryLimit(0);
+    }
 
     ~SignalDespatch() { }
 
@@ -121,7 +124,7 @@ GCF_INTERFACE_END
 
 struct IpcRemoteObjectData
 {
-    IpcRemoteObjectData() : socket(nullptr), activated(NOT_ACTIVATED) { }
+    IpcRemoteObjectData() : requestWindow(16), socket(nullptr), activated(NOT_ACTIVATED) { }
     ~IpcRemoteObjectData() {
         QList<NotificationPair*> npl = notificationPairs;
         notificationPairs.clear();
@@ -135,8 +138,10 @@ struct IpcRemoteObjectData
 #ifdef Q_OS_MAC
     char unused1[6]; // For padding
 #endif
-    GCF::IpcMessage currentMessage;
+    // Requests that have been sent, but not yet responded to (id -> type)
+    QMap<qint32, QByteArray> outstandingRequests;
     QList<GCF::IpcMessage> messageQueue;
+    int requestWindow;
 
     GCF::IpcSocket *socket;
     enum {
@@ -234,6 +239,11 @@ spy.wait();
 QPushButton *quitButton = ...;
 GCF::ipcConnect(quitButton, SIGNAL(clicked()), remoteAll, SLOT(quit()));
 \endcode
+
+Property requests (\ref updateProperty(), \ref changeProperty()) and connection requests
+are pipelined. Up to \ref requestWindow() requests are sent without waiting for responses
+to earlier ones. The remote end handles requests in the order in which they were sent, so
+responses (and notifications to receivers) arrive in the same order.
  */
 
 /**
@@ -343,6 +353,36 @@ QStringList GCF::IpcRemoteObject::invokableMethods() const
     return d->invokableMethods;
 }
 
+/**
+Sets the maximum number of requests that can be sent to the remote object without waiting
+for their responses. By default up to 16 requests can be outstanding. Set the window to 1 for
+strict stop-and-wait behaviour.
+
+@param count maximum number of outstanding requests. Values less than 1 are treated as 1.
+*/
+void GCF::IpcRemoteObject::setRequestWindow(int count)
+{
+    d->requestWindow = qMax(1, count);
+    this->sendNextMessage();
+}
+
+/**
+@return maximum number of requests that can be sent to the remote object without waiting
+for their responses.
+*/
+int GCF::IpcRemoteObject::requestWindow() const
+{
+    return d->requestWindow;
+}
+
+/**
+@return number of requests that have been sent to the remote object and are waiting for a response.
+*/
+int GCF::IpcRemoteObject::outstandingRequestCount() const
+{
+    return d->outstandingRequests.count();
+}
+
 /**
 Sends a request to update the value of \c propertyName in the local \ref properties() map. The
 function returns true if the update request was queued successfully, false with error message
@@ -655,7 +695,7 @@ void GCF::IpcRemoteObject::onSocketDisconnected()
     d->signalMethods.clear();
     d->socket->deleteLater();
     d->socket = nullptr;
-    d->currentMessage = GCF::IpcMessage();
+    d->outstandingRequests.clear();
     d->messageQueue.clear();
 
     d->activated = GCF::IpcRemoteObjectData::NOT_ACTIVATED;
@@ -706,13 +746,15 @@ void GCF::IpcRemoteObject::onSocketIncomingMessage(const GCF::IpcMessage &messag
         return;
     }
 
-    if(message.id() != d->currentMessage.id() || message.type() != d->currentMessage.type() )
+    if(!d->outstandingRequests.contains(message.id()) ||
+       d->outstandingRequests.value(message.id()) != message.type())
     {
         emitError("Out of sequence message received");
         return;
     }
 
-    // Process the response message to d->currentMessage
+    // Process the response message to one of the outstanding requests
+    d->outstandingRequests.remove(message.id());
     if( message.type() == GCF::IpcMessage::GET_PROPERTY_VALUE ||
         message.type() == GCF::IpcMessage::SET_PROPERTY_VALUE )
     {
@@ -740,8 +782,7 @@ void GCF::IpcRemoteObject::onSocketIncomingMessage(const GCF::IpcMessage &messag
     else
         emitError( tr("Unknown message type '%1' received").arg(QString::fromLatin1(message.type())) );
 
-    // Send the next message (if any)
-    d->currentMessage = GCF::IpcMessage();
+    // The window now has room for more messages (if any)
     this->sendNextMessage();
 }
 
@@ -758,21 +799,18 @@ void GCF::IpcRemoteObject::sendNextMessage()
 {
     if(!d->socket ||
        d->activated != GCF::IpcRemoteObjectData::ACTIVATED ||
-       d->socket->state() != GCF::IpcSocket::ConnectedState)
+       d->socket->state() != QAbstractSocket::ConnectedState)
         return;
 
-    if(d->currentMessage.isValid())
+    // Send as many messages as the window allows. Responses to messages
+    // beyond that have to come in before more messages can be sent.
+    while(!d->messageQueue.isEmpty() &&
+          d->outstandingRequests.count() < d->requestWindow)
     {
-        // We need to wait for the response on the current message first
-        // before a next message can be sent. So, lets wait for it.
-        return;
+        GCF::IpcMessage message = d->messageQueue.takeFirst();
+        d->outstandingRequests.insert(message.id(), message.type());
+        d->socket->sendMessage(message);
     }
-
-    if(d->messageQueue.isEmpty())
-        return;
-
-    d->currentMessage = d->messageQueue.takeFirst();
-    d->socket->sendMessage(d->currentMessage);
 }
 
 void GCF::IpcRemoteObject::emitActivated()
@@ -791,23 +829,16 @@ void GCF::IpcRemoteObject::emitDeactivated()
 
 void GCF::IpcRemoteObject::emitRequestFinished(int requestId)
 {
-    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT,
-                               QString("IpcRemoteObject(%1) request '%2' finished").arg(d->object).arg(requestId) );
     emit requestFinished(requestId);
 }
 
 void GCF::IpcRemoteObject::emitSignalOccurance(const QString &signal, const QVariantList &args)
 {
-    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT,
-                               QString("IpcRemoteObject '%1::%2' signal occurance").arg(d->object).arg(signal) );
     emit signalOccurance(signal, args);
 }
 
 void GCF::IpcRemoteObject::emitPropertyUpdated(const QString &name, const QVariant &value)
 {
-    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT,
-                               QString("IpcRemoteObject property %1::%2 updated to %3")
-                               .arg(d->object).arg(name).arg(value.toString()) );
     emit propertyUpdated(name, value);
 }
 
@@ -52,6 +52,10 @@ public:
     QStringList signalMethods() const;
     QStringList invokableMethods() const;
 
+    void setRequestWindow(int count);
+    int requestWindow() const;
+    int outstandingRequestCount() const;
+
     GCF::Result updateProperty(const QString &propertyName,
                         QObject *receiver=nullptr, const char *member=nullptr);
     GCF::Result changeProperty(const QString &propertyName, const QVariant &propertyValue,
@@ -19,13 +19,14 @@
 #include "IpcServer.h"
 #include "IpcServer_p.h"
 #include "IpcCommon_p.h"
-#include "IpcCommon_p.h"
 
 #include "../Core/Application.h"
 #include "../Core/Log.h"
 
 #include <QUuid>
 #include <QVector>
+#include <QLocalServer>
+#include <QLocalSocket>
 
 /**
 \class GCF::IpcServer IpcServer.h <GCF3/IpcServer>
@@ -34,6 +35,10 @@
 
 Create an instance of this class and call \c listen() to begin listening for
 incoming requests and responding to them.
+
+Besides TCP, the server also listens on a local socket so that applications on
+the same host can avoid the TCP loopback stack. Such applications pick the local
+socket automatically. See \ref GCF::setIpcTransports().
 */
 
 Q_GLOBAL_STATIC( QList<GCF::IpcServer*>, IpcServerList )
@@ -50,7 +55,7 @@ QList<GCF::IpcServer*> GCF::IpcServer::servers()
 Creates an instance of this class with parent object \c parent
  */
 GCF::IpcServer::IpcServer(QObject *parent)
-    :QTcpServer(parent)
+    :QTcpServer(parent), m_localServer(nullptr)
 {
     ::IpcServerList()->append(this);
 }
@@ -61,6 +66,7 @@ Destructor
 GCF::IpcServer::~IpcServer()
 {
     ::IpcServerList()->removeAll(this);
+    delete m_localServer;
 }
 
 QString GCF::IpcServer::serverId() const
@@ -71,6 +77,103 @@ QString GCF::IpcServer::serverId() const
     return m_serverId;
 }
 
+/**
+Begins listening for incoming connections on \c address and \c port. If
+\c GCF::IpcLocalTransport is enabled and \c address accepts connections from
+this host, then the server also listens on a local socket named after the port
+and the address family.
+
+\return true on success, false otherwise. Failure to listen on the local socket
+is not treated as an error; applications on this host will then use TCP.
+
+\note This function hides \c QTcpServer::listen(). Calling that function instead
+will not start the local socket.
+*/
+bool GCF::IpcServer::listen(const QHostAddress &address, quint16 port)
+{
+    if(!QTcpServer::listen(address, port))
+        return false;
+
+    bool acceptsLocalConnections = address == QHostAddress(QHostAddress::Any) ||
+            address == QHostAddress(QHostAddress::AnyIPv6) ||
+            address == QHostAddress(QHostAddress::LocalHost) ||
+            address == QHostAddress(QHostAddress::LocalHostIPv6);
+#if QT_VERSION >= 0x050000
+    acceptsLocalConnections |= address == QHostAddress(QHostAddress::AnyIPv4);
+#endif
+
+    if(!acceptsLocalConnections || !(GCF::ipcTransports() & GCF::IpcLocalTransport))
+        return true;
+
+    const QString name = GCF::ipcLocalServerName(address, this->serverPort());
+    m_localServer = new QLocalServer(this);
+#if QT_VERSION >= 0x050000
+    m_localServer->setSocketOptions(QLocalServer::UserAccessOption);
+#endif
+    bool success = m_localServer->listen(name);
+    if(!success && m_localServer->serverError() == QAbstractSocket::AddressInUseError)
+    {
+        // The socket file may have been left behind by a server that crashed.
+        // It is removed only if nobody is accepting connections on it.
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if(!probe.waitForConnected(1000))
+        {
+            QLocalServer::removeServer(name);
+            success = m_localServer->listen(name);
+        }
+        else
+            probe.abort();
+    }
+
+    if(!success)
+    {
+        GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
+                                      QString("Could not listen on local socket %1: %2")
+                                      .arg(name).arg(m_localServer->errorString()));
+        delete m_localServer;
+        m_localServer = nullptr;
+        return true;
+    }
+
+    connect(m_localServer, SIGNAL(newConnection()), this, SLOT(onNewLocalConnection()));
+    return true;
+}
+
+/**
+Stops listening for incoming connections, on TCP and on the local socket.
+*/
+void GCF::IpcServer::close()
+{
+    delete m_localServer;
+    m_localServer = nullptr;
+    QTcpServer::close();
+}
+
+/**
+\return transports over which this server can be reached, as a combination of
+\c GCF::IpcTransport values. Returns 0 if the server is not listening.
+*/
+int GCF::IpcServer::transports() const
+{
+    if(!this->isListening())
+        return 0;
+
+    int retVal = GCF::IpcTcpTransport;
+    if(m_localServer)
+        retVal |= GCF::IpcLocalTransport | (GCF::ipcTransports() & GCF::IpcSharedMemoryTransport);
+    return retVal;
+}
+
+/**
+\return name of the local socket on which this server is listening, or an empty
+string if it is not listening on a local socket.
+*/
+QString GCF::IpcServer::localServerName() const
+{
+    return m_localServer ? m_localServer->serverName() : QString();
+}
+
 #if QT_VERSION >= 0x050000
 void GCF::IpcServer::incomingConnection(qintptr handle)
 #else
@@ -85,6 +188,23 @@ void GCF::IpcServer::incomingConnection(int handle)
     // close the socket connection.
     //
     // So we are not going to call this->addPendingConnection(socket);
+    this->addSocket(socket);
+}
+
+void GCF::IpcServer::onNewLocalConnection()
+{
+    while(m_localServer && m_localServer->hasPendingConnections())
+    {
+        QLocalSocket *localSocket = m_localServer->nextPendingConnection();
+        GCF::IpcSocket *socket = new GCF::IpcSocket(this);
+        socket->setLocalSocket(localSocket);
+        this->addSocket(socket);
+    }
+}
+
+void GCF::IpcServer::addSocket(GCF::IpcSocket *socket)
+{
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()), Qt::UniqueConnection);
 
     GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT,
                                QString("Incoming IPC connection from %1:%2")
@@ -97,10 +217,8 @@ void GCF::IpcServer::incomingConnection(int handle)
 
 void GCF::IpcServer::onIncomingMessage(const GCF::IpcMessage &message)
 {
-    GCF::LogMessageBranch branch(QString("Processing message-id %1 of type %2")
-                                 .arg(message.id())
-                                 .arg(QString::fromLatin1(message.type())));
-
+    // Messages are not logged here, because formatting a log line per message
+    // is too expensive at high message rates. Use GCF::IpcTrace instead.
     GCF::IpcSocket *socket = qobject_cast<GCF::IpcSocket*>(this->sender());
     if(!socket)
     {
@@ -109,31 +227,20 @@ void GCF::IpcServer::onIncomingMessage(const GCF::IpcMessage &message)
         return;
     }
 
-    GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT,
-                                  QString("Message came from %1:%2")
-                                  .arg(socket->peerAddress().toString())
-                                  .arg(socket->peerPort()));
-
     if(message.type() == GCF::IpcMessage::IPC_CALL)
     {
         QString object = message.data().value("object").toString();
         QString method = message.data().value("method").toString();
         QVariantList args = message.data().value("arguments").toList();
-        GCF::LogMessageBranch branch( QString("Processing call %1::%2(%3 args)")
-                                      .arg(object).arg(method).arg(args.count()));
-
-        GCF::Result result = gAppService->invokeMethod(object, method, args);
-        connect(socket, SIGNAL(writeBufferEmpty()), socket, SLOT(deleteLater()));
 
-        GCF::IpcMessage response(message.id(), message.type());
-        response.setResult(result);
-        socket->sendMessage(response);
+        // The call is made asynchronously, so that a slow method does not
+        // hold up other IPC traffic being handled by this thread. The response
+        // is sent by the responder once the call finishes.
+        QFuture<GCF::Result> future = gAppService->invokeMethodAsync(object, method, args);
+        new GCF::IpcCallResponder(message, future, socket);
     }
     else if(message.type() == GCF::IpcMessage::REQUEST_OBJECT)
     {
-        QString object = message.data().value("object").toString();
-        GCF::LogMessageBranch branch( QString("Process remote object request for '%1'").arg(object) );
-
         GCF::IpcRemoteObjectHandler *remoteObjectHandler =
                 new GCF::IpcRemoteObjectHandler(message, socket, this);
         disconnect(socket, nullptr, this, nullptr);
@@ -143,6 +250,41 @@ void GCF::IpcServer::onIncomingMessage(const GCF::IpcMessage &message)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+GCF::IpcCallResponder::IpcCallResponder(const GCF::IpcMessage &request,
+                                        const QFuture<GCF::Result> &future,
+                                        GCF::IpcSocket *socket)
+    : QObject(socket), m_requestId(request.id()),
+      m_requestType(request.type()), m_socket(socket),
+      m_keepAlive(request.data().value("keepAlive").toBool())
+{
+    connect(&m_watcher, SIGNAL(finished()), this, SLOT(onCallFinished()));
+    m_watcher.setFuture(future);
+}
+
+GCF::IpcCallResponder::~IpcCallResponder()
+{
+
+}
+
+void GCF::IpcCallResponder::onCallFinished()
+{
+    GCF::Result result = m_watcher.future().result();
+
+    // Callers that ask for keep-alive multiplex several calls on the same
+    // socket and close it themselves when idle. Other callers expect the
+    // connection to be closed once the response is written.
+    if(!m_keepAlive)
+        connect(m_socket, SIGNAL(writeBufferEmpty()), m_socket, SLOT(deleteLater()));
+
+    GCF::IpcMessage response(m_requestId, m_requestType);
+    response.setResult(result);
+    m_socket->sendMessage(response);
+
+    this->deleteLater();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 QVariantMap objectProperties(QObject *object)
 {
     QVariantMap retMap;
@@ -185,7 +327,7 @@ QStringList objectMembers(QObject *object, bool signalsOnly=false)
 GCF::IpcRemoteObjectHandler::IpcRemoteObjectHandler(const IpcMessage &request,
                        IpcSocket *socket,
                        QObject *parent)
-    : QObject(parent), m_socket(socket)
+    : QObject(parent), m_socket(socket), m_signalDespatch(nullptr)
 {
     m_socket->setParent(this);
 
@@ -258,16 +400,12 @@ void GCF::IpcRemoteObjectHandler::onIncomingMessage(const GCF::IpcMessage &messa
     {
         QByteArray signal = message.data().value("signal").toByteArray();
         signal.prepend('2');
-        GCF::IpcRemoteSignalDespatch *signalDespatch =
-                new GCF::IpcRemoteSignalDespatch(signal, this);
-        if(!signalDespatch || !signalDespatch->isValid())
-        {
-            delete signalDespatch;
-            signalDespatch = nullptr;
-        }
+        if(!m_signalDespatch)
+            m_signalDespatch = new GCF::IpcRemoteSignalDespatch(this);
+        const int connectionId = m_signalDespatch->connectSignal(m_object, signal.constData());
 
         response.data()["signal"] = signal;
-        response.setResult( signalDespatch != nullptr );
+        response.setResult( connectionId >= 0 );
     }
 
     m_socket->sendMessage(response);
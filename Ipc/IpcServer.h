@@ -24,10 +24,13 @@
 #include <QList>
 #include <QTcpServer>
 
+class QLocalServer;
+
 namespace GCF
 {
 
 class IpcMessage;
+class IpcSocket;
 class GCF_IPC_EXPORT IpcServer : public QTcpServer
 {
     Q_OBJECT
@@ -40,6 +43,12 @@ public:
 
     QString serverId() const;
 
+    bool listen(const QHostAddress &address=QHostAddress::Any, quint16 port=0);
+    void close();
+
+    int transports() const;
+    QString localServerName() const;
+
 protected:
 #if QT_VERSION >= 0x050000
     void incomingConnection(qintptr handle);
@@ -49,9 +58,14 @@ protected:
 
 private slots:
     void onIncomingMessage(const GCF::IpcMessage &message);
+    void onNewLocalConnection();
+
+private:
+    void addSocket(GCF::IpcSocket *socket);
 
 private:
     mutable QString m_serverId;
+    QLocalServer *m_localServer;
 };
 
 }
@@ -20,6 +20,7 @@
 
 #include "../Core/Log.h"
 #include "IpcServer.h"
+#include "IpcCommon_p.h"
 
 #include <QSysInfo>
 #include <QProcess>
@@ -61,6 +62,15 @@ This variable contains the IP address of the computer where the IpcServer was di
 This variable contains the TCP port on which the IpcServer is listening.
  */
 
+/**
+\var GCF::IpcServerInfo::Transports
+
+This variable contains the transports, as a combination of \c GCF::IpcTransport values,
+over which the IpcServer can be reached. Servers in applications built with older versions
+of GCF only advertise \c GCF::IpcTcpTransport. Local transports are only useful to
+applications on the same computer; such applications use them automatically.
+ */
+
 /**
 \fn bool GCF::IpcServerInfo::isValid() const
 
@@ -285,6 +295,12 @@ void GCF::IpcServerDiscovery::sendBroadcastDatagram()
         }
     }
 
+    // Transports supported by the servers are appended in the same order. Older
+    // versions of this class stop reading before this section.
+    ds << QString("transports");
+    Q_FOREACH(GCF::IpcServer *server, servers)
+        ds << qint32(server->transports());
+
     bool validBroadcastAddresses = true;
     foreach(QHostAddress address, d->broadcastAddresses)
     {
@@ -321,7 +337,9 @@ void GCF::IpcServerDiscovery::readBroadcastDatagram()
 
         qint32 count = 0;
         ds >> count;
-        for(int i=0; i<count; i++)
+
+        QList<GCF::IpcServerInfo> infos;
+        for(int i=0; i<count && ds.status() == QDataStream::Ok; i++)
         {
             quint16 serverPort = 0;
             ds >> serverPort;
@@ -329,8 +347,33 @@ void GCF::IpcServerDiscovery::readBroadcastDatagram()
             QString serverId;
             ds >> serverId;
 
-            GCF::IpcServerInfo info(user, address, serverPort, serverId);
-            if(info.isValid() && d->addFoundServer(info))
+            infos.append( GCF::IpcServerInfo(user, address, serverPort, serverId) );
+        }
+
+        QString section;
+        if(!ds.atEnd())
+            ds >> section;
+        if(section == "transports")
+        {
+            for(int i=0; i<infos.count() && !ds.atEnd(); i++)
+            {
+                qint32 transports = 0;
+                ds >> transports;
+                infos[i].Transports = int(transports) | GCF::IpcTcpTransport;
+            }
+        }
+
+        const bool sameHost = d->isMyAddress(address);
+        Q_FOREACH(GCF::IpcServerInfo info, infos)
+        {
+            if(!sameHost)
+                info.Transports = GCF::IpcTcpTransport;
+            if(!info.isValid())
+                continue;
+
+            // Connections to this server will now use the best transport on offer
+            GCF::ipcSetPeerTransports(info.Address, info.Port, info.Transports);
+            if(d->addFoundServer(info))
                 emit foundServer(info);
         }
     }
@@ -30,16 +30,19 @@ class IpcServer;
 
 struct IpcServerInfo
 {
-    IpcServerInfo() : Port(0) { }
-    IpcServerInfo(const QString &user, const QHostAddress &addr, quint16 port, const QString &id)
-        : User(user), Address(addr), Port(port), ServerId(id) { }
+    IpcServerInfo() : Port(0), Transports(GCF::IpcTcpTransport) { }
+    IpcServerInfo(const QString &user, const QHostAddress &addr, quint16 port, const QString &id,
+                  int transports=GCF::IpcTcpTransport)
+        : User(user), Address(addr), Port(port), ServerId(id), Transports(transports) { }
     IpcServerInfo(const IpcServerInfo &other)
-        : User(other.User), Address(other.Address), Port(other.Port), ServerId(other.ServerId) { }
+        : User(other.User), Address(other.Address), Port(other.Port), ServerId(other.ServerId),
+          Transports(other.Transports) { }
 
     QString User;
     QHostAddress Address;
     quint16 Port;
     QString ServerId;
+    int Transports;
 
     bool isValid() const { return !this->User.isEmpty() && !this->Address.isNull() && this->Port > 0 && !this->ServerId.isEmpty(); }
     bool operator == (const IpcServerInfo &other) const {
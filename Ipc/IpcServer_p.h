@@ -21,13 +21,15 @@
 
 #include <QMetaObject>
 #include <QMetaMethod>
+#include <QFutureWatcher>
 
-#include "../Core/SignalSpy.h"
+#include "../Core/MultiSignalSpy.h"
 #include "IpcCommon_p.h"
 
 namespace GCF
 {
 
+class IpcRemoteSignalDespatch;
 class IpcRemoteObjectHandler : public QObject
 {
     Q_OBJECT
@@ -47,19 +49,45 @@ private slots:
 private:
     GCF::IpcSocket *m_socket;
     QObject *m_object;
+    GCF::IpcRemoteSignalDespatch *m_signalDespatch;
 };
 
-class IpcRemoteSignalDespatch : public GCF::SignalSpy
+class IpcCallResponder : public QObject
+{
+    Q_OBJECT
+
+public:
+    IpcCallResponder(const GCF::IpcMessage &request,
+                     const QFuture<GCF::Result> &future,
+                     IpcSocket *socket);
+    ~IpcCallResponder();
+
+private slots:
+    void onCallFinished();
+
+private:
+    qint32 m_requestId;
+    QByteArray m_requestType;
+    GCF::IpcSocket *m_socket;
+    bool m_keepAlive;
+    QFutureWatcher<GCF::Result> m_watcher;
+};
+
+/*
+ * Delivers emissions of all signals of the object, that the remote end
+ * asked for, through a single spy.
+ */
+class IpcRemoteSignalDespatch : public GCF::MultiSignalSpy
 {
 public:
-    IpcRemoteSignalDespatch(const char *signal, IpcRemoteObjectHandler *parent = 0)
-        : GCF::SignalSpy(parent->object(), signal, parent), m_remoteObjectHandler(parent) { }
+    IpcRemoteSignalDespatch(IpcRemoteObjectHandler *parent)
+        : GCF::MultiSignalSpy(parent), m_remoteObjectHandler(parent) { }
     ~IpcRemoteSignalDespatch() { }
 
 protected:
-    void handleSignalEmission(const QVariantList &args) {
+    void handleSignalEmission(int connectionId, const QVariantList &args) {
         GCF::IpcMessage message(GCF::IpcMessage::SIGNAL_DELIVERY);
-        message.data()["signal"] = QString::fromLatin1(this->signal());
+        message.data()["signal"] = QString::fromLatin1(this->connectionSignal(connectionId));
         message.data()["arguments"] = args;
         message.setResult(true);
         m_remoteObjectHandler->socket()->sendMessage(message);
@@ -0,0 +1,206 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "IpcTrace.h"
+
+#include <QMutex>
+#include <QVector>
+#include <QAtomicInt>
+
+namespace GCF
+{
+
+struct IpcTraceBuffer
+{
+    IpcTraceBuffer() : capacity(1024), next(0) { }
+
+    QMutex mutex;
+    QVector<GCF::IpcTraceEvent> events;
+    int capacity;
+    int next; // Index of the oldest event, once the buffer is full
+
+    QList<GCF::IpcTraceEvent> orderedEvents() const {
+        QList<GCF::IpcTraceEvent> retList;
+        for(int i=0; i<events.size(); i++)
+            retList.append( events.at((next+i)%events.size()) );
+        return retList;
+    }
+};
+
+}
+
+Q_GLOBAL_STATIC(GCF::IpcTraceBuffer, GlobalIpcTraceBuffer)
+static QAtomicInt IpcTraceEnabled(0);
+
+/**
+\struct GCF::IpcTraceEvent IpcTrace <GCF3/IpcTrace>
+\brief Describes a single message that was sent or received over an IPC connection.
+\ingroup gcf_ipc
+
+Events are recorded by \ref GCF::IpcTrace while tracing is enabled. Each event
+carries the following information
+\li \c EventType - whether the message was sent or received
+\li \c Timestamp - milliseconds since epoch at which the event was recorded
+\li \c MessageId, \c MessageType and \c IsResponse - identify the message
+\li \c Size - number of bytes taken up by the message on the wire
+\li \c PeerAddress and \c PeerPort - the other end of the connection
+\li \c Latency - for responses, the number of milliseconds between the request
+and the response on the connection; -1 otherwise.
+*/
+
+/**
+\class GCF::IpcTrace IpcTrace <GCF3/IpcTrace>
+\brief Records IPC traffic for diagnostic purposes
+\ingroup gcf_ipc
+
+Messages exchanged by \ref GCF::IpcCall, \ref GCF::IpcRemoteObject and
+\ref GCF::IpcServer are not logged. Formatting a log line for every message
+costs more than sending the message itself at high message rates. Instead,
+you can enable tracing to have one \ref GCF::IpcTraceEvent recorded per message
+into a ring buffer. Tracing is disabled by default, in which case nothing is
+recorded.
+
+\code
+GCF::IpcTrace::setEnabled(true);
+...
+QList<GCF::IpcTraceEvent> events = GCF::IpcTrace::events();
+Q_FOREACH(GCF::IpcTraceEvent event, events)
+    qDebug() << event.MessageId << event.Size << event.Latency;
+\endcode
+
+Only the most recent \ref capacity() events are retained.
+*/
+
+/**
+Enables or disables tracing. Tracing is disabled by default.
+*/
+void GCF::IpcTrace::setEnabled(bool val)
+{
+    ::IpcTraceEnabled.fetchAndStoreOrdered(val ? 1 : 0);
+}
+
+/**
+\return true if tracing is enabled, false otherwise.
+*/
+bool GCF::IpcTrace::isEnabled()
+{
+    return ::IpcTraceEnabled.loadAcquire() != 0;
+}
+
+/**
+Sets the maximum number of events that are retained. Once the limit is reached,
+the oldest event is discarded to make room for a new one. By default 1024 events
+are retained.
+*/
+void GCF::IpcTrace::setCapacity(int count)
+{
+    GCF::IpcTraceBuffer *buffer = ::GlobalIpcTraceBuffer();
+    if(!buffer)
+        return;
+
+    QMutexLocker locker(&buffer->mutex);
+    count = qMax(count, 1);
+    if(count == buffer->capacity)
+        return;
+
+    // Retain the most recent events that fit into the new capacity
+    QList<GCF::IpcTraceEvent> events = buffer->orderedEvents();
+    while(events.count() > count)
+        events.removeFirst();
+
+    buffer->capacity = count;
+    buffer->events = events.toVector();
+    buffer->next = 0;
+}
+
+/**
+\return maximum number of events that are retained.
+*/
+int GCF::IpcTrace::capacity()
+{
+    GCF::IpcTraceBuffer *buffer = ::GlobalIpcTraceBuffer();
+    if(!buffer)
+        return 0;
+
+    QMutexLocker locker(&buffer->mutex);
+    return buffer->capacity;
+}
+
+/**
+\return events recorded so far, oldest first.
+*/
+QList<GCF::IpcTraceEvent> GCF::IpcTrace::events()
+{
+    GCF::IpcTraceBuffer *buffer = ::GlobalIpcTraceBuffer();
+    if(!buffer)
+        return QList<GCF::IpcTraceEvent>();
+
+    QMutexLocker locker(&buffer->mutex);
+    return buffer->orderedEvents();
+}
+
+/**
+\return number of events recorded so far.
+*/
+int GCF::IpcTrace::eventCount()
+{
+    GCF::IpcTraceBuffer *buffer = ::GlobalIpcTraceBuffer();
+    if(!buffer)
+        return 0;
+
+    QMutexLocker locker(&buffer->mutex);
+    return buffer->events.size();
+}
+
+/**
+Discards all recorded events.
+*/
+void GCF::IpcTrace::clear()
+{
+    GCF::IpcTraceBuffer *buffer = ::GlobalIpcTraceBuffer();
+    if(!buffer)
+        return;
+
+    QMutexLocker locker(&buffer->mutex);
+    buffer->events.clear();
+    buffer->next = 0;
+}
+
+/**
+Records \c event, if tracing is enabled. This function is called by the IPC
+module for every message that is sent or received; you would rarely need to
+call it yourself.
+*/
+void GCF::IpcTrace::record(const GCF::IpcTraceEvent &event)
+{
+    if(!GCF::IpcTrace::isEnabled())
+        return;
+
+    GCF::IpcTraceBuffer *buffer = ::GlobalIpcTraceBuffer();
+    if(!buffer)
+        return;
+
+    QMutexLocker locker(&buffer->mutex);
+    if(buffer->events.size() < buffer->capacity)
+        buffer->events.append(event);
+    else
+    {
+        buffer->events[buffer->next] = event;
+        buffer->next = (buffer->next+1) % buffer->capacity;
+    }
+}
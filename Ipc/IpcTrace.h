@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef IPCTRACE_H
+#define IPCTRACE_H
+
+#include "IpcCommon.h"
+
+#include <QList>
+#include <QByteArray>
+#include <QHostAddress>
+
+namespace GCF
+{
+
+struct IpcTraceEvent
+{
+    enum Type
+    {
+        MessageSent,
+        MessageReceived
+    };
+
+    IpcTraceEvent()
+        : EventType(MessageSent), Timestamp(0), MessageId(-1), IsResponse(false),
+          Size(0), PeerPort(0), Latency(-1) { }
+
+    Type EventType;
+    qint64 Timestamp;
+    qint32 MessageId;
+    QByteArray MessageType;
+    bool IsResponse;
+    int Size;
+    QHostAddress PeerAddress;
+    quint16 PeerPort;
+    qint64 Latency;
+};
+
+class GCF_IPC_EXPORT IpcTrace
+{
+public:
+    static void setEnabled(bool val);
+    static bool isEnabled();
+
+    static void setCapacity(int count);
+    static int capacity();
+
+    static QList<GCF::IpcTraceEvent> events();
+    static int eventCount();
+    static void clear();
+
+    static void record(const GCF::IpcTraceEvent &event);
+
+private:
+    IpcTrace() { }
+};
+
+}
+
+#endif // IPCTRACE_H
@@ -24,16 +24,21 @@
 #include <GCF3/IpcCall>
 #include <GCF3/IpcServer>
 #include <GCF3/Application>
+#include <GCF3/ObjectTree>
 #include <GCF3/SignalSpy>
+#include <GCF3/MultiSignalSpy>
 
 #include <QElapsedTimer>
 #include <QSignalSpy>
 #include <QPointer>
 #include <QProcess>
 #include <QTcpSocket>
+#include <QLocalSocket>
+#include <QLocalServer>
 #include <QThread>
 #include <QtConcurrentMap>
 #include <QFutureWatcher>
+#include <QFuture>
 
 #include "Caller.h"
 
@@ -58,6 +63,27 @@ inline bool continueSpinWait(QElapsedTimer *timer)
         eTimer.start(); \
     while(continueSpinWait(&(eTimer)))
 
+class LocalService : public QObject
+{
+    Q_OBJECT
+
+public:
+    LocalService(QObject *parent=0) : QObject(parent), m_cubeThread(0) { }
+    ~LocalService() { }
+
+    Q_INVOKABLE int square(int value) { return value*value; }
+    Q_INVOKABLE GCF_THREAD_SAFE int cube(int value) {
+        m_cubeThread = QThread::currentThread();
+        return value*value*value;
+    }
+
+    QThread *cubeThread() const { return m_cubeThread; }
+    void resetCubeThread() { m_cubeThread = 0; }
+
+private:
+    QThread *m_cubeThread;
+};
+
 class IpcTest : public QObject
 {
     Q_OBJECT
@@ -97,6 +123,11 @@ private Q_SLOTS:
     void testCallsFromThread();
     void testMultipleCalls();
     void testCallsFromThreadPool();
+    void testCallsShareConnection_data();
+    void testCallsShareConnection();
+    void testLocalServerName();
+    void testThreadSafeCalls();
+    void testCallAdmission();
     void killIpcServer();
     void testCallToNonExistingServer();
     void testCallOnWeakConnection();
@@ -104,6 +135,7 @@ private Q_SLOTS:
 private:
     QDir helperDirectory() const;
     QString logFileContents(bool deleteFile=true) const;
+    int serverSocketCount(GCF::IpcServer *server, bool local) const;
 
 private:
     QProcess *m_remoteApp;
@@ -852,6 +884,241 @@ void IpcTest::testCallsFromThreadPool()
     QVERIFY(success);
 }
 
+void IpcTest::testCallsShareConnection_data()
+{
+    QTest::addColumn<int>("transports");
+
+    QTest::newRow("tcp") << int(GCF::IpcTcpTransport);
+    QTest::newRow("local") << int(GCF::IpcAllTransports);
+}
+
+void IpcTest::testCallsShareConnection()
+{
+    QFETCH(int, transports);
+    QElapsedTimer timer;
+
+    // Connections to this host go over a local socket, unless only TCP is enabled.
+    // Sockets of the other kind must never show up in the server.
+    GCF::setIpcTransports(transports);
+    const bool local = (transports & GCF::IpcLocalTransport);
+
+    LocalService service;
+    QVariantMap serviceInfo;
+    serviceInfo["allowmetaaccess"] = true;
+    GCF::ObjectTreeNode *node = new GCF::ObjectTreeNode(gApp->objectTree()->rootNode(),
+                                                        "LocalService", &service,
+                                                        serviceInfo);
+
+    GCF::IpcServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost, ::ServerPort-2));
+    QVERIFY(server.transports() == (local ? GCF::ipcTransports() : int(GCF::IpcTcpTransport)));
+
+    // Calls placed at the same time must go over one connection
+    QList<GCF::IpcCall*> calls;
+    for(int i=0; i<10; i++)
+        calls.append(new GCF::IpcCall(QHostAddress::LocalHost, ::ServerPort-2,
+                                      "Application.LocalService", "square",
+                                      QVariantList() << i, this));
+
+    SPIN_WAIT(timer)
+    {
+        bool allDone = true;
+        Q_FOREACH(GCF::IpcCall *call, calls)
+            allDone &= call->isDone();
+        if(allDone)
+            break;
+    }
+
+    for(int i=0; i<calls.count(); i++)
+    {
+        QVERIFY(calls.at(i)->isSuccess());
+        QVERIFY(calls.at(i)->result() == QVariant(i*i));
+    }
+    qDeleteAll(calls);
+    calls.clear();
+
+    QVERIFY(this->serverSocketCount(&server, local) == 1);
+    QVERIFY(this->serverSocketCount(&server, !local) == 0);
+
+    // The connection must be kept alive for subsequent calls
+    GCF::IpcCall *call = new GCF::IpcCall(QHostAddress::LocalHost, ::ServerPort-2,
+                                          "Application.LocalService", "square",
+                                          QVariantList() << 12, this);
+    QVERIFY(call->waitForDone());
+    QVERIFY(call->result() == QVariant(144));
+    QVERIFY(this->serverSocketCount(&server, local) == 1);
+    QVERIFY(this->serverSocketCount(&server, !local) == 0);
+    delete call;
+
+    // Without keep-alive, the connection must be closed once idle
+    const int keepAlive = GCF::IpcCall::keepAliveDuration();
+    GCF::IpcCall::setKeepAliveDuration(0);
+    QVERIFY(GCF::IpcCall::keepAliveDuration() == 0);
+
+    call = new GCF::IpcCall(QHostAddress::LocalHost, ::ServerPort-2,
+                            "Application.LocalService", "square",
+                            QVariantList() << 5, this);
+    QVERIFY(call->waitForDone());
+    QVERIFY(call->result() == QVariant(25));
+    delete call;
+
+    SPIN_WAIT(timer)
+    {
+        if(this->serverSocketCount(&server, local) == 0)
+            break;
+    }
+    QVERIFY(this->serverSocketCount(&server, local) == 0);
+
+    GCF::IpcCall::setKeepAliveDuration(keepAlive);
+    GCF::setIpcTransports(GCF::IpcAllTransports);
+    delete node;
+}
+
+void IpcTest::testLocalServerName()
+{
+    const quint16 port = quint16(::ServerPort-4);
+
+    GCF::IpcServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost, port));
+    QVERIFY(server.transports() & GCF::IpcLocalTransport);
+    const QString name = server.localServerName();
+    QVERIFY(!name.isEmpty());
+
+    // A server on the same port in the other address family must not take
+    // over the local socket of the first server
+    GCF::IpcServer server6;
+    if(server6.listen(QHostAddress::LocalHostIPv6, port))
+        QVERIFY(server6.localServerName() != name);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QVERIFY(socket.waitForConnected());
+    socket.abort();
+
+    server6.close();
+    server.close();
+
+    // A local socket that someone is listening on must be left alone
+    QLocalServer other;
+    QVERIFY(other.listen(name));
+
+    GCF::IpcServer server2;
+    QVERIFY(server2.listen(QHostAddress::LocalHost, port));
+    QVERIFY(server2.transports() == GCF::IpcTcpTransport);
+    QVERIFY(server2.localServerName().isEmpty());
+
+    socket.connectToServer(name);
+    QVERIFY(socket.waitForConnected());
+    socket.abort();
+    QVERIFY(other.isListening());
+}
+
+void IpcTest::testThreadSafeCalls()
+{
+    LocalService service;
+    QVariantMap serviceInfo;
+    serviceInfo["allowmetaaccess"] = true;
+    GCF::ObjectTreeNode *node = new GCF::ObjectTreeNode(gApp->objectTree()->rootNode(),
+                                                        "LocalService", &service,
+                                                        serviceInfo);
+
+    // Thread-safe methods must be run on a worker thread, and must still
+    // be able to return a value
+    QFuture<GCF::Result> future = gAppService->invokeMethodAsync(&service, "cube", QVariantList() << 3);
+    future.waitForFinished();
+    QVERIFY(future.result().isSuccess());
+    QVERIFY(future.result().data() == QVariant(27));
+    QVERIFY(service.cubeThread() != 0);
+    QVERIFY(service.cubeThread() != QThread::currentThread());
+
+    // The same must hold for calls that come in over IPC
+    service.resetCubeThread();
+    GCF::IpcServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost, ::ServerPort-5));
+
+    GCF::IpcCall *call = new GCF::IpcCall(QHostAddress::LocalHost, ::ServerPort-5,
+                                          "Application.LocalService", "cube",
+                                          QVariantList() << 4, this);
+    QVERIFY(call->waitForDone());
+    QVERIFY(call->isSuccess());
+    QVERIFY(call->result() == QVariant(64));
+    QVERIFY(service.cubeThread() != 0);
+    QVERIFY(service.cubeThread() != QThread::currentThread());
+    delete call;
+
+    delete node;
+}
+
+int IpcTest::serverSocketCount(GCF::IpcServer *server, bool local) const
+{
+    if(local)
+        return server->findChildren<QLocalSocket*>().count();
+    return server->findChildren<QTcpSocket*>().count();
+}
+
+void IpcTest::testCallAdmission()
+{
+    QElapsedTimer timer;
+
+    LocalService service;
+    QVariantMap serviceInfo;
+    serviceInfo["allowmetaaccess"] = true;
+    GCF::ObjectTreeNode *node = new GCF::ObjectTreeNode(gApp->objectTree()->rootNode(),
+                                                        "LocalService", &service,
+                                                        serviceInfo);
+
+    GCF::IpcServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost, ::ServerPort-3));
+
+    const QHostAddress addr = QHostAddress::LocalHost;
+    const quint16 port = quint16(::ServerPort-3);
+    QVERIFY(GCF::IpcCall::callLimit(addr, port) == GCF::IpcCall::defaultCallLimit());
+
+    GCF::IpcCall::setCallLimit(addr, port, 1);
+    QVERIFY(GCF::IpcCall::callLimit(addr, port) == 1);
+
+    // With a limit of 1, calls must be admitted one after the other in FIFO order
+    GCF::MultiSignalSpy spy;
+    QSignalSpy doneSpy(&spy, SIGNAL(caughtSignal(QObject*,QByteArray,QVariantList)));
+    QList<GCF::IpcCall*> calls;
+    for(int i=0; i<5; i++)
+    {
+        calls.append(new GCF::IpcCall(addr, port, "Application.LocalService", "square",
+                                      QVariantList() << i, this));
+        spy.connectSignal(calls.last(), SIGNAL(done(bool)));
+    }
+
+    SPIN_WAIT(timer)
+    {
+        if(doneSpy.count() == calls.count())
+            break;
+    }
+
+    QVERIFY(doneSpy.count() == calls.count());
+    for(int i=0; i<calls.count(); i++)
+    {
+        QVERIFY(doneSpy.at(i).first().value<QObject*>() == calls.at(i));
+        QVERIFY(calls.at(i)->isSuccess());
+        QVERIFY(calls.at(i)->queueWaitTime() >= 0);
+    }
+
+    QVariantMap metrics = GCF::IpcCall::callMetrics(addr, port);
+    QVERIFY(metrics.value("callLimit").toInt() == 1);
+    QVERIFY(metrics.value("activeCalls").toInt() == 0);
+    QVERIFY(metrics.value("queuedCalls").toInt() == 0);
+    QVERIFY(metrics.value("maxQueuedCalls").toInt() == calls.count()-1);
+    QVERIFY(metrics.value("admittedCalls").toInt() == calls.count());
+    QVERIFY(metrics.value("maxWaitTime").toLongLong() >= metrics.value("averageWaitTime").toDouble());
+
+    qDeleteAll(calls);
+
+    // Resetting the limit must bring back the default
+    GCF::IpcCall::setCallLimit(addr, port, 0);
+    QVERIFY(GCF::IpcCall::callLimit(addr, port) == GCF::IpcCall::defaultCallLimit());
+
+    delete node;
+}
+
 void IpcTest::killIpcServer()
 {
     QElapsedTimer timer;
@@ -118,6 +118,7 @@ private Q_SLOTS:
     void testChangeAndUpdatePropertyMethods_data();
     void testChangeAndUpdatePropertyMethods();
     void testChangeAndUpdatePropertyErrors();
+    void testPipelinedRequests();
     void testConnect();
     void testConnect2();
     void testConnectErrors();
@@ -413,6 +414,60 @@ void IpcRemoteObjectTest::testChangeAndUpdatePropertyErrors()
     QVERIFY(result.message() == "Receiver's member function's parameter list should be (QVariant,bool,QString).");
 }
 
+void IpcRemoteObjectTest::testPipelinedRequests()
+{
+    GCF::IpcRemoteObject remoteObject(QHostAddress::LocalHost, ::ServerPort, "Application.TestService");
+    GCF::SignalSpy spy(&remoteObject, SIGNAL(activated()));
+    spy.wait(::MaxSpinWaitTime);
+    QVERIFY(spy.count() == 1);
+
+    QVERIFY(remoteObject.requestWindow() == 16);
+    QVERIFY(remoteObject.outstandingRequestCount() == 0);
+
+    // Requests must be sent without waiting for responses, up to the window
+    const int requestCount = 50;
+    QList<QVariant> requestIds;
+    GCF::SignalSpy requestFinishedSpy(&remoteObject, SIGNAL(requestFinished(int)));
+    for(int i=0; i<requestCount; i++)
+    {
+        GCF::Result result = remoteObject.changeProperty("integer", i);
+        QVERIFY(result.isSuccess());
+        requestIds.append(result.data());
+    }
+    QVERIFY(remoteObject.outstandingRequestCount() == remoteObject.requestWindow());
+
+    while(requestFinishedSpy.count() < requestCount)
+    {
+        QVERIFY(remoteObject.outstandingRequestCount() <= remoteObject.requestWindow());
+        if(!requestFinishedSpy.wait(::MaxSpinWaitTime))
+            break;
+    }
+
+    // Responses must have been processed in the order of requests
+    QVERIFY(requestFinishedSpy.count() == requestCount);
+    for(int i=0; i<requestCount; i++)
+        QVERIFY(requestFinishedSpy.at(i).first() == requestIds.at(i));
+    QVERIFY(remoteObject.outstandingRequestCount() == 0);
+    QVERIFY(remoteObject.properties().value("integer") == QVariant(requestCount-1));
+
+    // With a window of 1, requests must be stop-and-wait
+    remoteObject.setRequestWindow(0);
+    QVERIFY(remoteObject.requestWindow() == 1);
+    requestFinishedSpy.clear();
+    for(int i=0; i<3; i++)
+        QVERIFY(remoteObject.updateProperty("integer").isSuccess());
+    QVERIFY(remoteObject.outstandingRequestCount() == 1);
+
+    while(requestFinishedSpy.count() < 3)
+    {
+        QVERIFY(remoteObject.outstandingRequestCount() <= 1);
+        if(!requestFinishedSpy.wait(::MaxSpinWaitTime))
+            break;
+    }
+    QVERIFY(requestFinishedSpy.count() == 3);
+    QVERIFY(remoteObject.outstandingRequestCount() == 0);
+}
+
 void IpcRemoteObjectTest::testConnect()
 {
     /*
@@ -0,0 +1,19 @@
+QT       += testlib network
+QT       -= gui
+
+TARGET = tst_IpcWireFormatTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+DESTDIR = $$PWD/../../../Binary/Tests/UnitTests
+include($$PWD/../../../QMakePRF/GCF3.prf)
+
+SOURCES += tst_IpcWireFormatTest.cpp
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
+
+# The wire format is private to GCFIpc, so it is compiled into the test
+DEFINES += GCF_IPC_STATIC_BUILD
+INCLUDEPATH += $$PWD/../../../Ipc
+HEADERS += $$PWD/../../../Ipc/IpcCommon_p.h $$PWD/../../../Ipc/IpcTrace.h
+SOURCES += $$PWD/../../../Ipc/IpcCommon_p.cpp $$PWD/../../../Ipc/IpcTrace.cpp
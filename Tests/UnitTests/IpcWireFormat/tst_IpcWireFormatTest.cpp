@@ -0,0 +1,816 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QString>
+#include <QtTest>
+#include <QTcpServer>
+#include <QLocalServer>
+#include <QElapsedTimer>
+
+#include <GCF3/SignalSpy>
+#include <GCF3/Version>
+
+#include "IpcCommon_p.h"
+#include "IpcTrace.h"
+
+class LoopbackServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    LoopbackServer(QObject *parent=0) : QTcpServer(parent), m_socket(0) { }
+    ~LoopbackServer() { }
+
+    GCF::IpcSocket *socket() const { return m_socket; }
+
+protected:
+#if QT_VERSION >= 0x050000
+    void incomingConnection(qintptr handle) {
+#else
+    void incomingConnection(int handle) {
+#endif
+        m_socket = new GCF::IpcSocket(this);
+        m_socket->setSocketDescriptor(handle);
+    }
+
+private:
+    GCF::IpcSocket *m_socket;
+};
+
+class LocalLoopbackServer : public QLocalServer
+{
+    Q_OBJECT
+
+public:
+    LocalLoopbackServer(QObject *parent=0) : QLocalServer(parent), m_socket(0) {
+        connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+    }
+    ~LocalLoopbackServer() { }
+
+    GCF::IpcSocket *socket() const { return m_socket; }
+
+private slots:
+    void onNewConnection() {
+        m_socket = new GCF::IpcSocket(this);
+        m_socket->setLocalSocket(this->nextPendingConnection());
+    }
+
+private:
+    GCF::IpcSocket *m_socket;
+};
+
+class IpcWireFormatTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    IpcWireFormatTest() { }
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void testCompactRoundTrip();
+    void testInterning();
+    void testLegacyMessagesAreNotCompact();
+    void testCorruptCompactMessage();
+    void testNegotiation();
+    void testLegacyOnlyNegotiation();
+    void testFrameBufferReuse();
+    void testBurstDelivery();
+    void testPartialLengthPrefix();
+    void testWrappedLegacyIds();
+    void testTrace();
+    void testLocalTransport();
+    void testLocalTransportFallback();
+    void testSharedMemoryTransport();
+    void testEncodedSizes();
+    void benchmarkEncoding_data();
+    void benchmarkEncoding();
+
+private:
+    QList<GCF::IpcMessage> sampleMessages() const;
+    bool exchange(GCF::IpcSocket *from, GCF::IpcSocket *to,
+                  const GCF::IpcMessage &message, GCF::IpcMessage *received);
+};
+
+void IpcWireFormatTest::initTestCase()
+{
+    qDebug("Running tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+    qRegisterMetaType<GCF::IpcMessage>("GCF::IpcMessage");
+}
+
+void IpcWireFormatTest::cleanupTestCase()
+{
+    qDebug("Executed tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+}
+
+QList<GCF::IpcMessage> IpcWireFormatTest::sampleMessages() const
+{
+    QList<GCF::IpcMessage> messages;
+
+    GCF::IpcMessage call(GCF::IpcMessage::IPC_CALL);
+    call.data()["object"] = QString("Application.TestService");
+    call.data()["method"] = QString("allParams");
+    call.data()["arguments"] = QVariantList() << 10 << true << 123.45 << QString("Hello")
+                                              << QStringList() << QVariant() << QVariantList()
+                                              << QVariantMap() << QByteArray(16, 'A');
+    call.data()["keepAlive"] = true;
+    messages << call;
+
+    GCF::IpcMessage callResponse(call.id(), GCF::IpcMessage::IPC_CALL);
+    callResponse.setResult( GCF::Result(true, QString(), QString(), QVariant(100)) );
+    messages << callResponse;
+
+    GCF::IpcMessage failedResponse(call.id(), GCF::IpcMessage::IPC_CALL);
+    failedResponse.setResult( GCF::Result(false, "E_BAD_FUNC", "Something went wrong here.") );
+    messages << failedResponse;
+
+    GCF::IpcMessage getProperty(GCF::IpcMessage::GET_PROPERTY_VALUE);
+    getProperty.data()["propertyName"] = QString("integer");
+    messages << getProperty;
+
+    GCF::IpcMessage setProperty(GCF::IpcMessage::SET_PROPERTY_VALUE);
+    setProperty.data()["propertyName"] = QString("string");
+    setProperty.data()["propertyValue"] = QString("Hello World");
+    messages << setProperty;
+
+    GCF::IpcMessage connection(GCF::IpcMessage::REQUEST_CONNECTION);
+    connection.data()["signal"] = QString("integerSignal(int)");
+    messages << connection;
+
+    GCF::IpcMessage connectionResponse(connection.id(), GCF::IpcMessage::REQUEST_CONNECTION);
+    connectionResponse.data()["signal"] = QByteArray("2integerSignal(int)");
+    connectionResponse.setResult(true);
+    messages << connectionResponse;
+
+    GCF::IpcMessage custom(QByteArray("F1AA0C35-629F-40A4-95D2-8FD046CBE290"));
+    custom.data()["customKey"] = QDate(2013, 8, 1);
+    messages << custom;
+
+    return messages;
+}
+
+void IpcWireFormatTest::testCompactRoundTrip()
+{
+    QList<GCF::IpcMessage> messages = this->sampleMessages();
+    GCF::IpcWireDictionary sendDictionary, receiveDictionary;
+
+    for(int i=0; i<messages.count(); i++)
+    {
+        const GCF::IpcMessage &message = messages.at(i);
+        QByteArray bytes = GCF::IpcMessage::toCompactByteArray(message, &sendDictionary);
+        QVERIFY(GCF::IpcMessage::isCompactByteArray(bytes));
+
+        GCF::IpcMessage decoded = GCF::IpcMessage::fromCompactByteArray(bytes, &receiveDictionary);
+        QVERIFY(decoded.isValid());
+        QVERIFY(decoded == message);
+    }
+
+    QVERIFY(sendDictionary.count() == receiveDictionary.count());
+}
+
+void IpcWireFormatTest::testInterning()
+{
+    GCF::IpcWireDictionary sendDictionary, receiveDictionary;
+
+    GCF::IpcMessage message(GCF::IpcMessage::IPC_CALL);
+    message.data()["object"] = QString("Application.TestService");
+    message.data()["method"] = QString("integer");
+    message.data()["arguments"] = QVariantList() << 10;
+
+    QByteArray first = GCF::IpcMessage::toCompactByteArray(message, &sendDictionary);
+    QByteArray second = GCF::IpcMessage::toCompactByteArray(message, &sendDictionary);
+    QVERIFY(sendDictionary.count() == 2);
+    QVERIFY(second.size() < first.size());
+
+    // Interned references can only be decoded after their definition has been seen
+    GCF::IpcWireDictionary emptyDictionary;
+    QVERIFY(GCF::IpcMessage::fromCompactByteArray(second, &emptyDictionary).isValid() == false);
+
+    QVERIFY(GCF::IpcMessage::fromCompactByteArray(first, &receiveDictionary) == message);
+    QVERIFY(GCF::IpcMessage::fromCompactByteArray(second, &receiveDictionary) == message);
+    QVERIFY(receiveDictionary.count() == 2);
+    QVERIFY(receiveDictionary.at(0) == "Application.TestService");
+}
+
+void IpcWireFormatTest::testLegacyMessagesAreNotCompact()
+{
+    QList<GCF::IpcMessage> messages = this->sampleMessages();
+    messages << GCF::IpcMessage();
+
+    Q_FOREACH(GCF::IpcMessage message, messages)
+    {
+        QByteArray bytes = message.toByteArray();
+        QVERIFY(GCF::IpcMessage::isCompactByteArray(bytes) == false);
+        QVERIFY(GCF::IpcMessage::fromByteArray(bytes) == message);
+    }
+}
+
+void IpcWireFormatTest::testCorruptCompactMessage()
+{
+    GCF::IpcMessage message = this->sampleMessages().first();
+    GCF::IpcWireDictionary sendDictionary;
+    QByteArray bytes = GCF::IpcMessage::toCompactByteArray(message, &sendDictionary);
+
+    for(int size=1; size<bytes.size(); size += 7)
+    {
+        GCF::IpcWireDictionary receiveDictionary;
+        GCF::IpcMessage decoded = GCF::IpcMessage::fromCompactByteArray(bytes.left(size), &receiveDictionary);
+        QVERIFY(decoded.isValid() == false);
+    }
+
+    // Opcodes from a future version of the format must be rejected
+    bytes[1] = char(0x7F);
+    GCF::IpcWireDictionary receiveDictionary;
+    QVERIFY(GCF::IpcMessage::fromCompactByteArray(bytes, &receiveDictionary).isValid() == false);
+}
+
+bool IpcWireFormatTest::exchange(GCF::IpcSocket *from, GCF::IpcSocket *to,
+                                 const GCF::IpcMessage &message, GCF::IpcMessage *received)
+{
+    GCF::SignalSpy spy(to, SIGNAL(incomingMessage(GCF::IpcMessage)));
+    from->sendMessage(message);
+    spy.wait();
+    if(spy.count() != 1)
+        return false;
+
+    *received = spy.first().first().value<GCF::IpcMessage>();
+    return true;
+}
+
+void IpcWireFormatTest::testNegotiation()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+    GCF::IpcSocket *serverSocket = server.socket();
+
+    QVERIFY(client.peerWireFormat() == GCF::IpcLegacyWireFormat);
+    QVERIFY(serverSocket->peerWireFormat() == GCF::IpcLegacyWireFormat);
+
+    // The first message is sent in the legacy format and advertises the compact format
+    GCF::IpcMessage request = this->sampleMessages().first();
+    GCF::IpcMessage received;
+    QVERIFY(this->exchange(&client, serverSocket, request, &received));
+    QVERIFY(received == request);
+    QVERIFY(received.data().contains("wireFormat") == false);
+    QVERIFY(serverSocket->peerWireFormat() == GCF::IpcCompactWireFormat);
+    QVERIFY(client.peerWireFormat() == GCF::IpcLegacyWireFormat);
+
+    // The response comes back in the compact format, which tells the client
+    // that it can use the compact format too.
+    GCF::IpcMessage response(request.id(), request.type());
+    response.setResult( GCF::Result(true, QString(), QString(), 100) );
+    QVERIFY(this->exchange(serverSocket, &client, response, &received));
+    QVERIFY(received == response);
+    QVERIFY(client.peerWireFormat() == GCF::IpcCompactWireFormat);
+
+    QList<GCF::IpcMessage> messages = this->sampleMessages();
+    Q_FOREACH(GCF::IpcMessage message, messages)
+    {
+        QVERIFY(this->exchange(&client, serverSocket, message, &received));
+        QVERIFY(received == message);
+        QVERIFY(this->exchange(serverSocket, &client, message, &received));
+        QVERIFY(received == message);
+    }
+}
+
+void IpcWireFormatTest::testLegacyOnlyNegotiation()
+{
+    GCF::setIpcWireFormat(GCF::IpcLegacyWireFormat);
+    QVERIFY(GCF::ipcWireFormat() == GCF::IpcLegacyWireFormat);
+
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+
+    QList<GCF::IpcMessage> messages = this->sampleMessages();
+    Q_FOREACH(GCF::IpcMessage message, messages)
+    {
+        GCF::IpcMessage received;
+        QVERIFY(this->exchange(&client, server.socket(), message, &received));
+        QVERIFY(received == message);
+        QVERIFY(this->exchange(server.socket(), &client, message, &received));
+        QVERIFY(received == message);
+    }
+
+    QVERIFY(client.peerWireFormat() == GCF::IpcLegacyWireFormat);
+    QVERIFY(server.socket()->peerWireFormat() == GCF::IpcLegacyWireFormat);
+
+    GCF::setIpcWireFormat(GCF::IpcCompactWireFormat);
+}
+
+void IpcWireFormatTest::testFrameBufferReuse()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+
+    // Send and receive buffers are reused across messages. Alternate between
+    // small messages and ones that are larger than what the buffers retain,
+    // so that stale bytes from a previous message would show up in the next.
+    GCF::IpcMessage small(GCF::IpcMessage::SET_PROPERTY_VALUE);
+    small.data()["propertyName"] = QString("string");
+    small.data()["propertyValue"] = QString("Hello World");
+
+    GCF::IpcMessage large(GCF::IpcMessage::SET_PROPERTY_VALUE);
+    large.data()["propertyName"] = QString("bytes");
+    large.data()["propertyValue"] = QByteArray(2*1024*1024, 'X');
+
+    QList<GCF::IpcMessage> messages;
+    messages << small << large << small << small << large << large << small;
+    Q_FOREACH(GCF::IpcMessage message, messages)
+    {
+        GCF::IpcMessage received;
+        QVERIFY(this->exchange(&client, server.socket(), message, &received));
+        QVERIFY(received == message);
+        QVERIFY(this->exchange(server.socket(), &client, message, &received));
+        QVERIFY(received == message);
+    }
+}
+
+void IpcWireFormatTest::testBurstDelivery()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+
+    // Send a burst of messages, large enough to exceed the number of messages
+    // processed per readyRead(), and make sure all of them arrive in order.
+    GCF::SignalSpy spy(server.socket(), SIGNAL(incomingMessage(GCF::IpcMessage)));
+    GCF::SignalSpy emptySpy(server.socket(), SIGNAL(readBufferEmpty()));
+
+    QList<GCF::IpcMessage> messages;
+    for(int i=0; i<500; i++)
+    {
+        GCF::IpcMessage message(GCF::IpcMessage::SET_PROPERTY_VALUE);
+        message.data()["propertyName"] = QString("integer");
+        message.data()["propertyValue"] = i;
+        messages << message;
+        client.sendMessage(message);
+    }
+    QVERIFY(client.waitForBytesWritten());
+
+    timer.restart();
+    while(spy.count() < messages.count() && !timer.hasExpired(10000))
+        qApp->processEvents();
+
+    QVERIFY(spy.count() == messages.count());
+    for(int i=0; i<messages.count(); i++)
+        QVERIFY(spy.at(i).first().value<GCF::IpcMessage>() == messages.at(i));
+
+    while(emptySpy.count() == 0 && !timer.hasExpired(10000))
+        qApp->processEvents();
+    QVERIFY(emptySpy.count() >= 1);
+    QVERIFY(server.socket()->bytesAvailable() == 0);
+}
+
+void IpcWireFormatTest::testPartialLengthPrefix()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+
+    GCF::IpcMessage message(GCF::IpcMessage::GET_PROPERTY_VALUE);
+    message.data()["propertyName"] = QString("integer");
+
+    QByteArray packet;
+    QDataStream ds(&packet, QIODevice::WriteOnly);
+    ds << message.toByteArray();
+    packet += packet; // Two messages back to back
+
+    // Deliver the packet in pieces that split the length prefixes
+    GCF::SignalSpy spy(server.socket(), SIGNAL(incomingMessage(GCF::IpcMessage)));
+    const int half = packet.size()/2;
+    QList<QByteArray> pieces;
+    pieces << packet.left(2) << packet.mid(2, half) << packet.mid(half+2, 1)
+           << packet.mid(half+3, 2) << packet.mid(half+5);
+    Q_FOREACH(QByteArray piece, pieces)
+    {
+        client.write(piece);
+        QVERIFY(client.waitForBytesWritten());
+
+        timer.restart();
+        while(!timer.hasExpired(100))
+            qApp->processEvents();
+    }
+
+    timer.restart();
+    while(spy.count() < 2 && !timer.hasExpired(5000))
+        qApp->processEvents();
+
+    QVERIFY(spy.count() == 2);
+    QVERIFY(spy.at(0).first().value<GCF::IpcMessage>() == message);
+    QVERIFY(spy.at(1).first().value<GCF::IpcMessage>() == message);
+}
+
+void IpcWireFormatTest::testWrappedLegacyIds()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+
+    // Once the id counter wraps, the first byte of a legacy message can be
+    // anything. Such messages must not be taken for control frames. (The
+    // compact format marker itself remains ambiguous, so it is left out.)
+    QList<GCF::IpcMessage> messages;
+    for(quint32 highByte=0x80; highByte<=0x85; highByte++)
+    {
+        if(highByte == GCF::IpcMessage::CompactFormatMarker)
+            continue;
+
+        GCF::IpcMessage message(qint32((highByte << 24) | 0x000001), GCF::IpcMessage::GET_PROPERTY_VALUE);
+        message.data()["propertyName"] = QString("integer");
+        messages << message;
+    }
+
+    QByteArray packet;
+    QDataStream ds(&packet, QIODevice::WriteOnly);
+    Q_FOREACH(GCF::IpcMessage message, messages)
+        ds << message.toByteArray();
+
+    GCF::SignalSpy spy(server.socket(), SIGNAL(incomingMessage(GCF::IpcMessage)));
+    client.write(packet);
+    QVERIFY(client.waitForBytesWritten());
+
+    timer.restart();
+    while(spy.count() < messages.count() && !timer.hasExpired(5000))
+        qApp->processEvents();
+
+    QVERIFY(server.socket()->state() == QAbstractSocket::ConnectedState);
+    QVERIFY(spy.count() == messages.count());
+    for(int i=0; i<messages.count(); i++)
+        QVERIFY(spy.at(i).first().value<GCF::IpcMessage>() == messages.at(i));
+}
+
+void IpcWireFormatTest::testTrace()
+{
+    QVERIFY(GCF::IpcTrace::isEnabled() == false);
+    QVERIFY(GCF::IpcTrace::capacity() == 1024);
+
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+    GCF::IpcSocket *serverSocket = server.socket();
+
+    // Nothing is recorded while tracing is disabled
+    GCF::IpcMessage request(GCF::IpcMessage::GET_PROPERTY_VALUE);
+    request.data()["propertyName"] = QString("integer");
+    GCF::IpcMessage received;
+    QVERIFY(this->exchange(&client, serverSocket, request, &received));
+    QVERIFY(GCF::IpcTrace::eventCount() == 0);
+
+    GCF::IpcTrace::setEnabled(true);
+
+    request = GCF::IpcMessage(GCF::IpcMessage::GET_PROPERTY_VALUE);
+    request.data()["propertyName"] = QString("integer");
+    QVERIFY(this->exchange(&client, serverSocket, request, &received));
+
+    GCF::IpcMessage response(request.id(), request.type());
+    response.setResult( GCF::Result(true, QString(), QString(), 10) );
+    QVERIFY(this->exchange(serverSocket, &client, response, &received));
+
+    // Both ends of the connection record events into the same buffer
+    QList<GCF::IpcTraceEvent> events = GCF::IpcTrace::events();
+    QVERIFY(events.count() == 4);
+
+    QVERIFY(events.at(0).EventType == GCF::IpcTraceEvent::MessageSent);
+    QVERIFY(events.at(1).EventType == GCF::IpcTraceEvent::MessageReceived);
+    QVERIFY(events.at(2).EventType == GCF::IpcTraceEvent::MessageSent);
+    QVERIFY(events.at(3).EventType == GCF::IpcTraceEvent::MessageReceived);
+    Q_FOREACH(GCF::IpcTraceEvent event, events)
+    {
+        QVERIFY(event.MessageId == request.id());
+        QVERIFY(event.MessageType == GCF::IpcMessage::GET_PROPERTY_VALUE);
+        QVERIFY(event.Size > 0);
+        QVERIFY(event.PeerAddress == QHostAddress(QHostAddress::LocalHost));
+        QVERIFY(event.Timestamp > 0);
+    }
+
+    QVERIFY(events.at(0).IsResponse == false && events.at(0).Latency == -1);
+    QVERIFY(events.at(0).PeerPort == server.serverPort());
+    QVERIFY(events.at(1).IsResponse == false && events.at(1).Latency == -1);
+    QVERIFY(events.at(2).IsResponse == true && events.at(2).Latency >= 0);
+    QVERIFY(events.at(3).IsResponse == true && events.at(3).Latency >= 0);
+
+    // Only the most recent events are retained
+    GCF::IpcTrace::setCapacity(3);
+    QVERIFY(GCF::IpcTrace::eventCount() == 3);
+    QVERIFY(GCF::IpcTrace::events().first().EventType == GCF::IpcTraceEvent::MessageReceived);
+    QVERIFY(GCF::IpcTrace::events().first().IsResponse == false);
+
+    for(int i=0; i<5; i++)
+        QVERIFY(this->exchange(&client, serverSocket, this->sampleMessages().first(), &received));
+    QVERIFY(GCF::IpcTrace::eventCount() == 3);
+    QVERIFY(GCF::IpcTrace::events().last().EventType == GCF::IpcTraceEvent::MessageReceived);
+    QVERIFY(GCF::IpcTrace::events().last().MessageType == GCF::IpcMessage::IPC_CALL);
+
+    GCF::IpcTrace::clear();
+    QVERIFY(GCF::IpcTrace::eventCount() == 0);
+
+    GCF::IpcTrace::setEnabled(false);
+    GCF::IpcTrace::setCapacity(1024);
+    QVERIFY(this->exchange(&client, serverSocket, request, &received));
+    QVERIFY(GCF::IpcTrace::eventCount() == 0);
+}
+
+void IpcWireFormatTest::testLocalTransport()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    const QString localName = GCF::ipcLocalServerName(QHostAddress::LocalHost, server.serverPort());
+    QLocalServer::removeServer(localName);
+    LocalLoopbackServer localServer;
+    QVERIFY(localServer.listen(localName));
+
+    // Connections to this host should go through the local socket
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+    QVERIFY(client.transport() == GCF::IpcLocalTransport);
+    QVERIFY(client.state() == QAbstractSocket::ConnectedState);
+    QVERIFY(client.peerAddress() == QHostAddress(QHostAddress::LocalHost));
+    QVERIFY(client.peerPort() == server.serverPort());
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!localServer.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(localServer.socket() != 0);
+    QVERIFY(localServer.socket()->transport() == GCF::IpcLocalTransport);
+    QVERIFY(server.socket() == 0);
+
+    QList<GCF::IpcMessage> messages = this->sampleMessages();
+    Q_FOREACH(GCF::IpcMessage message, messages)
+    {
+        GCF::IpcMessage received;
+        QVERIFY(this->exchange(&client, localServer.socket(), message, &received));
+        QVERIFY(received == message);
+        QVERIFY(this->exchange(localServer.socket(), &client, message, &received));
+        QVERIFY(received == message);
+    }
+
+    // Disconnecting one end should be noticed at the other end
+    GCF::SignalSpy spy(localServer.socket(), SIGNAL(disconnected()));
+    client.disconnectFromHost();
+    spy.wait();
+    QVERIFY(spy.count() == 1);
+}
+
+void IpcWireFormatTest::testLocalTransportFallback()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QVERIFY(GCF::ipcPeerTransports(QHostAddress::LocalHost, server.serverPort()) == 0);
+
+    // Nobody is listening on the local socket, so TCP should be used.
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+    QVERIFY(client.transport() == GCF::IpcTcpTransport);
+    QVERIFY(GCF::ipcPeerTransports(QHostAddress::LocalHost, server.serverPort()) == GCF::IpcTcpTransport);
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!server.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(server.socket() != 0);
+
+    GCF::IpcMessage received;
+    GCF::IpcMessage message = this->sampleMessages().first();
+    QVERIFY(this->exchange(&client, server.socket(), message, &received));
+    QVERIFY(received == message);
+
+    // Local sockets are not used when the transport is disabled
+    LoopbackServer server2;
+    QVERIFY(server2.listen(QHostAddress::LocalHost));
+
+    const QString localName = GCF::ipcLocalServerName(QHostAddress::LocalHost, server2.serverPort());
+    QLocalServer::removeServer(localName);
+    LocalLoopbackServer localServer;
+    QVERIFY(localServer.listen(localName));
+
+    GCF::setIpcTransports(GCF::IpcTcpTransport);
+    QVERIFY(GCF::ipcTransports() == GCF::IpcTcpTransport);
+
+    GCF::IpcSocket client2;
+    client2.connectToHost(QHostAddress::LocalHost, server2.serverPort());
+    QVERIFY(client2.waitForConnected());
+    QVERIFY(client2.transport() == GCF::IpcTcpTransport);
+
+    GCF::setIpcTransports(GCF::IpcAllTransports);
+    QVERIFY(GCF::ipcTransports() == GCF::IpcAllTransports);
+}
+
+void IpcWireFormatTest::testSharedMemoryTransport()
+{
+    LoopbackServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    const QString localName = GCF::ipcLocalServerName(QHostAddress::LocalHost, server.serverPort());
+    QLocalServer::removeServer(localName);
+    LocalLoopbackServer localServer;
+    QVERIFY(localServer.listen(localName));
+
+    GCF::IpcSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+    QVERIFY(client.transport() == GCF::IpcLocalTransport);
+
+    QElapsedTimer timer;
+    timer.start();
+    while(!localServer.socket() && !timer.hasExpired(5000))
+        qApp->processEvents();
+    QVERIFY(localServer.socket() != 0);
+    GCF::IpcSocket *serverSocket = localServer.socket();
+
+    // Support for shared memory is advertised with the first message
+    QVERIFY(client.isUsingSharedMemory() == false);
+    GCF::IpcMessage received;
+    GCF::IpcMessage message = this->sampleMessages().first();
+    QVERIFY(this->exchange(&client, serverSocket, message, &received));
+    QVERIFY(received == message);
+    QVERIFY(received.data().contains("sharedMemory") == false);
+    QVERIFY(serverSocket->isUsingSharedMemory());
+    QVERIFY(this->exchange(serverSocket, &client, message, &received));
+    QVERIFY(received == message);
+    QVERIFY(client.isUsingSharedMemory());
+
+    // Large messages go through shared memory. Send enough of them for the
+    // ring buffer to wrap around a few times.
+    GCF::IpcMessage large(GCF::IpcMessage::SET_PROPERTY_VALUE);
+    large.data()["propertyName"] = QString("bytes");
+    for(int i=0; i<20; i++)
+    {
+        large.data()["propertyValue"] = QByteArray(1024*1024 + i*4096, char('A'+i));
+        QVERIFY(this->exchange(&client, serverSocket, large, &received));
+        QVERIFY(received == large);
+        QVERIFY(this->exchange(serverSocket, &client, large, &received));
+        QVERIFY(received == large);
+    }
+
+    // When messages are sent faster than they are read, the ones that dont fit
+    // into shared memory are sent over the socket. They should still arrive in order.
+    GCF::SignalSpy spy(serverSocket, SIGNAL(incomingMessage(GCF::IpcMessage)));
+    QList<GCF::IpcMessage> messages;
+    for(int i=0; i<16; i++)
+    {
+        GCF::IpcMessage message(GCF::IpcMessage::SET_PROPERTY_VALUE);
+        message.data()["propertyName"] = QString("bytes");
+        message.data()["propertyValue"] = QByteArray(1024*1024, char('a'+i));
+        messages << message;
+        client.sendMessage(message);
+    }
+
+    timer.restart();
+    while(spy.count() < messages.count() && !timer.hasExpired(20000))
+        qApp->processEvents();
+
+    QVERIFY(spy.count() == messages.count());
+    for(int i=0; i<messages.count(); i++)
+        QVERIFY(spy.at(i).first().value<GCF::IpcMessage>() == messages.at(i));
+}
+
+void IpcWireFormatTest::testEncodedSizes()
+{
+    QList<GCF::IpcMessage> messages = this->sampleMessages();
+    GCF::IpcWireDictionary dictionary;
+
+    // Second pass measures messages whose names have already been interned
+    for(int pass=0; pass<2; pass++)
+    {
+        int legacySize = 0;
+        int compactSize = 0;
+        Q_FOREACH(GCF::IpcMessage message, messages)
+        {
+            const int legacy = message.toByteArray().size();
+            const int compact = GCF::IpcMessage::toCompactByteArray(message, &dictionary).size();
+            QVERIFY(compact < legacy);
+            legacySize += legacy;
+            compactSize += compact;
+        }
+
+        qDebug("Pass %d: legacy format %d bytes, compact format %d bytes (%.1f%%)",
+               pass+1, legacySize, compactSize, 100.0*double(compactSize)/double(legacySize));
+    }
+}
+
+void IpcWireFormatTest::benchmarkEncoding_data()
+{
+    QTest::addColumn<bool>("compact");
+
+    QTest::newRow("legacy") << false;
+    QTest::newRow("compact") << true;
+}
+
+void IpcWireFormatTest::benchmarkEncoding()
+{
+    QFETCH(bool, compact);
+
+    QList<GCF::IpcMessage> messages = this->sampleMessages();
+    GCF::IpcWireDictionary sendDictionary, receiveDictionary;
+
+    QBENCHMARK
+    {
+        Q_FOREACH(GCF::IpcMessage message, messages)
+        {
+            if(compact)
+            {
+                QByteArray bytes = GCF::IpcMessage::toCompactByteArray(message, &sendDictionary);
+                GCF::IpcMessage::fromCompactByteArray(bytes, &receiveDictionary);
+            }
+            else
+            {
+                QByteArray bytes = message.toByteArray();
+                GCF::IpcMessage::fromByteArray(bytes);
+            }
+        }
+    }
+}
+
+QTEST_MAIN(IpcWireFormatTest)
+
+#include "tst_IpcWireFormatTest.moc"
@@ -20,12 +20,15 @@
 #include <QtTest>
 #include <QIcon>
 #include <QVariant>
+#include <QThread>
+#include <QThreadPool>
 
 #include <GCF3/Version>
 #include <GCF3/GuiApplication>
 #include <GCF3/Log>
 #include <GCF3/SignalSpy>
 #include <GCF3/AbstractJob>
+#include <GCF3/ThreadedJob>
 
 class JobTest;
 
@@ -76,6 +79,45 @@ private:
     int m_duration;
 };
 
+class CountingJob : public GCF::ThreadedJob
+{
+    Q_OBJECT
+
+public:
+    CountingJob(int count, QObject *parent=0)
+        : GCF::ThreadedJob("Counting", parent),
+          m_count(count), m_counter(0), m_thread(0) { }
+    ~CountingJob() { this->wait(); }
+
+    void setFailure(const QString &msg) { m_failure = msg; }
+    int counter() const { return m_counter.load(); }
+    QThread *runThread() const { return m_thread; }
+
+protected:
+    GCF::Result run() {
+        m_thread = QThread::currentThread();
+        m_counter.store(0);
+        for(int i=0; i<m_count; i++) {
+            if(!this->checkpoint())
+                return false;
+            m_counter.ref();
+            this->reportProgress(i*100/m_count);
+            QThread::msleep(1);
+        }
+
+        if(!m_failure.isEmpty())
+            return GCF::Result(false, QString(), m_failure);
+
+        return true;
+    }
+
+private:
+    int m_count;
+    QAtomicInt m_counter;
+    QThread *m_thread;
+    QString m_failure;
+};
+
 class JobTest : public QObject
 {
     Q_OBJECT
@@ -95,6 +137,9 @@ private Q_SLOTS:
     void testSuspendAndResume();
     void testCancel();
     void testRetry();
+    void testUpdateThrottling();
+    void testThreadedJob();
+    void testThreadedJobSuspendAndCancel();
 };
 
 JobTest::JobTest()
@@ -511,6 +556,116 @@ void JobTest::testRetry()
     // The previous test case will fail if retry() did not work.
 }
 
+void JobTest::testUpdateThrottling()
+{
+    SimpleJob *job = new SimpleJob;
+    job->setDuration(10000);
+    QVERIFY(job->updateRate() == 0);
+
+    GCF::SignalSpy rateSpy(job, SIGNAL(updateRateChanged(GCF::AbstractJob*)));
+    job->setUpdateRate(10);
+    QVERIFY(job->updateRate() == 10);
+    QVERIFY(rateSpy.count() == 1);
+
+    QVERIFY(job->start().isSuccess() == true);
+    GCF::SignalSpy updatedSpy(job, SIGNAL(updated(GCF::AbstractJob*)));
+
+    // Progress reported right after start must be coalesced
+    for(int i=0; i<100; i++)
+        job->setProgress(i);
+    QVERIFY(updatedSpy.count() == 0);
+
+    QTest::qWait(200);
+    QVERIFY(updatedSpy.count() == 1);
+    QVERIFY(job->progress() == 99);
+    updatedSpy.clear();
+
+    // Completion must be reported right away, even when updates are pending
+    job->setProgress(50);
+    job->setProgress(60);
+    job->done();
+    QVERIFY(updatedSpy.count() >= 1);
+    QVERIFY(job->isComplete() == true);
+
+    const int count = updatedSpy.count();
+    QTest::qWait(200);
+    QVERIFY(updatedSpy.count() == count);
+
+    delete job;
+
+    // Jobs created after setting the default rate must have that rate
+    GCF::AbstractJob::setDefaultUpdateRate(5);
+    job = new SimpleJob;
+    QVERIFY(job->updateRate() == 5);
+    delete job;
+    GCF::AbstractJob::setDefaultUpdateRate(0);
+    QVERIFY(GCF::AbstractJob::defaultUpdateRate() == 0);
+}
+
+void JobTest::testThreadedJob()
+{
+    CountingJob *job = new CountingJob(20);
+    GCF::SignalSpy completedSpy(job, SIGNAL(completed(GCF::AbstractJob*)));
+    QVERIFY(job->threadPool() == QThreadPool::globalInstance());
+
+    QVERIFY(job->start().isSuccess());
+    QVERIFY(job->isRunning());
+    QVERIFY(completedSpy.wait());
+    QVERIFY(job->isComplete());
+    QVERIFY(job->progress() == 100);
+    QVERIFY(job->hasError() == false);
+    QVERIFY(job->counter() == 20);
+    QVERIFY(job->runThread() != 0);
+    QVERIFY(job->runThread() != QThread::currentThread());
+
+    // Failure of run() must abort the job
+    job->setFailure("Could not count");
+    completedSpy.clear();
+    QVERIFY(job->retry().isSuccess());
+    QVERIFY(completedSpy.wait());
+    QVERIFY(job->isComplete());
+    QVERIFY(job->hasError());
+    QVERIFY(job->error() == "Could not count");
+
+    delete job;
+}
+
+void JobTest::testThreadedJobSuspendAndCancel()
+{
+    CountingJob *job = new CountingJob(100000);
+    GCF::SignalSpy completedSpy(job, SIGNAL(completed(GCF::AbstractJob*)));
+
+    job->start();
+    QTest::qWait(50);
+    QVERIFY(job->suspend().isSuccess());
+    QVERIFY(job->isSuspended());
+
+    // run() must block at its next checkpoint
+    QTest::qWait(50);
+    const int counter = job->counter();
+    QTest::qWait(50);
+    QVERIFY(job->counter() == counter);
+
+    QVERIFY(job->resume().isSuccess());
+    QTest::qWait(50);
+    QVERIFY(job->counter() > counter);
+
+    // Cancelled jobs complete right away; run() returns soon after
+    QVERIFY(job->cancel().isSuccess());
+    QVERIFY(job->isComplete());
+    QVERIFY(job->error() == "Cancelled");
+    QVERIFY(completedSpy.count() == 1);
+    QVERIFY(job->wait(5000));
+    QVERIFY(job->counter() < 100000);
+
+    // Whatever the cancelled run() returned must be ignored
+    QTest::qWait(50);
+    QVERIFY(completedSpy.count() == 1);
+    QVERIFY(job->error() == "Cancelled");
+
+    delete job;
+}
+
 int main(int argc, char *argv[])
 {
     GCF::GuiApplication app(argc, argv);
@@ -0,0 +1,370 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QString>
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <GCF3/Version>
+#include <GCF3/GuiApplication>
+#include <GCF3/Log>
+#include <GCF3/SignalSpy>
+#include <GCF3/AbstractJob>
+#include <GCF3/JobJournal>
+
+class TransferJob : public GCF::AbstractJob
+{
+    Q_OBJECT
+
+public:
+    TransferJob(qint64 size=0, QObject *parent=0)
+        : GCF::AbstractJob("Transfer", parent),
+          m_offset(0), m_size(size) { }
+
+    qint64 offset() const { return m_offset; }
+    qint64 size() const { return m_size; }
+
+    void advance(qint64 bytes) {
+        m_offset = qMin(m_offset+bytes, m_size);
+        this->setProgress( int(m_offset*100/m_size) );
+        if(m_offset == m_size)
+            this->done();
+    }
+
+    QVariantMap saveState() const {
+        QVariantMap state;
+        state["offset"] = m_offset;
+        state["size"] = m_size;
+        return state;
+    }
+
+    bool restoreState(const QVariantMap &state) {
+        if(!state.contains("size"))
+            return false;
+        m_offset = state.value("offset").toLongLong();
+        m_size = state.value("size").toLongLong();
+        return true;
+    }
+
+protected:
+    GCF::Result startJob() { return true; }
+    GCF::Result cancelJob() { return true; }
+    GCF::Result suspendJob() { return true; }
+    GCF::Result resumeJob() { return true; }
+
+private:
+    qint64 m_offset;
+    qint64 m_size;
+};
+
+class JobJournalTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    JobJournalTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void testJournal();
+    void testSaveInterval();
+    void testIncompleteRecord();
+    void testForeignFile();
+    void testInterruptedCompaction();
+    void testModelDestruction();
+
+private:
+    QString journalFileName() const {
+        return QDir::tempPath() + "/tst_JobJournalTest.journal";
+    }
+    TransferJob *findJob(const QList<GCF::AbstractJob*> &jobs, qint64 offset) const {
+        Q_FOREACH(GCF::AbstractJob *job, jobs) {
+            TransferJob *transferJob = qobject_cast<TransferJob*>(job);
+            if(transferJob && transferJob->offset() == offset)
+                return transferJob;
+        }
+        return 0;
+    }
+};
+
+JobJournalTest::JobJournalTest()
+{
+}
+
+void JobJournalTest::initTestCase()
+{
+    qDebug("Running tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+    QFile::remove(this->journalFileName());
+}
+
+void JobJournalTest::cleanupTestCase()
+{
+    qDebug("Executed tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+}
+
+void JobJournalTest::cleanup()
+{
+    QFile::remove( GCF::Log::instance()->logFileName() );
+    QFile::remove(this->journalFileName());
+    QFile::remove(this->journalFileName() + ".tmp");
+    QFile::remove(this->journalFileName() + ".bak");
+}
+
+void JobJournalTest::testJournal()
+{
+    // First session: one running and one suspended job
+    GCF::JobJournal *journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->jobListModel() == gAppService->jobs());
+    QVERIFY(journal->journaledJobCount() == 0);
+
+    TransferJob *job1 = new TransferJob(1000);
+    QVERIFY(journal->isJournaled(job1) == false);
+    job1->start();
+    QVERIFY(journal->isJournaled(job1));
+    job1->advance(300);
+    QVERIFY(journal->saveJob(job1));
+
+    TransferJob *job2 = new TransferJob(2000);
+    job2->start();
+    job2->advance(500);
+    job2->suspend();
+    QVERIFY(journal->isJournaled(job2));
+
+    // Completed jobs are removed from the journal
+    TransferJob *job3 = new TransferJob(100);
+    job3->start();
+    QVERIFY(journal->journaledJobCount() == 3);
+    job3->advance(100);
+    QVERIFY(job3->isComplete());
+    QVERIFY(journal->isJournaled(job3) == false);
+    QVERIFY(journal->journaledJobCount() == 2);
+
+    delete job1;
+    delete job2;
+    delete job3;
+    QVERIFY(journal->journaledJobCount() == 2);
+    delete journal;
+
+    // Second session: jobs are restored only if their kind is registered
+    journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->journaledJobCount() == 2);
+    QVERIFY(journal->restoreJobs().isEmpty());
+    QVERIFY(journal->journaledJobCount() == 2);
+
+    journal->registerJobKind<TransferJob>("Transfer");
+    QVERIFY(journal->isJobKindRegistered("Transfer"));
+    QList<GCF::AbstractJob*> jobs = journal->restoreJobs();
+    QVERIFY(jobs.count() == 2);
+
+    job1 = this->findJob(jobs, 300);
+    QVERIFY(job1 != 0);
+    QVERIFY(job1->size() == 1000);
+    QVERIFY(job1->isRunning());
+    QVERIFY(gAppService->jobs()->containsJob(job1));
+
+    job2 = this->findJob(jobs, 500);
+    QVERIFY(job2 != 0);
+    QVERIFY(job2->size() == 2000);
+    QVERIFY(job2->isStarted() == false);
+
+    // Jobs must not be restored twice
+    QVERIFY(journal->restoreJobs().isEmpty());
+
+    job1->advance(700);
+    QVERIFY(journal->journaledJobCount() == 1);
+    job2->start();
+    job2->cancel();
+    QVERIFY(journal->journaledJobCount() == 0);
+
+    delete job1;
+    delete job2;
+    delete journal;
+
+    journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->journaledJobCount() == 0);
+    delete journal;
+}
+
+void JobJournalTest::testSaveInterval()
+{
+    GCF::JobJournal *journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->saveInterval() == 1000);
+
+    // Updates within the interval are not saved
+    TransferJob *job = new TransferJob(1000);
+    job->start();
+    job->advance(100);
+    delete job;
+    delete journal;
+
+    journal = new GCF::JobJournal(this->journalFileName());
+    journal->registerJobKind<TransferJob>("Transfer");
+    QList<GCF::AbstractJob*> jobs = journal->restoreJobs();
+    QVERIFY(jobs.count() == 1);
+    QVERIFY(this->findJob(jobs, 0) != 0);
+
+    // Every update is saved without an interval
+    journal->setSaveInterval(0);
+    job = this->findJob(jobs, 0);
+    job->advance(400);
+    delete job;
+    delete journal;
+
+    journal = new GCF::JobJournal(this->journalFileName());
+    journal->registerJobKind<TransferJob>("Transfer");
+    jobs = journal->restoreJobs();
+    QVERIFY(jobs.count() == 1);
+    QVERIFY(this->findJob(jobs, 400) != 0);
+    qDeleteAll(jobs);
+    delete journal;
+}
+
+void JobJournalTest::testIncompleteRecord()
+{
+    GCF::JobJournal *journal = new GCF::JobJournal(this->journalFileName());
+    TransferJob *job = new TransferJob(1000);
+    job->start();
+    delete job;
+    delete journal;
+
+    // Simulate a record that was only partially written
+    QFile file(this->journalFileName());
+    QVERIFY(file.open(QFile::Append));
+    QDataStream ds(&file);
+    ds << quint32(100);
+    file.write("partial");
+    file.close();
+
+    const qint64 partialSize = QFileInfo(this->journalFileName()).size();
+    journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->journaledJobCount() == 1);
+    QVERIFY(QFileInfo(this->journalFileName()).size() < partialSize);
+
+    // Records written after the incomplete one must not be lost
+    job = new TransferJob(2000);
+    job->start();
+    delete job;
+    delete journal;
+
+    journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->journaledJobCount() == 2);
+    journal->registerJobKind<TransferJob>("Transfer");
+    QList<GCF::AbstractJob*> jobs = journal->restoreJobs();
+    QVERIFY(jobs.count() == 2);
+    qDeleteAll(jobs);
+    delete journal;
+}
+
+void JobJournalTest::testForeignFile()
+{
+    QFile file(this->journalFileName());
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("This is not a job journal");
+    file.close();
+
+    // Files that are not journals must be left untouched
+    GCF::JobJournal *journal = new GCF::JobJournal(this->journalFileName());
+    TransferJob *job = new TransferJob(1000);
+    job->start();
+    QVERIFY(!journal->isJournaled(job));
+    QVERIFY(!journal->compact().isSuccess());
+    delete job;
+    delete journal;
+
+    QVERIFY(file.open(QFile::ReadOnly));
+    QVERIFY(file.readAll() == "This is not a job journal");
+    file.close();
+}
+
+void JobJournalTest::testInterruptedCompaction()
+{
+    GCF::JobJournal *journal = new GCF::JobJournal(this->journalFileName());
+    TransferJob *job = new TransferJob(1000);
+    job->start();
+    delete job;
+    delete journal;
+
+    // Simulate a crash after the journal was moved aside, but before
+    // the compacted file took its place
+    QVERIFY(QFile::copy(this->journalFileName(), this->journalFileName() + ".tmp"));
+    QVERIFY(QFile::rename(this->journalFileName(), this->journalFileName() + ".bak"));
+
+    journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->journaledJobCount() == 1);
+    QVERIFY(QFile::exists(this->journalFileName()));
+    QVERIFY(!QFile::exists(this->journalFileName() + ".tmp"));
+    QVERIFY(!QFile::exists(this->journalFileName() + ".bak"));
+    delete journal;
+
+    // Without the temporary file, the journal that was moved aside is used
+    QVERIFY(QFile::rename(this->journalFileName(), this->journalFileName() + ".bak"));
+    journal = new GCF::JobJournal(this->journalFileName());
+    QVERIFY(journal->journaledJobCount() == 1);
+    QVERIFY(!QFile::exists(this->journalFileName() + ".bak"));
+    delete journal;
+}
+
+void JobJournalTest::testModelDestruction()
+{
+    // A model cancels its jobs when it is destroyed, as gAppService->jobs()
+    // does when the application quits. Such jobs must remain in the journal.
+    GCF::JobListModel *model = new GCF::JobListModel;
+    GCF::JobJournal *journal = new GCF::JobJournal(this->journalFileName(), model);
+
+    TransferJob *job = new TransferJob(1000);
+    QVERIFY(model->addJob(job));
+    job->start();
+    job->advance(300); // Within the save interval, so not saved yet
+    QVERIFY(journal->isJournaled(job));
+
+    delete model;
+    QVERIFY(job->isComplete());
+    QVERIFY(journal->journaledJobCount() == 1);
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+    delete journal;
+
+    journal = new GCF::JobJournal(this->journalFileName());
+    journal->registerJobKind<TransferJob>("Transfer");
+    QList<GCF::AbstractJob*> jobs = journal->restoreJobs();
+    QVERIFY(jobs.count() == 1);
+
+    TransferJob *restored = this->findJob(jobs, 300);
+    QVERIFY(restored != 0);
+    QVERIFY(restored->size() == 1000);
+    QVERIFY(restored->isRunning());
+    qDeleteAll(jobs);
+    delete journal;
+}
+
+int main(int argc, char *argv[])
+{
+    GCF::GuiApplication app(argc, argv);
+    JobJournalTest tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+#include "tst_JobJournalTest.moc"
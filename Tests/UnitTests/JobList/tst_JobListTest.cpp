@@ -107,6 +107,8 @@ private Q_SLOTS:
     void testSignals();
     void testGlobalJobsList();
     void testAddJobOrder();
+    void testJobUpdates();
+    void testRolesForRange();
 };
 
 JobListTest::JobListTest()
@@ -421,6 +423,109 @@ void JobListTest::testAddJobOrder()
     jobList.clearCompletedJobs();
 }
 
+void JobListTest::testJobUpdates()
+{
+    GCF::JobListModel jobList;
+    GCF::SignalSpy dataChangedSpy(&jobList, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+    GCF::SignalSpy allCompleteSpy(&jobList, SIGNAL(allJobsComplete()));
+
+    QList<SimpleJob*> jobs;
+    for(int i=0; i<5; i++)
+    {
+        SimpleJob *job = new SimpleJob(&jobList);
+        job->setDuration(10000);
+        jobList.addJob(job);
+        job->start();
+        jobs.append(job);
+    }
+    for(int i=0; i<jobs.count(); i++)
+        QVERIFY(jobList.indexOfJob(jobs.at(i)) == jobs.count()-i-1);
+    QTest::qWait(100);
+    dataChangedSpy.clear();
+
+    // Updates must be coalesced into a single dataChanged() signal
+    for(int p=0; p<100; p++)
+    {
+        for(int i=0; i<jobs.count(); i++)
+            jobs.at(i)->setProgress(p);
+    }
+    QVERIFY(dataChangedSpy.count() == 0);
+    QTest::qWait(100);
+    QVERIFY(dataChangedSpy.count() == 1);
+    QVERIFY(dataChangedSpy.last().at(0).value<QModelIndex>().row() == 0);
+    QVERIFY(dataChangedSpy.last().at(1).value<QModelIndex>().row() == jobs.count()-1);
+    QVERIFY(allCompleteSpy.count() == 0);
+
+    // Removing a job must update rows of other jobs
+    SimpleJob *removedJob = jobs.takeAt(2);
+    delete removedJob;
+    QTest::qWait(10);
+    QVERIFY(jobList.jobCount() == jobs.count());
+    QVERIFY(jobList.containsJob(removedJob) == false);
+    QVERIFY(jobList.indexOfJob(removedJob) == -1);
+    for(int i=0; i<jobs.count(); i++)
+        QVERIFY(jobList.jobAt(jobList.indexOfJob(jobs.at(i))) == jobs.at(i));
+
+    // allJobsComplete() must be emitted only after the last job completes
+    for(int i=0; i<jobs.count(); i++)
+    {
+        jobs.at(i)->done();
+        QVERIFY(allCompleteSpy.count() == (i == jobs.count()-1 ? 1 : 0));
+    }
+}
+
+void JobListTest::testRolesForRange()
+{
+    GCF::JobListModel jobList;
+
+    QList<SimpleJob*> jobs;
+    for(int i=0; i<3; i++)
+    {
+        SimpleJob *job = new SimpleJob(&jobList);
+        job->setDuration(10000);
+        job->setTitle( QString("Job %1").arg(i) );
+        jobList.addJob(job);
+        jobs.prepend(job);
+    }
+
+    jobs.at(1)->start();
+    jobs.at(1)->setProgress(40, "Working");
+
+    // data() must reflect updates reported by the job right away
+    QModelIndex index = jobList.index(1, 0);
+    QVERIFY(jobList.data(index, GCF::JobListModel::Progress).toInt() == 40);
+    QVERIFY(jobList.data(index, GCF::JobListModel::Status).toString() == "Working");
+    QVERIFY(jobList.data(index, GCF::JobListModel::IsRunning).toBool() == true);
+    QVERIFY(jobList.data(jobList.index(5, 0), GCF::JobListModel::Title).isNull());
+
+    QVariantList rows = jobList.rolesForRange(0, 2);
+    QVERIFY(rows.count() == 3);
+    for(int i=0; i<rows.count(); i++)
+    {
+        QVariantMap row = rows.at(i).toMap();
+        QVERIFY(row.value("jobTitle").toString() == jobs.at(i)->title());
+        QVERIFY(row.value("jobKind").toString() == "Simple");
+        QVERIFY(row.contains("jobObject") == false);
+        QVERIFY(row.value("jobIsStarted").toBool() == (i == 1));
+    }
+
+    QList<int> roles;
+    roles << GCF::JobListModel::Progress << GCF::JobListModel::Object;
+    rows = jobList.rolesForRange(1, 10, roles);
+    QVERIFY(rows.count() == 2);
+    QVERIFY(rows.first().toMap().count() == 2);
+    QVERIFY(rows.first().toMap().value("jobProgress").toInt() == 40);
+    QVERIFY(rows.first().toMap().value("jobObject").value<QObject*>() == jobs.at(1));
+    QVERIFY(jobList.rolesForRange(2, 1).isEmpty());
+
+    // Removed jobs must not leave stale rows behind
+    delete jobs.takeAt(0);
+    QTest::qWait(10);
+    rows = jobList.rolesForRange(0, 10);
+    QVERIFY(rows.count() == 2);
+    QVERIFY(rows.first().toMap().value("jobProgress").toInt() == 40);
+}
+
 int main(int argc, char *argv[])
 {
     GCF::GuiApplication app(argc, argv);
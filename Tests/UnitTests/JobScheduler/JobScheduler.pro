@@ -0,0 +1,12 @@
+QT       += testlib gui
+
+TARGET = tst_JobSchedulerTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+DESTDIR = $$PWD/../../../Binary/Tests/UnitTests
+include($$PWD/../../../QMakePRF/GCFGui3.prf)
+
+SOURCES += tst_JobSchedulerTest.cpp
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
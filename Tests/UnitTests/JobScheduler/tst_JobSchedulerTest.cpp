@@ -0,0 +1,313 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QString>
+#include <QtTest>
+
+#include <GCF3/Version>
+#include <GCF3/GuiApplication>
+#include <GCF3/Log>
+#include <GCF3/SignalSpy>
+#include <GCF3/AbstractJob>
+#include <GCF3/JobScheduler>
+
+class SimpleJob : public GCF::AbstractJob
+{
+    Q_OBJECT
+
+public:
+    SimpleJob(const QString &kind="Simple", QObject *parent=0)
+        : GCF::AbstractJob(kind, parent) { }
+
+    Q_SLOT void finish() { this->done(); }
+
+    GCF::Result startJob() { return true; }
+    GCF::Result cancelJob() { return true; }
+    GCF::Result suspendJob() { return true; }
+    GCF::Result resumeJob() { return true; }
+};
+
+class JobSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    JobSchedulerTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void testSchedule();
+    void testMaximumRunningJobs();
+    void testMaximumRunningJobsPerKind();
+    void testPriority();
+    void testSuspendAndResume();
+    void testUnschedule();
+};
+
+JobSchedulerTest::JobSchedulerTest()
+{
+}
+
+void JobSchedulerTest::initTestCase()
+{
+    qDebug("Running tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+}
+
+void JobSchedulerTest::cleanupTestCase()
+{
+    qDebug("Executed tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+}
+
+void JobSchedulerTest::cleanup()
+{
+    QFile::remove( GCF::Log::instance()->logFileName() );
+}
+
+void JobSchedulerTest::testSchedule()
+{
+    GCF::JobScheduler scheduler;
+    QVERIFY(scheduler.jobListModel() == gAppService->jobs());
+    QVERIFY(scheduler.maximumRunningJobs() == 0);
+
+    GCF::Result result = scheduler.schedule(nullptr);
+    QVERIFY(result.isSuccess() == false);
+    QVERIFY(result.message() == "Job not specified");
+
+    SimpleJob *job = new SimpleJob;
+    GCF::SignalSpy queuedSpy(&scheduler, SIGNAL(jobQueued(GCF::AbstractJob*)));
+    GCF::SignalSpy dispatchedSpy(&scheduler, SIGNAL(jobDispatched(GCF::AbstractJob*)));
+
+    // Without limits, jobs are started right away
+    QVERIFY(scheduler.schedule(job).isSuccess());
+    QVERIFY(queuedSpy.count() == 1);
+    QVERIFY(dispatchedSpy.count() == 1);
+    QVERIFY(job->isStarted());
+    QVERIFY(scheduler.isRunning(job));
+    QVERIFY(scheduler.isQueued(job) == false);
+    QVERIFY(scheduler.runningJobCount() == 1);
+    QVERIFY(scheduler.runningJobCount("Simple") == 1);
+
+    result = scheduler.schedule(job);
+    QVERIFY(result.isSuccess() == false);
+    QVERIFY(result.message() == "Job is already running");
+
+    job->finish();
+    QVERIFY(scheduler.isRunning(job) == false);
+    QVERIFY(scheduler.runningJobCount() == 0);
+
+    // Completed jobs are retried
+    QVERIFY(scheduler.schedule(job).isSuccess());
+    QVERIFY(job->isRunning());
+    QVERIFY(scheduler.runningJobCount() == 1);
+
+    // Destroyed jobs are no longer counted
+    delete job;
+    QVERIFY(scheduler.runningJobCount() == 0);
+}
+
+void JobSchedulerTest::testMaximumRunningJobs()
+{
+    GCF::JobScheduler scheduler;
+    scheduler.setMaximumRunningJobs(2);
+    QVERIFY(scheduler.maximumRunningJobs() == 2);
+
+    QList<SimpleJob*> jobs;
+    for(int i=0; i<5; i++)
+    {
+        SimpleJob *job = new SimpleJob;
+        jobs.append(job);
+        QVERIFY(scheduler.schedule(job).isSuccess());
+    }
+
+    QVERIFY(scheduler.runningJobCount() == 2);
+    QVERIFY(scheduler.queuedJobCount() == 3);
+    QVERIFY(jobs.at(0)->isStarted() && jobs.at(1)->isStarted());
+    QVERIFY(jobs.at(2)->isStarted() == false);
+
+    // Completion of a job must start the next one in the queue
+    jobs.at(0)->finish();
+    QVERIFY(jobs.at(2)->isStarted());
+    QVERIFY(jobs.at(3)->isStarted() == false);
+    QVERIFY(scheduler.runningJobCount() == 2);
+    QVERIFY(scheduler.queuedJobCount() == 2);
+
+    // Raising the limit must start queued jobs
+    scheduler.setMaximumRunningJobs(0);
+    QVERIFY(scheduler.runningJobCount() == 4);
+    QVERIFY(scheduler.queuedJobCount() == 0);
+
+    qDeleteAll(jobs);
+    QVERIFY(scheduler.runningJobCount() == 0);
+}
+
+void JobSchedulerTest::testMaximumRunningJobsPerKind()
+{
+    GCF::JobScheduler scheduler;
+    scheduler.setMaximumRunningJobs("Download", 1);
+    QVERIFY(scheduler.maximumRunningJobs("Download") == 1);
+    QVERIFY(scheduler.maximumRunningJobs("Upload") == 0);
+
+    SimpleJob *download1 = new SimpleJob("Download");
+    SimpleJob *download2 = new SimpleJob("Download");
+    SimpleJob *upload1 = new SimpleJob("Upload");
+    SimpleJob *upload2 = new SimpleJob("Upload");
+
+    scheduler.schedule(download1);
+    scheduler.schedule(download2);
+    scheduler.schedule(upload1);
+    scheduler.schedule(upload2);
+
+    // A full queue of one kind must not hold back jobs of another kind
+    QVERIFY(download1->isStarted());
+    QVERIFY(download2->isStarted() == false);
+    QVERIFY(upload1->isStarted());
+    QVERIFY(upload2->isStarted());
+    QVERIFY(scheduler.runningJobCount("Download") == 1);
+    QVERIFY(scheduler.runningJobCount("Upload") == 2);
+    QVERIFY(scheduler.queuedJobCount("Download") == 1);
+    QVERIFY(scheduler.queuedJobCount("Upload") == 0);
+
+    upload1->finish();
+    QVERIFY(download2->isStarted() == false);
+
+    download1->finish();
+    QVERIFY(download2->isStarted());
+
+    delete download1;
+    delete download2;
+    delete upload1;
+    delete upload2;
+}
+
+void JobSchedulerTest::testPriority()
+{
+    GCF::JobScheduler scheduler;
+    scheduler.setMaximumRunningJobs(1);
+
+    SimpleJob *blocker = new SimpleJob;
+    SimpleJob *low = new SimpleJob;
+    SimpleJob *normal1 = new SimpleJob;
+    SimpleJob *normal2 = new SimpleJob;
+    SimpleJob *high = new SimpleJob;
+
+    scheduler.schedule(blocker);
+    scheduler.schedule(low, -1);
+    scheduler.schedule(normal1);
+    scheduler.schedule(normal2);
+    scheduler.schedule(high, 1);
+    QVERIFY(scheduler.priority(low) == -1);
+    QVERIFY(scheduler.priority(high) == 1);
+
+    GCF::Result result = scheduler.schedule(low);
+    QVERIFY(result.isSuccess() == false);
+    QVERIFY(result.message() == "Job is already scheduled");
+
+    GCF::SignalSpy dispatchedSpy(&scheduler, SIGNAL(jobDispatched(GCF::AbstractJob*)));
+    QList<SimpleJob*> order;
+    order << blocker << high << normal1 << normal2 << low;
+    for(int i=0; i<order.count()-1; i++)
+        order.at(i)->finish();
+
+    QVERIFY(dispatchedSpy.count() == 4);
+    for(int i=0; i<dispatchedSpy.count(); i++)
+        QVERIFY(dispatchedSpy.at(i).first().value<GCF::AbstractJob*>() == order.at(i+1));
+
+    // Priority of a queued job can be changed
+    scheduler.schedule(blocker);
+    scheduler.schedule(normal1);
+    scheduler.schedule(high, 1);
+    QVERIFY(scheduler.setPriority(normal1, 2));
+    QVERIFY(scheduler.priority(normal1) == 2);
+    QVERIFY(scheduler.setPriority(low, 2) == false);
+    low->finish();
+    QVERIFY(normal1->isRunning());
+    QVERIFY(high->isRunning() == false);
+
+    qDeleteAll(order);
+}
+
+void JobSchedulerTest::testSuspendAndResume()
+{
+    GCF::JobScheduler scheduler;
+    scheduler.setMaximumRunningJobs(1);
+
+    SimpleJob *job1 = new SimpleJob;
+    SimpleJob *job2 = new SimpleJob;
+    scheduler.schedule(job1);
+    scheduler.schedule(job2);
+    QVERIFY(job2->isStarted() == false);
+
+    // Suspended jobs must make room for queued jobs
+    job1->suspend();
+    QVERIFY(job2->isStarted());
+    QVERIFY(scheduler.runningJobCount() == 1);
+
+    // Suspended jobs are resumed when scheduled again
+    QVERIFY(scheduler.schedule(job1).isSuccess());
+    QVERIFY(job1->isSuspended());
+    job2->finish();
+    QVERIFY(job1->isSuspended() == false);
+    QVERIFY(scheduler.isRunning(job1));
+
+    delete job1;
+    delete job2;
+}
+
+void JobSchedulerTest::testUnschedule()
+{
+    GCF::JobScheduler scheduler;
+    scheduler.setMaximumRunningJobs(1);
+
+    SimpleJob *job1 = new SimpleJob;
+    SimpleJob *job2 = new SimpleJob;
+    scheduler.schedule(job1);
+    scheduler.schedule(job2);
+
+    QVERIFY(scheduler.unschedule(job1) == false);
+    QVERIFY(scheduler.unschedule(job2));
+    QVERIFY(scheduler.isQueued(job2) == false);
+    QVERIFY(scheduler.queuedJobCount() == 0);
+
+    job1->finish();
+    QVERIFY(job2->isStarted() == false);
+
+    // Destroyed jobs must be removed from the queue
+    scheduler.schedule(job1);
+    scheduler.schedule(job2);
+    QVERIFY(scheduler.isQueued(job2));
+    delete job2;
+    QVERIFY(scheduler.queuedJobCount() == 0);
+
+    delete job1;
+}
+
+int main(int argc, char *argv[])
+{
+    GCF::GuiApplication app(argc, argv);
+    JobSchedulerTest tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+#include "tst_JobSchedulerTest.moc"
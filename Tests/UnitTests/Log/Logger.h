@@ -88,4 +88,54 @@ private:
     int m_interval;
 };
 
+class BranchLogger : public QThread
+{
+public:
+    BranchLogger(QObject *parent=0) : QThread(parent) { }
+    ~BranchLogger() { }
+
+protected:
+    void run() {
+        // Every message logged by this thread must end up in
+        // this thread's branch, irrespective of what other threads
+        // are doing at the same time
+        QString context = QString::number((quintptr)QThread::currentThreadId());
+        GCF::LogMessageBranch branch(context);
+        for(int i=0; i<5; i++) {
+            GCF::Log::instance()->info(context, QString("Info Log %1").arg(i));
+            QThread::msleep(1);
+        }
+    }
+};
+
+class RetentionLogger : public QThread
+{
+public:
+    RetentionLogger(QObject *parent=0) : QThread(parent) { }
+    ~RetentionLogger() { }
+
+protected:
+    void run() {
+        for(int i=0; i<10; i++)
+            GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, QString("Thread Log %1").arg(i));
+    }
+};
+
+class RowRemovalRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    RowRemovalRecorder(QObject *parent=0) : QObject(parent) { }
+    ~RowRemovalRecorder() { }
+
+    QList<QThread*> threads() const { return m_threads; }
+
+public slots:
+    void record() { m_threads.append(QThread::currentThread()); }
+
+private:
+    QList<QThread*> m_threads;
+};
+
 #endif // LOGTHREAD_H
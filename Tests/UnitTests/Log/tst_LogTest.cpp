@@ -20,9 +20,12 @@
 #include <QtDebug>
 #include <QString>
 #include <QThread>
+#include <QLoggingCategory>
+#include <QSortFilterProxyModel>
 
 #include <GCF3/Version>
 #include <GCF3/Log>
+#include <GCF3/BinaryLogHandler>
 
 #include "LogMessageHandler.h"
 #include "Logger.h"
@@ -45,10 +48,21 @@ private Q_SLOTS:
     void testBranchLogging();
     void testNestedBranchLogging();
     void testThreadedLogging();
+    void testAsynchronousLogging();
+    void testLogContext();
+    void testLogLevel();
+    void testRetention();
+    void testBranchRetention();
     void testLogModel();
+    void testLogModelObservers();
+    void testNestedThreadBranches();
+    void testBinaryLogging();
+    void testRateLimiting();
+    void testQtMessages();
 
 private:
     QString logFileContents(bool deleteFile=true) const;
+    void logBinaryTestMessages(int jobId);
 };
 
 LogTest::LogTest()
@@ -274,10 +288,517 @@ void LogTest::testThreadedLogging()
     QVERIFY(nrLinesInLogText == maxThreads*5+1);
 }
 
+void LogTest::testAsynchronousLogging()
+{
+    QVERIFY(GCF::Log::instance()->isAsynchronous() == false);
+
+    MessageToStringHandler handler;
+    GCF::Log::instance()->setHandler(&handler);
+    GCF::Log::instance()->setAsynchronous(true);
+    QVERIFY(GCF::Log::instance()->isAsynchronous() == true);
+
+    GCF::Log::instance()->error(GCF_DEFAULT_LOG_CONTEXT, "Error Log");
+    {
+        GCF::LogMessageBranch branch("Warning Branch");
+        GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT, "Warning Log");
+    }
+    for(int i=0; i<10000; i++)
+        GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, QString("Info Log %1").arg(i));
+
+    // Messages are written only after flush() returns
+    GCF::Log::instance()->flush();
+    QVERIFY(this->logFileContents() == handler.string());
+    handler.clearString();
+
+    // Logging after flush() must reopen the log file
+    GCF::Log::instance()->debug(GCF_DEFAULT_LOG_CONTEXT, "Debug Log");
+    GCF::Log::instance()->flush();
+    QVERIFY(this->logFileContents() == handler.string());
+    handler.clearString();
+
+    // Switching back to synchronous mode must write pending messages
+    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, "Info Log");
+    GCF::Log::instance()->setAsynchronous(false);
+    QVERIFY(GCF::Log::instance()->isAsynchronous() == false);
+    QVERIFY(this->logFileContents() == handler.string());
+}
+
+void LogTest::testLogContext()
+{
+    int line = __LINE__; QString context = GCF_LOG_CONTEXT;
+    QVERIFY(context == QString("tst_LogTest:%1-testLogContext").arg(line));
+    QVERIFY(QString(GCF_LOG_FILE_NAME) == "tst_LogTest.cpp");
+}
+
+static int EvaluationCount = 0;
+static QString evaluatedMessage(const QString &msg)
+{
+    ++EvaluationCount;
+    return msg;
+}
+
+void LogTest::testLogLevel()
+{
+    QVERIFY(GCF::Log::instance()->logLevel() == GCF::LogMessage::User);
+
+    MessageToStringHandler handler;
+    GCF::Log::instance()->setHandler(&handler);
+    GCF::Log::instance()->setLogLevel(GCF::LogMessage::Warning);
+    QVERIFY(GCF::Log::isEnabled(GCF::LogMessage::Error));
+    QVERIFY(GCF::Log::isEnabled(GCF::LogMessage::Warning));
+    QVERIFY(!GCF::Log::isEnabled(GCF::LogMessage::Debug));
+
+    // Disabled messages must not evaluate their arguments
+    EvaluationCount = 0;
+    GCF_LOG_INFO( evaluatedMessage("Info Log") );
+    GCF_LOG_DEBUG( evaluatedMessage("Debug Log") );
+    QVERIFY(EvaluationCount == 0);
+    QVERIFY(handler.string().isEmpty());
+
+    // The older API must also respect the threshold
+    GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, "Info Log");
+    QVERIFY(handler.string().isEmpty());
+
+    GCF_LOG_WARNING( evaluatedMessage("Warning Log") );
+    QVERIFY(EvaluationCount == 1);
+    QVERIFY(handler.string().contains("Warning Log"));
+    QVERIFY(this->logFileContents() == handler.string());
+
+    GCF::Log::instance()->setLogLevel(GCF::LogMessage::User);
+}
+
+void LogTest::testRetention()
+{
+    GCF::Log *log = GCF::Log::instance();
+    log->clear();
+    QVERIFY(log->messageCount() == 0);
+    QVERIFY(log->messageBytes() == 0);
+
+    // This handler does not delete messages, so they stay in the tree
+    EmptyLogMessageHandler handler;
+    log->setHandler(&handler);
+    log->setMaximumMessageCount(10);
+
+    for(int i=0; i<100; i++)
+        log->info(GCF_DEFAULT_LOG_CONTEXT, QString("Info Log %1").arg(i));
+    QVERIFY(log->messageCount() == 10);
+    QVERIFY(log->logMessages().count() == 10);
+    QVERIFY(log->logMessages().last()->message() == "Info Log 99");
+    QVERIFY(log->logMessages().first()->message() == "Info Log 90");
+
+    // Open branches are not pruned
+    {
+        GCF::LogMessageBranch branch("Open Branch");
+        for(int i=0; i<100; i++)
+            log->info(GCF_DEFAULT_LOG_CONTEXT, QString("Branch Log %1").arg(i));
+        QVERIFY(log->messageCount() == 10);
+        QVERIFY(log->logMessages().count() == 0);
+        QVERIFY(branch.branchMessage()->children().count() == 9);
+    }
+
+    log->setMaximumMessageCount(0);
+    log->setMaximumMessageBytes(log->messageBytes()/2);
+    QVERIFY(log->messageBytes() <= log->maximumMessageBytes());
+
+    log->setMaximumMessageBytes(0);
+    log->clear();
+    QVERIFY(log->messageCount() == 0);
+}
+
+void LogTest::testBranchRetention()
+{
+    MessageToStringHandler handler;
+    GCF::Log::instance()->setHandler(&handler);
+    GCF::Log::instance()->setBranchRetentionLevel(GCF::LogMessage::Warning);
+
+    {
+        GCF::LogMessageBranch branch("Retention Branch");
+        GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, "Info Log");
+        {
+            GCF::LogMessageBranch branch("Info Branch");
+            GCF::Log::instance()->debug(GCF_DEFAULT_LOG_CONTEXT, "Debug Log");
+        }
+        GCF::Log::instance()->warning(GCF_DEFAULT_LOG_CONTEXT, "Warning Log");
+    }
+
+    QString log = this->logFileContents();
+    QVERIFY(log.contains("Warning Log"));
+    QVERIFY(!log.contains("Info Log"));
+    QVERIFY(!log.contains("Info Branch"));
+
+    // Branches with nothing retained are dropped altogether
+    {
+        GCF::LogMessageBranch branch("Empty Branch");
+        GCF::Log::instance()->info(GCF_DEFAULT_LOG_CONTEXT, "Info Log");
+    }
+    QVERIFY(!this->logFileContents().contains("Empty Branch"));
+
+    GCF::Log::instance()->setBranchRetentionLevel(GCF::LogMessage::User);
+}
+
 void LogTest::testLogModel()
 {
-    // FIXME: #pragma message("We need to test the GCF::Log as a QAbstractItemModel also.")
-    qDebug("TODO: We need to test the GCF::Log as a QAbstractItemModel also.");
+    GCF::Log *log = GCF::Log::instance();
+    log->clear();
+
+    // This handler does not delete messages, so they stay in the tree
+    EmptyLogMessageHandler handler;
+    log->setHandler(&handler);
+    log->info(GCF_DEFAULT_LOG_CONTEXT, "Info Log 0");
+    QTest::qWait(200);
+    QVERIFY(log->rowCount(QModelIndex()) == 2); // Version message + Info Log 0
+
+    QSignalSpy resetSpy(log, SIGNAL(modelReset()));
+    QSignalSpy insertSpy(log, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    QSignalSpy removeSpy(log, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+
+    {
+        GCF::LogMessageBranch branch("Model Branch");
+        log->info(GCF_DEFAULT_LOG_CONTEXT, "Info Log 1");
+        log->info(GCF_DEFAULT_LOG_CONTEXT, "Info Log 2");
+        branch.setMessage("Updated Model Branch");
+
+        // Open branches are private to the thread that opened them
+        QTest::qWait(200);
+        QVERIFY(insertSpy.count() == 0);
+        QVERIFY(log->rowCount(QModelIndex()) == 2);
+    }
+
+    // Rows are announced only after the model update timer fires
+    QVERIFY(log->rowCount(QModelIndex()) == 2);
+    QTest::qWait(200);
+
+    // The branch and its messages must be announced in one insert
+    QVERIFY(insertSpy.count() == 1);
+    QVERIFY(log->rowCount(QModelIndex()) == 3);
+    QModelIndex branchIndex = log->index(2, 0, QModelIndex());
+    QVERIFY(log->data(branchIndex.sibling(2, 1), Qt::DisplayRole).toString() == "Model Branch");
+    QVERIFY(log->data(branchIndex.sibling(2, 3), Qt::DisplayRole).toString() == "Updated Model Branch");
+    QVERIFY(log->rowCount(branchIndex) == 2);
+    QVERIFY(log->data(log->index(1, 3, branchIndex), Qt::DisplayRole).toString() == "Info Log 2");
+    QVERIFY(log->parent(log->index(1, 0, branchIndex)) == branchIndex);
+
+    // Pruned messages must be removed one row at a time
+    log->setMaximumMessageCount(3);
+    QVERIFY(removeSpy.count() == 2);
+    QVERIFY(log->rowCount(QModelIndex()) == 1);
+    QVERIFY(resetSpy.count() == 0);
+
+    // Rows pruned by other threads must be removed in the model's thread
+    RowRemovalRecorder recorder;
+    connect(log, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)),
+            &recorder, SLOT(record()), Qt::DirectConnection);
+    RetentionLogger logger;
+    logger.start();
+    QVERIFY(logger.wait());
+    QVERIFY(log->messageCount() == 3);
+    QTest::qWait(200);
+
+    QVERIFY(recorder.threads().count() > 0);
+    QVERIFY(recorder.threads().count(QThread::currentThread()) == recorder.threads().count());
+    QVERIFY(log->rowCount(QModelIndex()) == 3);
+    QVERIFY(log->data(log->index(2, 3, QModelIndex()), Qt::DisplayRole).toString() == "Thread Log 9");
+    QVERIFY(resetSpy.count() == 0);
+
+    log->setMaximumMessageCount(0);
+    log->clear();
+    QVERIFY(resetSpy.count() == 1);
+    QVERIFY(log->rowCount(QModelIndex()) == 0);
+}
+
+void LogTest::testLogModelObservers()
+{
+    GCF::Log *log = GCF::Log::instance();
+    log->clear();
+
+    // This handler does not delete messages, so they stay in the tree
+    EmptyLogMessageHandler handler;
+    log->setHandler(&handler);
+    for(int i=0; i<5; i++)
+        log->info(GCF_DEFAULT_LOG_CONTEXT, QString("Info Log %1").arg(i));
+    QTest::qWait(200);
+    const int rows = log->rowCount(QModelIndex());
+    QVERIFY(rows >= 5);
+
+    // Proxies and persistent indexes call back into the model while rows
+    // are removed. Those calls must not wait on the log's own lock.
+    QSortFilterProxyModel proxy;
+    proxy.setSourceModel(log);
+    QVERIFY(proxy.rowCount() == rows);
+    QPersistentModelIndex firstIndex(log->index(0, 0, QModelIndex()));
+    QPersistentModelIndex lastIndex(log->index(rows-1, 0, QModelIndex()));
+    QSignalSpy removeSpy(log, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+
+    // Messages pruned in the model's thread are removed right away
+    log->setMaximumMessageCount(rows-2);
+    QVERIFY(removeSpy.count() == 2);
+    QVERIFY(firstIndex.isValid() == false);
+    QVERIFY(lastIndex.isValid());
+    QVERIFY(lastIndex.row() == rows-3);
+    QVERIFY(proxy.rowCount() == rows-2);
+
+    // Messages pruned by other threads are retired, and removed when the
+    // model update timer fires
+    RetentionLogger logger;
+    logger.start();
+    QVERIFY(logger.wait());
+    QTest::qWait(200);
+
+    QVERIFY(lastIndex.isValid() == false);
+    QVERIFY(log->rowCount(QModelIndex()) == rows-2);
+    QVERIFY(proxy.rowCount() == rows-2);
+    QVERIFY(proxy.index(rows-3, 3).data().toString() == "Thread Log 9");
+
+    log->setMaximumMessageCount(0);
+    log->clear();
+    QVERIFY(proxy.rowCount() == 0);
+}
+
+void LogTest::testNestedThreadBranches()
+{
+    // Branches opened in different threads must not get mixed up
+    EmptyLogMessageHandler handler;
+    GCF::Log::instance()->setHandler(&handler);
+    GCF::Log::instance()->clear();
+
+    const int maxThreads = 10;
+    BranchLogger threads[maxThreads];
+    for(int i=0; i<maxThreads; i++)
+        threads[i].start();
+    for(int i=0; i<maxThreads; i++)
+        threads[i].wait();
+
+    // One branch per thread, each with only its own thread's messages
+    QList<GCF::LogMessage*> branches = GCF::Log::instance()->logMessages();
+    int nrBranches = 0;
+    Q_FOREACH(GCF::LogMessage *branch, branches)
+    {
+        if(branch->children().isEmpty())
+            continue; // Version message
+
+        ++nrBranches;
+        QVERIFY(branch->children().count() == 5);
+        Q_FOREACH(GCF::LogMessage *msg, branch->children())
+            QVERIFY(msg->context() == branch->context());
+    }
+    QVERIFY(nrBranches == maxThreads);
+
+    GCF::Log::instance()->clear();
+}
+
+void LogTest::testBinaryLogging()
+{
+    const QString fileName = QDir::tempPath() + "/tst_LogTest.gcflog";
+    QFile::remove(fileName);
+
+    // Capture the text form of the messages first
+    MessageToStringHandler textHandler;
+    GCF::Log::instance()->setHandler(&textHandler);
+    GCF::Log::instance()->info("BinaryLog", "Ensures that the version message is logged");
+    textHandler.clearString();
+    this->logBinaryTestMessages(42);
+    QString expected = textHandler.string();
+    GCF::Log::instance()->setHandler(0);
+
+    {
+        GCF::BinaryLogHandler handler(fileName);
+        QVERIFY(handler.fileName() == fileName);
+        GCF::Log::instance()->setHandler(&handler);
+        this->logBinaryTestMessages(42);
+        GCF::Log::instance()->setHandler(0);
+    }
+
+    // Decoding must reproduce the text format exactly
+    QString decoded;
+    {
+        QTextStream ts(&decoded, QIODevice::WriteOnly);
+        QVERIFY(GCF::BinaryLogReader::decode(fileName, ts));
+    }
+    QVERIFY(decoded == expected);
+
+    // Check filtering of records
+    {
+        GCF::BinaryLogReader reader;
+        QVERIFY(reader.open(fileName));
+        reader.setMaximumLogLevel(GCF::LogMessage::Warning);
+        reader.setContextPrefix("BinaryLog Child");
+
+        GCF::BinaryLogRecord record;
+        QVERIFY(reader.readNext(record));
+        QVERIFY(record.depth == 1);
+        QVERIFY(record.logLevel == GCF::LogMessage::Warning);
+        QVERIFY(record.message == "Retrying 3 of 007 attempts");
+        QVERIFY(record.details == " (details)");
+
+        QVERIFY(reader.readNext(record));
+        QVERIFY(record.logLevel == GCF::LogMessage::Error);
+        QVERIFY(record.logCode == "E42");
+
+        QVERIFY(reader.readNext(record) == false);
+        QVERIFY(reader.errorMessage().isEmpty());
+
+        reader.setContextPrefix(QString());
+        reader.setMaximumLogLevel(GCF::LogMessage::User);
+        QVERIFY(reader.open(fileName));
+        reader.setTimeRange(QDateTime::currentDateTime().addSecs(60), QDateTime());
+        QVERIFY(reader.readNext(record) == false);
+    }
+
+    // Appending to the file starts a new session
+    textHandler.clearString();
+    GCF::Log::instance()->setHandler(&textHandler);
+    this->logBinaryTestMessages(43);
+    expected += textHandler.string();
+    GCF::Log::instance()->setHandler(0);
+
+    {
+        GCF::BinaryLogHandler handler(fileName);
+        GCF::Log::instance()->setHandler(&handler);
+        this->logBinaryTestMessages(43);
+        GCF::Log::instance()->setHandler(0);
+    }
+
+    decoded.clear();
+    {
+        QTextStream ts(&decoded, QIODevice::WriteOnly);
+        QVERIFY(GCF::BinaryLogReader::decode(fileName, ts));
+    }
+    QVERIFY(decoded == expected);
+
+    QFile::remove(fileName);
+}
+
+void LogTest::testRateLimiting()
+{
+    EmptyLogMessageHandler handler;
+    GCF::Log *log = GCF::Log::instance();
+    log->setHandler(&handler);
+    log->clear();
+
+    log->setRateLimit(GCF::LogMessage::Warning, 5, "RateTest");
+    QVERIFY(log->rateLimit(GCF::LogMessage::Warning, "RateTest") == 5);
+    QVERIFY(log->rateLimit(GCF::LogMessage::Error, "RateTest") == 0);
+
+    // Only the first 5 warnings within a second must be logged
+    for(int i=0; i<100; i++)
+        log->warning("RateTest:1", "Storm");
+    QVERIFY(log->suppressedMessageCount("RateTest:1") == 95);
+    QVERIFY(log->suppressedMessageCount() == 95);
+
+    // Other levels and contexts are not limited
+    for(int i=0; i<10; i++)
+    {
+        log->info("RateTest:1", "Info");
+        log->warning("Other", "Warning");
+    }
+    QVERIFY(log->suppressedMessageCount() == 95);
+
+    // A summary is logged once the window is over
+    QTest::qWait(1100);
+    log->warning("RateTest:1", "After storm");
+
+    QStringList messages;
+    Q_FOREACH(GCF::LogMessage *msg, log->logMessages())
+    {
+        if(msg->context() == "RateTest:1" && msg->logLevel() == GCF::LogMessage::Warning)
+            messages << msg->message();
+    }
+    QVERIFY(messages.count() == 7);
+    QVERIFY(messages.at(5) == "Suppressed 95 messages");
+    QVERIFY(messages.at(6) == "After storm");
+
+    // Sampling of messages beyond the limit
+    log->clear();
+    log->resetSuppressedMessageCounts();
+    log->setRateLimit(GCF::LogMessage::Warning, 0, "Sampled", 10);
+    QVERIFY(log->sampleInterval(GCF::LogMessage::Warning, "Sampled") == 10);
+    for(int i=0; i<100; i++)
+        log->warning("Sampled:1", "Sampled storm");
+    QVERIFY(log->suppressedMessageCount("Sampled:1") == 90);
+
+    // Pending summaries are logged when limits are cleared
+    log->clearRateLimits();
+    int nrSampled = 0;
+    QString summary;
+    Q_FOREACH(GCF::LogMessage *msg, log->logMessages())
+    {
+        if(msg->context() != "Sampled:1")
+            continue;
+        if(msg->message() == "Sampled storm")
+            ++nrSampled;
+        else
+            summary = msg->message();
+    }
+    QVERIFY(nrSampled == 10);
+    QVERIFY(summary == "Suppressed 90 messages");
+
+    // Suppressed messages are counted per context for a bounded number of contexts
+    log->clear();
+    log->resetSuppressedMessageCounts();
+    log->setRateLimit(GCF::LogMessage::Warning, 1, "Capped");
+    for(int i=0; i<5000; i++)
+    {
+        const QString context = QString("Capped:%1").arg(i);
+        log->warning(context, "First");
+        log->warning(context, "Second");
+    }
+    QVERIFY(log->suppressedMessageCount() == 5000);
+    QVERIFY(log->suppressedMessageCount("Capped:0") == 1);
+    QVERIFY(log->suppressedMessageCount("Capped:4999") == 0);
+    log->clearRateLimits();
+
+    log->resetSuppressedMessageCounts();
+    QVERIFY(log->suppressedMessageCount() == 0);
+    log->clear();
+}
+
+void LogTest::testQtMessages()
+{
+    EmptyLogMessageHandler handler;
+    GCF::Log *log = GCF::Log::instance();
+    log->setHandler(&handler);
+    log->clear();
+
+    QtMessageHandler testHandler = qInstallMessageHandler(0);
+    qInstallMessageHandler(testHandler);
+
+    QLoggingCategory category("gcf.test");
+    log->setLogQtMessages(true);
+    qWarning("Qt warning %d", 42);
+    qCWarning(category) << "Category warning";
+
+    // Messages of other categories must be dropped
+    log->setQtMessageCategories(QStringList() << "gcf");
+    QVERIFY(log->qtMessageCategories() == QStringList() << "gcf");
+    qWarning("Dropped warning");
+    qCWarning(category) << "Second category warning";
+
+    log->setQtMessageCategories(QStringList());
+    log->setLogQtMessages(false);
+    qInstallMessageHandler(testHandler);
+
+    QStringList messages;
+    Q_FOREACH(GCF::LogMessage *msg, log->logMessages())
+    {
+        if(msg->context() != "QtWarningMsg")
+            continue;
+
+        messages << msg->message();
+        QVERIFY(msg->logLevel() == GCF::LogMessage::Warning);
+        if(msg->message() != "Qt warning 42")
+            QVERIFY(msg->category() == "gcf.test");
+        if(!msg->sourceFile().isEmpty())
+        {
+            QVERIFY(msg->sourceLine() > 0);
+            QVERIFY(msg->sourceFunction().contains("testQtMessages"));
+        }
+    }
+
+    QStringList expected;
+    expected << "Qt warning 42" << "Category warning" << "Second category warning";
+    QVERIFY(messages == expected);
+
+    log->clear();
 }
 
 QString LogTest::logFileContents(bool deleteFile) const
@@ -294,6 +815,18 @@ QString LogTest::logFileContents(bool deleteFile) const
     return retString;
 }
 
+void LogTest::logBinaryTestMessages(int jobId)
+{
+    GCF::Log::instance()->info("BinaryLog", QString("Job %1 finished in 1500 msecs").arg(jobId));
+    {
+        GCF::LogMessageBranch branch("BinaryLog Branch");
+        GCF::Log::instance()->warning("BinaryLog Child", "Retrying 3 of 007 attempts", " (details)");
+        GCF::Log::instance()->error("BinaryLog Child", QByteArray("E42"), "No numbers here", QString());
+        GCF::Log::instance()->debug("BinaryLog Child", "Large 123456789012345678901234 number");
+    }
+    GCF::Log::instance()->info("BinaryLog", QString("Job %1 finished in 1500 msecs").arg(jobId+1));
+}
+
 QTEST_MAIN(LogTest)
 
 #include "tst_LogTest.moc"
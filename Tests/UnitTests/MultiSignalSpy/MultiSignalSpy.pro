@@ -0,0 +1,13 @@
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_MultiSignalSpyTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+DESTDIR = $$PWD/../../../Binary/Tests/UnitTests
+include($$PWD/../../../QMakePRF/GCF3.prf)
+
+SOURCES += tst_MultiSignalSpyTest.cpp
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
@@ -0,0 +1,270 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QString>
+#include <QtTest>
+#include <QMetaType>
+
+#include <GCF3/MultiSignalSpy>
+#include <GCF3/Log>
+#include <GCF3/Version>
+
+class SignalObject : public QObject
+{
+    Q_OBJECT
+
+public:
+    SignalObject(QObject *parent=0) : QObject(parent) { }
+
+signals:
+    void noParams();
+    void integer(int val);
+    void string(const QString &val);
+    void variant(const QVariant &val);
+    void twoParams(int intVal, const QString &strVal);
+};
+
+class IntegerSumSpy : public GCF::MultiSignalSpy
+{
+public:
+    IntegerSumSpy() : m_sum(0) { }
+
+    int sum() const { return m_sum; }
+
+protected:
+    bool handleRawSignalEmission(int connectionId, void **args, const QList<int> &argTypes) {
+        Q_UNUSED(connectionId);
+        if(argTypes.count() != 1 || argTypes.first() != QMetaType::Int)
+            return false;
+        m_sum += *reinterpret_cast<int*>(args[0]);
+        return true;
+    }
+
+private:
+    int m_sum;
+};
+
+class MultiSignalSpyTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    MultiSignalSpyTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void testConnect();
+    void testEmissions();
+    void testDisconnect();
+    void testSenderDestroyed();
+    void testRawEmission();
+    void testManyConnections();
+};
+
+MultiSignalSpyTest::MultiSignalSpyTest()
+{
+}
+
+void MultiSignalSpyTest::initTestCase()
+{
+    qDebug("Running tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+}
+
+void MultiSignalSpyTest::cleanupTestCase()
+{
+    qDebug("Executed tests on GCF-%s built on %s",
+           qPrintable(GCF::version()),
+           qPrintable(GCF::buildTimestamp()));
+}
+
+void MultiSignalSpyTest::cleanup()
+{
+    GCF::Log::instance()->setHandler(0);
+    QFile::remove( GCF::Log::instance()->logFileName() );
+}
+
+void MultiSignalSpyTest::testConnect()
+{
+    SignalObject object;
+    GCF::MultiSignalSpy spy;
+    QVERIFY(spy.connectionCount() == 0);
+
+    QVERIFY(spy.connectSignal(0, SIGNAL(noParams())) == -1);
+    QVERIFY(spy.connectSignal(&object, 0) == -1);
+    QVERIFY(spy.connectSignal(&object, SIGNAL(unknown())) == -1);
+
+    int id1 = spy.connectSignal(&object, SIGNAL(noParams()));
+    int id2 = spy.connectSignal(&object, SIGNAL(twoParams(int, QString)));
+    QVERIFY(id1 >= 0 && id2 >= 0 && id1 != id2);
+    QVERIFY(spy.connectionCount() == 2);
+    QVERIFY(spy.connectionCount(&object) == 2);
+    QVERIFY(spy.isConnected(&object, SIGNAL(noParams())));
+    QVERIFY(spy.isConnected(&object, SIGNAL(twoParams(int,QString))));
+    QVERIFY(spy.isConnected(&object, SIGNAL(integer(int))) == false);
+
+    QVERIFY(spy.connectionSender(id2) == &object);
+    QVERIFY(spy.connectionSignal(id2) == "twoParams(int,QString)");
+    QVERIFY(spy.connectionArgumentTypes(id2) == QList<int>() << QMetaType::Int << QMetaType::QString);
+    QVERIFY(spy.connectionSender(100) == 0);
+    QVERIFY(spy.connectionSignal(-1).isEmpty());
+}
+
+void MultiSignalSpyTest::testEmissions()
+{
+    SignalObject object1, object2;
+    GCF::MultiSignalSpy spy;
+    QSignalSpy qspy(&spy, SIGNAL(caughtSignal(QObject*,QByteArray,QVariantList)));
+
+    spy.connectSignal(&object1, SIGNAL(integer(int)));
+    spy.connectSignal(&object2, SIGNAL(string(QString)));
+    spy.connectSignal(&object2, SIGNAL(variant(QVariant)));
+    spy.connectSignal(&object2, SIGNAL(twoParams(int,QString)));
+
+    object1.integer(10);
+    object2.string("hello");
+    object2.variant(QVariant(2.5));
+    object2.twoParams(5, "five");
+    object1.string("not connected");
+
+    QVERIFY(qspy.count() == 4);
+    QVERIFY(qspy.at(0).at(0).value<QObject*>() == &object1);
+    QVERIFY(qspy.at(0).at(1).toByteArray() == "integer(int)");
+    QVERIFY(qspy.at(0).at(2).toList() == QVariantList() << 10);
+    QVERIFY(qspy.at(1).at(0).value<QObject*>() == &object2);
+    QVERIFY(qspy.at(1).at(2).toList() == QVariantList() << "hello");
+    QVERIFY(qspy.at(2).at(2).toList() == QVariantList() << 2.5);
+    QVERIFY(qspy.at(3).at(1).toByteArray() == "twoParams(int,QString)");
+    QVERIFY(qspy.at(3).at(2).toList() == QVariantList() << 5 << "five");
+
+    // Every connection reports the emission
+    qspy.clear();
+    spy.connectSignal(&object1, SIGNAL(integer(int)));
+    object1.integer(20);
+    QVERIFY(qspy.count() == 2);
+}
+
+void MultiSignalSpyTest::testDisconnect()
+{
+    SignalObject object1, object2;
+    GCF::MultiSignalSpy spy;
+    QSignalSpy qspy(&spy, SIGNAL(caughtSignal(QObject*,QByteArray,QVariantList)));
+
+    int id = spy.connectSignal(&object1, SIGNAL(integer(int)));
+    spy.connectSignal(&object1, SIGNAL(integer(int)));
+    spy.connectSignal(&object1, SIGNAL(noParams()));
+    spy.connectSignal(&object2, SIGNAL(noParams()));
+    spy.connectSignal(&object2, SIGNAL(string(QString)));
+    QVERIFY(spy.connectionCount() == 5);
+
+    QVERIFY(spy.disconnectSignal(id));
+    QVERIFY(spy.disconnectSignal(id) == false);
+    object1.integer(1);
+    QVERIFY(qspy.count() == 1);
+    qspy.clear();
+
+    QVERIFY(spy.disconnectSignal(&object1, SIGNAL(integer(int))) == 1);
+    object1.integer(1);
+    QVERIFY(qspy.count() == 0);
+
+    QVERIFY(spy.disconnectSender(&object2) == 2);
+    QVERIFY(spy.connectionCount(&object2) == 0);
+    object2.noParams();
+    object2.string("hello");
+    QVERIFY(qspy.count() == 0);
+
+    // IDs of removed connections are reused
+    QVERIFY(spy.connectSignal(&object2, SIGNAL(integer(int))) < 5);
+    QVERIFY(spy.connectionCount() == 2);
+
+    spy.disconnectAll();
+    QVERIFY(spy.connectionCount() == 0);
+    object1.noParams();
+    object2.integer(1);
+    QVERIFY(qspy.count() == 0);
+}
+
+void MultiSignalSpyTest::testSenderDestroyed()
+{
+    GCF::MultiSignalSpy spy;
+    SignalObject *object1 = new SignalObject;
+    SignalObject *object2 = new SignalObject;
+
+    spy.connectSignal(object1, SIGNAL(integer(int)));
+    spy.connectSignal(object1, SIGNAL(noParams()));
+    int id = spy.connectSignal(object2, SIGNAL(noParams()));
+    QVERIFY(spy.connectionCount() == 3);
+
+    delete object1;
+    QVERIFY(spy.connectionCount() == 1);
+    QVERIFY(spy.connectionSender(id) == object2);
+
+    QSignalSpy qspy(&spy, SIGNAL(caughtSignal(QObject*,QByteArray,QVariantList)));
+    object2->noParams();
+    QVERIFY(qspy.count() == 1);
+
+    delete object2;
+    QVERIFY(spy.connectionCount() == 0);
+}
+
+void MultiSignalSpyTest::testRawEmission()
+{
+    SignalObject object;
+    IntegerSumSpy spy;
+    QSignalSpy qspy(&spy, SIGNAL(caughtSignal(QObject*,QByteArray,QVariantList)));
+
+    spy.connectSignal(&object, SIGNAL(integer(int)));
+    spy.connectSignal(&object, SIGNAL(string(QString)));
+    for(int i=1; i<=10; i++)
+        object.integer(i);
+    object.string("hello");
+
+    QVERIFY(spy.sum() == 55);
+    QVERIFY(qspy.count() == 1);
+}
+
+void MultiSignalSpyTest::testManyConnections()
+{
+    QList<SignalObject*> objects;
+    GCF::MultiSignalSpy spy;
+    for(int i=0; i<1000; i++)
+    {
+        SignalObject *object = new SignalObject;
+        objects.append(object);
+        QVERIFY(spy.connectSignal(object, SIGNAL(integer(int))) == i);
+    }
+    QVERIFY(spy.connectionCount() == 1000);
+
+    QSignalSpy qspy(&spy, SIGNAL(caughtSignal(QObject*,QByteArray,QVariantList)));
+    objects.at(999)->integer(999);
+    objects.at(0)->integer(0);
+    QVERIFY(qspy.count() == 2);
+    QVERIFY(qspy.at(0).at(0).value<QObject*>() == objects.at(999));
+    QVERIFY(qspy.at(1).at(0).value<QObject*>() == objects.at(0));
+
+    qDeleteAll(objects);
+    QVERIFY(spy.connectionCount() == 0);
+}
+
+QTEST_MAIN(MultiSignalSpyTest)
+
+#include "tst_MultiSignalSpyTest.moc"
@@ -69,6 +69,26 @@ signals:
     void myUnsupportedType(const MyUnsupportedType &val);
 };
 
+class RawSignalSpy : public GCF::SignalSpy
+{
+public:
+    RawSignalSpy(QObject *sender, const char *signal)
+        : GCF::SignalSpy(sender, signal), m_sum(0) { }
+
+    int sum() const { return m_sum; }
+
+protected:
+    bool handleRawSignalEmission(void **args, const QList<int> &argTypes) {
+        if(argTypes.count() != 1 || argTypes.first() != QMetaType::Int)
+            return false;
+        m_sum += *reinterpret_cast<int*>(args[0]);
+        return true;
+    }
+
+private:
+    int m_sum;
+};
+
 class SignalSpyTest : public QObject
 {
     Q_OBJECT
@@ -99,6 +119,8 @@ private Q_SLOTS:
     void test_invalidObject();
 
     void test_wait();
+    void test_historyLimit();
+    void test_rawEmission();
 };
 
 SignalSpyTest::SignalSpyTest()
@@ -468,6 +490,72 @@ void SignalSpyTest::test_wait()
     QVERIFY(spy.wait(1000) == false);
 }
 
+void SignalSpyTest::test_historyLimit()
+{
+    SignalObject object;
+    GCF::SignalSpy spy(&object, SIGNAL(integer(int)));
+    QSignalSpy qspy(&spy, SIGNAL(caughtSignal(QVariantList)));
+    QVERIFY(spy.historyLimit() == -1);
+    QVERIFY(spy.argumentTypes() == QList<int>() << QMetaType::Int);
+
+    // Bounded history must retain only the latest emissions
+    spy.setHistoryLimit(3);
+    for(int i=0; i<10; i++)
+        object.integer(i);
+    QVERIFY(spy.count() == 3);
+    QVERIFY(spy.emissionCount() == 10);
+    QVERIFY(qspy.count() == 10);
+    QVERIFY(spy.first().first().toInt() == 7);
+    QVERIFY(spy.last().first().toInt() == 9);
+
+    spy.setHistoryLimit(1);
+    QVERIFY(spy.count() == 1);
+    QVERIFY(spy.first().first().toInt() == 9);
+
+    // Without history emissions are only counted and reported
+    spy.clear();
+    QVERIFY(spy.emissionCount() == 0);
+    spy.setHistoryLimit(0);
+    qspy.clear();
+    for(int i=0; i<10; i++)
+        object.integer(i);
+    QVERIFY(spy.count() == 0);
+    QVERIFY(spy.emissionCount() == 10);
+    QVERIFY(qspy.count() == 10);
+
+    QTimer::singleShot(100, &object, SIGNAL(noParams()));
+    GCF::SignalSpy waitSpy(&object, SIGNAL(noParams()));
+    waitSpy.setHistoryLimit(0);
+    QVERIFY(waitSpy.wait(1000) == true);
+    QVERIFY(waitSpy.count() == 0);
+    QVERIFY(waitSpy.emissionCount() == 1);
+
+    spy.setHistoryLimit(-10);
+    QVERIFY(spy.historyLimit() == -1);
+}
+
+void SignalSpyTest::test_rawEmission()
+{
+    SignalObject object;
+    RawSignalSpy spy(&object, SIGNAL(integer(int)));
+    QSignalSpy qspy(&spy, SIGNAL(caughtSignal(QVariantList)));
+
+    for(int i=1; i<=10; i++)
+        object.integer(i);
+
+    // Emissions handled raw are neither recorded nor reported as QVariantList
+    QVERIFY(spy.sum() == 55);
+    QVERIFY(spy.emissionCount() == 10);
+    QVERIFY(spy.count() == 0);
+    QVERIFY(qspy.count() == 0);
+
+    RawSignalSpy stringSpy(&object, SIGNAL(string(QString)));
+    object.string("hello");
+    QVERIFY(stringSpy.sum() == 0);
+    QVERIFY(stringSpy.count() == 1);
+    QVERIFY(stringSpy.first().first().toString() == "hello");
+}
+
 QTEST_MAIN(SignalSpyTest)
 
 #include "tst_SignalSpyTest.moc"
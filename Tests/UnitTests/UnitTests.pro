@@ -16,13 +16,17 @@ SUBDIRS += \
     ObjectDetails \
     Result \
     Ipc \
+    IpcWireFormat \
     SignalSpy \
+    MultiSignalSpy \
     IpcRemoteObject \
     Investigator \
     Fiber \
     IpcServerDiscovery \
     Job \
     JobList \
+    JobScheduler \
+    JobJournal \
     GDriveTests
 
 isEqual(QT_MAJOR_VERSION, 5) {
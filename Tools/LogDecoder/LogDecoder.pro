@@ -0,0 +1,8 @@
+include($$PWD/../../QMakePRF/GCF3.prf)
+TARGET = GCFLogDecoder
+CONFIG += console
+DESTDIR = $$PWD/../../Binary/Tools
+CONFIG -= app_bundle
+
+SOURCES += \
+    Main.cpp
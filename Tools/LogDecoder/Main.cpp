@@ -0,0 +1,85 @@
+/****************************************************************************
+**
+** Copyright (C) VCreate Logic Private Limited, Bangalore
+**
+** Use of this file is limited according to the terms specified by
+** VCreate Logic Private Limited, Bangalore.  Details of those terms
+** are listed in licence.txt included as part of the distribution package
+** of this file. This file may not be distributed without including the
+** licence.txt file.
+**
+** Contact info@vcreatelogic.com if any conditions of this licensing are
+** not clear to you.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <GCF3/BinaryLogHandler>
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QDateTime>
+#include <QTextStream>
+#include <QtDebug>
+#include <cstdio>
+
+static QDateTime parseTime(const QString &str)
+{
+    QDateTime dt = QDateTime::fromString(str, Qt::ISODate);
+    if(!dt.isValid())
+        qDebug("Invalid date-time '%s'. Use ISO format, for example 2014-03-21T10:30:00", qPrintable(str));
+    return dt;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+
+    GCF::BinaryLogReader reader;
+    QString fileName;
+
+    const QStringList args = a.arguments();
+    for(int i=1; i<args.count(); i++)
+    {
+        const QString arg = args.at(i);
+        if(arg.startsWith("--level:"))
+            reader.setMaximumLogLevel(arg.section(':', 1).toInt());
+        else if(arg.startsWith("--context:"))
+            reader.setContextPrefix(arg.section(':', 1));
+        else if(arg.startsWith("--from:"))
+            reader.setTimeRange(parseTime(arg.section(':', 1)), reader.toTime());
+        else if(arg.startsWith("--to:"))
+            reader.setTimeRange(reader.fromTime(), parseTime(arg.section(':', 1)));
+        else
+            fileName = arg;
+    }
+
+    if(fileName.isEmpty())
+    {
+        qDebug("%s [--level:<max-level>] [--context:<prefix>] [--from:<date-time>] [--to:<date-time>] <log-file>\n", argv[0]);
+        return -1;
+    }
+
+    GCF::Result result = reader.open(fileName);
+    if(!result)
+    {
+        qDebug("%s", qPrintable(result.message()));
+        return 1;
+    }
+
+    QTextStream ts(stdout);
+    GCF::BinaryLogRecord record;
+    while(reader.readNext(record))
+        GCF::BinaryLogReader::print(record, ts);
+    ts.flush();
+
+    if(!reader.errorMessage().isEmpty())
+    {
+        qDebug("Error while reading '%s': %s", qPrintable(fileName), qPrintable(reader.errorMessage()));
+        return 1;
+    }
+
+    return 0;
+}